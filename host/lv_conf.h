@@ -0,0 +1,43 @@
+/*
+ * LVGL Configuration (host simulator)
+ * Mirrors what sdkconfig.defaults gives the device: 16-bit swapped color,
+ * no built-in Montserrat, unscii 8 as the fallback font; ticks follow the
+ * simulated clock
+ */
+
+#ifndef LV_CONF_H
+#define LV_CONF_H
+
+#include <stdint.h>
+
+#define LV_COLOR_DEPTH 16
+#define LV_COLOR_16_SWAP 1
+
+/* LVGL's own pool, at the Kconfig default size */
+#define LV_MEM_CUSTOM 0
+#define LV_MEM_SIZE (32U * 1024U)
+
+#define LV_DISP_DEF_REFR_PERIOD 30
+#define LV_INDEV_DEF_READ_PERIOD 30
+
+#define LV_TICK_CUSTOM 1
+#define LV_TICK_CUSTOM_INCLUDE "host_shim.h"
+#define LV_TICK_CUSTOM_SYS_TIME_EXPR (host_tick_ms())
+
+#define LV_USE_LOG 0
+#define LV_USE_PERF_MONITOR 0
+#define LV_USE_MEM_MONITOR 0
+#define LV_USE_ASSERT_NULL 1
+#define LV_USE_ASSERT_MALLOC 1
+
+/* UI fonts come from the assets image, as on the device */
+#define LV_FONT_MONTSERRAT_14 0
+#define LV_FONT_MONTSERRAT_16 0
+#define LV_FONT_MONTSERRAT_20 0
+#define LV_FONT_MONTSERRAT_28 0
+#define LV_FONT_UNSCII_8 1
+#define LV_FONT_DEFAULT &lv_font_unscii_8
+
+#define LV_BUILD_EXAMPLES 0
+
+#endif /* LV_CONF_H */
@@ -0,0 +1,9 @@
+/* Host shim: esp_attr.h */
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+
+#endif /* ESP_ATTR_H */
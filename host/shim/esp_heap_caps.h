@@ -0,0 +1,15 @@
+/* Host shim: esp_heap_caps.h; every capability is plain malloc */
+#ifndef ESP_HEAP_CAPS_H
+#define ESP_HEAP_CAPS_H
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+#define heap_caps_malloc(size, caps) ((void)(caps), malloc(size))
+#define heap_caps_free(ptr) free(ptr)
+
+#endif /* ESP_HEAP_CAPS_H */
@@ -0,0 +1,15 @@
+/* Host shim: esp_log.h */
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+#include <stdint.h>
+#include "host_shim.h"
+
+#define ESP_LOGE(tag, fmt, ...) host_log(HOST_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) host_log(HOST_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) host_log(HOST_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) ((void)(tag))
+
+uint32_t esp_log_timestamp(void);
+
+#endif /* ESP_LOG_H */
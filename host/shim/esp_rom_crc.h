@@ -0,0 +1,11 @@
+/* Host shim: esp_rom_crc.h */
+#ifndef ESP_ROM_CRC_H
+#define ESP_ROM_CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Same result as the ROM routine (and zlib's crc32) */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif /* ESP_ROM_CRC_H */
@@ -0,0 +1,9 @@
+/* Host shim: esp_timer.h */
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include "host_shim.h"
+
+#define esp_timer_get_time() host_time_us()
+
+#endif /* ESP_TIMER_H */
@@ -0,0 +1,15 @@
+/* Host shim: semphr.h; with one thread, a take never waits for a give */
+#ifndef FREERTOS_SEMPHR_H
+#define FREERTOS_SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_semaphore *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+#endif /* FREERTOS_SEMPHR_H */
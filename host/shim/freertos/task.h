@@ -0,0 +1,10 @@
+/* Host shim: task.h; a delay just moves the simulated clock */
+#ifndef FREERTOS_TASK_H
+#define FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+#endif /* FREERTOS_TASK_H */
@@ -0,0 +1,285 @@
+/*
+ * Host Shims
+ * Just enough of ESP-IDF and FreeRTOS to build the firmware's portable
+ * modules on a desktop, driven by one simulated clock
+ */
+
+#define _POSIX_C_SOURCE 200809L /* clock_gettime */
+
+#include "host_shim.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* As in partitions.csv */
+#define ASSETS_SUBTYPE 0x40
+#define ASSETS_LABEL "assets"
+
+static int64_t now_us = 0;
+static int log_level = HOST_LOG_WARN;
+
+/* ---- Time ---- */
+int64_t host_time_us(void)
+{
+    return now_us;
+}
+
+void host_advance_us(int64_t us)
+{
+    if (us > 0)
+    {
+        now_us += us;
+    }
+}
+
+uint32_t host_tick_ms(void)
+{
+    return (uint32_t)(now_us / 1000);
+}
+
+int64_t host_wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return host_tick_ms();
+}
+
+/* ---- Logging ---- */
+void host_log_set_level(int level)
+{
+    log_level = level;
+}
+
+void host_log(int level, const char *tag, const char *fmt, ...)
+{
+    static const char letters[] = "-EWI";
+    if (level > log_level)
+    {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%c (%lu) %s: ", letters[level], (unsigned long)host_tick_ms(), tag);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_CRC:
+        return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION:
+        return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_NVS_NOT_FOUND:
+        return "ESP_ERR_NVS_NOT_FOUND";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+/* ---- CRC ---- */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+/* ---- FreeRTOS ---- */
+struct host_semaphore
+{
+    int count;
+};
+
+static SemaphoreHandle_t semaphore_create(int count)
+{
+    SemaphoreHandle_t sem = calloc(1, sizeof(*sem));
+    if (sem != NULL)
+    {
+        sem->count = count;
+    }
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return semaphore_create(0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return semaphore_create(1);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (sem->count > 0)
+    {
+        return pdFALSE;
+    }
+    sem->count = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait)
+{
+    (void)wait; /* Nobody else could give it meanwhile */
+    if (sem->count == 0)
+    {
+        return pdFALSE;
+    }
+    sem->count = 0;
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    free(sem);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    host_advance_us((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(host_time_us() / (portTICK_PERIOD_MS * 1000));
+}
+
+/* ---- NVS: nothing stored, writes accepted and forgotten ---- */
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+/* ---- Partitions: the assets image, read into memory ---- */
+static esp_partition_t assets_partition = {
+    .type = ESP_PARTITION_TYPE_DATA,
+    .subtype = ASSETS_SUBTYPE,
+    .label = ASSETS_LABEL,
+};
+static uint8_t *assets_data = NULL;
+
+bool host_partition_load(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = size > 0 ? malloc(size) : NULL;
+    bool ok = data != NULL && fread(data, 1, size, f) == (size_t)size;
+    fclose(f);
+    if (!ok)
+    {
+        free(data);
+        return false;
+    }
+    free(assets_data);
+    assets_data = data;
+    assets_partition.size = (uint32_t)size;
+    return true;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, int subtype, const char *label)
+{
+    if (assets_data == NULL || type != assets_partition.type || subtype != assets_partition.subtype ||
+        (label != NULL && strcmp(label, assets_partition.label) != 0))
+    {
+        return NULL;
+    }
+    return &assets_partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (src_offset > partition->size || size > partition->size - src_offset)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, assets_data + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle)
+{
+    if (offset > partition->size || size > partition->size - offset)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out_ptr = assets_data + offset;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle)
+{
+}
@@ -0,0 +1,63 @@
+/*
+ * Host Shims
+ * Just enough of ESP-IDF and FreeRTOS to build the firmware's portable
+ * modules on a desktop, driven by one simulated clock
+ */
+
+#ifndef HOST_SHIM_H
+#define HOST_SHIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Log levels, as in esp_log.h */
+#define HOST_LOG_NONE 0
+#define HOST_LOG_ERROR 1
+#define HOST_LOG_WARN 2
+#define HOST_LOG_INFO 3
+
+    /**
+     * @brief Simulated time in microseconds; esp_timer and LVGL ticks follow it
+     */
+    int64_t host_time_us(void);
+
+    /**
+     * @brief Move the simulated clock forward
+     */
+    void host_advance_us(int64_t us);
+
+    /**
+     * @brief LVGL tick (LV_TICK_CUSTOM_SYS_TIME_EXPR)
+     */
+    uint32_t host_tick_ms(void);
+
+    /**
+     * @brief Real monotonic time in nanoseconds, for measuring work
+     */
+    int64_t host_wall_ns(void);
+
+    /**
+     * @brief Most verbose level printed by ESP_LOGx (HOST_LOG_WARN by default)
+     */
+    void host_log_set_level(int level);
+
+    void host_log(int level, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+    /**
+     * @brief Serve esp_partition_* from @p path as the "assets" partition
+     *
+     * @return false if the file cannot be read
+     */
+    bool host_partition_load(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_SHIM_H */
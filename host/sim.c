@@ -0,0 +1,623 @@
+/*
+ * Host Simulator
+ * Replays a recorded MQTT trace through the firmware's parser, filters,
+ * dedup and batching into the real robot face and coin rain, rendered
+ * headlessly, and reports frame and parser costs as JSON
+ */
+
+#include "anim_timeline.h"
+#include "assets.h"
+#include "coin_rain.h"
+#include "host_shim.h"
+#include "lvgl.h"
+#include "robot_face.h"
+#include "sale_batch.h"
+#include "sale_dedup.h"
+#include "sale_parser.h"
+#include "sale_router.h"
+#include "topic_config.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* As in main.c */
+#define LCD_RES 240
+#define LCD_BUF_ROWS 50
+#define CELEBRATE_SUCCESS_MS 2200
+#define CELEBRATE_IDLE_MS 3700
+
+#define TRACE_LINE_MAX (SALE_MSG_MAX_LEN * 2 + 256) /* Hex payloads take two characters a byte */
+#define DEFAULT_PARSE_RUNS 2000
+#define SETTLE_MS 500 /* Keep rendering this long after the last celebration */
+
+typedef struct
+{
+    int64_t at_us; /* From the first message */
+    topic_scope_t scope;
+    bool binary;
+    char *payload;
+    size_t len;
+} trace_msg_t;
+
+static struct
+{
+    uint32_t messages;
+    uint32_t sales;
+    uint32_t filtered;
+    uint32_t malformed;
+    uint32_t commands;
+    uint32_t skipped; /* Lines on topics the device does not subscribe to */
+    uint32_t batches;
+    uint64_t handle_ns; /* Wall time in the message path during replay */
+} counts;
+
+static struct
+{
+    uint32_t frames;
+    uint64_t px;
+    uint64_t frame_px; /* Pixels of the frame being flushed */
+    int64_t *frame_ns; /* Wall time of each lv_timer_handler() run that produced a frame */
+    size_t cap;
+} render;
+
+/* ---- Allocation counting (-Wl,--wrap=malloc,...) ---- */
+#if HOST_COUNT_ALLOCS
+static uint64_t allocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    allocs++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    allocs++;
+    return __real_realloc(ptr, size);
+}
+
+static uint64_t alloc_count(void)
+{
+    return allocs;
+}
+#else
+static uint64_t alloc_count(void)
+{
+    return 0;
+}
+#endif
+
+/* ---- Trace ---- */
+static bool parse_topic(const char *topic, topic_scope_t *scope, bool *binary)
+{
+    size_t len = strlen(topic);
+    if (strncmp(topic, "moneybot/", 9) != 0 || len < 13)
+    {
+        return false;
+    }
+    if (strcmp(topic + len - 4, "/bin") == 0)
+    {
+        *binary = true;
+    }
+    else if (strcmp(topic + len - 4, "/cmd") == 0)
+    {
+        *binary = false;
+    }
+    else
+    {
+        return false;
+    }
+
+    const char *rest = topic + 9;
+    if (strncmp(rest, "fleet/", 6) == 0)
+    {
+        *scope = TOPIC_SCOPE_FLEET;
+    }
+    else if (strncmp(rest, "group/", 6) == 0)
+    {
+        *scope = TOPIC_SCOPE_GROUP;
+    }
+    else
+    {
+        *scope = TOPIC_SCOPE_DEVICE;
+    }
+    return true;
+}
+
+static bool unhex(const char *hex, char *out, size_t *len)
+{
+    size_t n = strlen(hex);
+    if (n % 2 != 0)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < n / 2; i++)
+    {
+        unsigned byte;
+        if (sscanf(hex + 2 * i, "%2x", &byte) != 1)
+        {
+            return false;
+        }
+        out[i] = (char)byte;
+    }
+    *len = n / 2;
+    return true;
+}
+
+/* "<seconds> <topic> <payload>" per line, as mosquitto_sub -F '%U %t %p'
+ * prints it (use %x for /bin topics); times are made relative to the first */
+static trace_msg_t *load_trace(const char *path, size_t *count)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        fprintf(stderr, "moneybot_sim: cannot open %s\n", path);
+        return NULL;
+    }
+
+    trace_msg_t *msgs = NULL;
+    size_t n = 0, cap = 0;
+    double first = -1;
+    char line[TRACE_LINE_MAX];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+        {
+            continue;
+        }
+
+        char topic[TOPIC_MAX_LEN + 1];
+        double at;
+        int used = 0;
+        if (sscanf(line, "%lf %96s %n", &at, topic, &used) != 2 || used == 0)
+        {
+            fprintf(stderr, "moneybot_sim: %s:%d: expected <seconds> <topic> <payload>\n", path, lineno);
+            continue;
+        }
+
+        trace_msg_t m = {0};
+        if (!parse_topic(topic, &m.scope, &m.binary))
+        {
+            counts.skipped++;
+            continue;
+        }
+        const char *payload = line + used;
+        m.payload = malloc(strlen(payload) + 1);
+        if (m.binary ? !unhex(payload, m.payload, &m.len) : (strcpy(m.payload, payload), m.len = strlen(payload), false))
+        {
+            fprintf(stderr, "moneybot_sim: %s:%d: bad hex payload\n", path, lineno);
+            free(m.payload);
+            continue;
+        }
+
+        if (first < 0)
+        {
+            first = at;
+        }
+        m.at_us = (int64_t)((at - first) * 1e6);
+        if (n == cap)
+        {
+            cap = cap ? cap * 2 : 64;
+            msgs = realloc(msgs, cap * sizeof(*msgs));
+        }
+        msgs[n++] = m;
+    }
+    fclose(f);
+    *count = n;
+    return msgs;
+}
+
+/* ---- Celebration, as main.c runs it (LED and latency tracing left out) ---- */
+static anim_timeline_t celebration;
+static uint32_t celebration_sales = 0;
+static int64_t celebration_amount = 0;
+static uint32_t today_sales = 0;
+static char total_text[32];
+
+static void phase_celebrate(void *user_data)
+{
+    robot_face_set_eye_color(COL_GOLD);
+    robot_face_set_sales(celebration_sales);
+    robot_face_open_mouth();
+    coin_rain_burst(celebration_amount);
+}
+
+static void phase_success(void *user_data)
+{
+    robot_face_set_eye_color(COL_GREEN);
+    robot_face_close_mouth();
+}
+
+static void phase_idle(void *user_data)
+{
+    coin_rain_clear();
+    robot_face_set_eye_color(COL_CYAN);
+    robot_face_set_antenna_color(COL_GREEN); /* MQTT connected */
+    celebration_sales = 0;
+    celebration_amount = 0;
+}
+
+static const anim_timeline_phase_t celebration_phases[] = {
+    {.name = "celebrate", .at_ms = 0, .cb = phase_celebrate},
+    {.name = "success", .at_ms = CELEBRATE_SUCCESS_MS, .cb = phase_success},
+    {.name = "idle", .at_ms = CELEBRATE_IDLE_MS, .cb = phase_idle},
+};
+
+static void trigger(const sale_batch_t *batch)
+{
+    counts.batches++;
+    today_sales += batch->count;
+    snprintf(total_text, sizeof(total_text), "%" PRIu32 " today", today_sales);
+    robot_face_set_total(total_text);
+
+    celebration_sales += batch->count;
+    int64_t amount = 0;
+    for (int i = 0; i < batch->num_currencies; i++)
+    {
+        if (batch->totals[i].amount > amount)
+        {
+            amount = batch->totals[i].amount;
+        }
+    }
+    if (amount > celebration_amount)
+    {
+        celebration_amount = amount;
+    }
+
+    if (!celebration.running)
+    {
+        anim_timeline_start(&celebration);
+    }
+    else if (anim_timeline_current_phase(&celebration) == 0)
+    {
+        robot_face_set_sales(celebration_sales);
+        coin_rain_burst(amount);
+        anim_timeline_seek(&celebration, 1);
+    }
+    else
+    {
+        anim_timeline_seek(&celebration, 0);
+    }
+}
+
+/* ---- Message path: the firmware's own, minus the command handlers ---- */
+static topic_config_t topics_cfg;
+static sale_dedup_t dedup;
+static const sale_router_t router = {.topics = &topics_cfg, .dedup = &dedup};
+
+static void handle_message(const trace_msg_t *m)
+{
+    sale_event_t event;
+    int64_t start = host_wall_ns();
+    switch (sale_router_handle(&router, m->payload, m->len, m->scope, m->binary, &event))
+    {
+    case SALE_ROUTE_QUEUED:
+        counts.sales++;
+        break;
+    case SALE_ROUTE_FILTERED:
+        counts.filtered++;
+        break;
+    case SALE_ROUTE_COMMAND:
+        counts.commands++;
+        break;
+    case SALE_ROUTE_TOLERATED:
+        counts.sales++;
+        counts.malformed++;
+        break;
+    case SALE_ROUTE_DROPPED:
+        counts.malformed++;
+        break;
+    default:
+        break;
+    }
+    counts.handle_ns += host_wall_ns() - start;
+    counts.messages++;
+}
+
+/* ---- Headless display ---- */
+static void flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    render.frame_px += (uint64_t)lv_area_get_size(area);
+    if (lv_disp_flush_is_last(drv))
+    {
+        render.frames++;
+        render.px += render.frame_px;
+        render.frame_px = 0;
+    }
+    lv_disp_flush_ready(drv);
+}
+
+static void display_init(void)
+{
+    static lv_color_t buf[LCD_RES * LCD_BUF_ROWS];
+    static lv_disp_draw_buf_t draw_buf;
+    static lv_disp_drv_t drv;
+
+    lv_init();
+    lv_disp_draw_buf_init(&draw_buf, buf, NULL, LCD_RES * LCD_BUF_ROWS);
+    lv_disp_drv_init(&drv);
+    drv.hor_res = LCD_RES;
+    drv.ver_res = LCD_RES;
+    drv.flush_cb = flush_cb;
+    drv.draw_buf = &draw_buf;
+    lv_disp_drv_register(&drv);
+}
+
+static const lv_font_t *ui_font(const char *name)
+{
+    const lv_font_t *font = assets_font(name);
+    return font != NULL ? font : LV_FONT_DEFAULT;
+}
+
+static void scene_create(void)
+{
+    lv_obj_t *scr = lv_scr_act();
+    lv_obj_set_style_bg_color(scr, lv_color_hex(COL_BG), 0);
+    lv_obj_set_style_bg_opa(scr, LV_OPA_COVER, 0);
+    lv_obj_clear_flag(scr, LV_OBJ_FLAG_SCROLLABLE);
+
+    const robot_face_fonts_t fonts = {
+        .mouth = ui_font("montserrat_16"),
+        .total = ui_font("montserrat_14"),
+        .coin = ui_font("montserrat_20"),
+    };
+    robot_face_create(scr, &fonts);
+    robot_face_set_antenna_color(COL_GREEN);
+    anim_timeline_init(&celebration, celebration_phases,
+                       sizeof(celebration_phases) / sizeof(celebration_phases[0]), NULL);
+}
+
+/* One LVGL run, timed when it put a frame out; returns ms until the next */
+static uint32_t render_step(void)
+{
+    uint32_t frames = render.frames;
+    int64_t start = host_wall_ns();
+    uint32_t wait_ms = lv_timer_handler();
+    int64_t elapsed = host_wall_ns() - start;
+
+    if (render.frames != frames)
+    {
+        if (render.cap == 0 || render.frames > render.cap)
+        {
+            render.cap = render.cap ? render.cap * 2 : 1024;
+            render.frame_ns = realloc(render.frame_ns, render.cap * sizeof(int64_t));
+        }
+        render.frame_ns[render.frames - 1] = elapsed;
+    }
+    return wait_ms;
+}
+
+/* ---- Reports ---- */
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+typedef struct
+{
+    uint32_t runs;
+    uint64_t msgs;
+    uint64_t bytes;
+    int64_t ns;
+    uint64_t allocs;
+} parse_bench_t;
+
+/* Parser alone, looped over every payload in the trace */
+static parse_bench_t parse_bench(const trace_msg_t *msgs, size_t n, uint32_t runs)
+{
+    parse_bench_t b = {.runs = runs};
+    volatile int32_t sink = 0; /* Keeps the loop from being optimized out */
+    uint64_t allocs_before = alloc_count();
+    int64_t start = host_wall_ns();
+    for (uint32_t r = 0; r < runs; r++)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            sale_event_t event;
+            if (msgs[i].binary)
+            {
+                sale_parse_binary((const uint8_t *)msgs[i].payload, msgs[i].len, &event);
+            }
+            else
+            {
+                sale_parse_json(msgs[i].payload, msgs[i].len, &event);
+            }
+            sink += event.amount;
+            b.bytes += msgs[i].len;
+        }
+    }
+    b.ns = host_wall_ns() - start;
+    b.allocs = alloc_count() - allocs_before;
+    b.msgs = (uint64_t)runs * n;
+    (void)sink;
+    return b;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: moneybot_sim [options] <trace>\n"
+            "  --assets FILE      assets image with the UI fonts (default: the one built with the simulator)\n"
+            "  --topics JSON      {\"type\":\"topics\"} payload setting the scope filters\n"
+            "  --parse-runs N     parser benchmark passes over the trace (default %d)\n"
+            "  --max-frame-us N   exit 2 if the p99 frame time is above N\n"
+            "  -v                 firmware logs at info level\n",
+            DEFAULT_PARSE_RUNS);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL;
+    const char *assets_path = HOST_DEFAULT_ASSETS;
+    const char *topics_json = NULL;
+    uint32_t parse_runs = DEFAULT_PARSE_RUNS;
+    int64_t max_frame_us = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--assets") == 0 && i + 1 < argc)
+        {
+            assets_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--topics") == 0 && i + 1 < argc)
+        {
+            topics_json = argv[++i];
+        }
+        else if (strcmp(argv[i], "--parse-runs") == 0 && i + 1 < argc)
+        {
+            parse_runs = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--max-frame-us") == 0 && i + 1 < argc)
+        {
+            max_frame_us = strtoll(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "-v") == 0)
+        {
+            host_log_set_level(HOST_LOG_INFO);
+        }
+        else if (argv[i][0] != '-' && trace_path == NULL)
+        {
+            trace_path = argv[i];
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (trace_path == NULL)
+    {
+        usage();
+        return 1;
+    }
+
+    topic_config_load("moneybot", &topics_cfg); /* Defaults: no filters */
+    topics_cfg.fleet = true;
+    if (topics_json != NULL && !topic_config_apply_json(&topics_cfg, topics_json, strlen(topics_json)))
+    {
+        fprintf(stderr, "moneybot_sim: invalid --topics\n");
+        return 1;
+    }
+
+    size_t n = 0;
+    trace_msg_t *msgs = load_trace(trace_path, &n);
+    if (msgs == NULL)
+    {
+        return 1;
+    }
+
+    if (assets_path[0] != '\0' && !host_partition_load(assets_path))
+    {
+        fprintf(stderr, "moneybot_sim: no assets image at %s; using the fallback font\n", assets_path);
+    }
+    assets_init();
+    sale_batch_init();
+    display_init();
+    scene_create();
+
+    /* Replay on the simulated clock: LVGL runs whenever it asks to, and
+     * every message is handled at its recorded offset */
+    size_t next = 0;
+    int64_t idle_since = 0;
+    while (1)
+    {
+        uint32_t wait_ms = render_step();
+
+        while (next < n && msgs[next].at_us <= host_time_us())
+        {
+            handle_message(&msgs[next++]);
+        }
+        sale_batch_t batch;
+        if (sale_batch_take(&batch, 0))
+        {
+            trigger(&batch);
+        }
+
+        bool busy = next < n || celebration.running || coin_rain_active() > 0;
+        if (busy)
+        {
+            idle_since = host_time_us();
+        }
+        else if (host_time_us() - idle_since >= (int64_t)SETTLE_MS * 1000)
+        {
+            break;
+        }
+
+        int64_t step_us = (int64_t)(wait_ms ? wait_ms : 1) * 1000;
+        if (next < n && msgs[next].at_us - host_time_us() < step_us)
+        {
+            step_us = msgs[next].at_us - host_time_us();
+        }
+        host_advance_us(step_us > 0 ? step_us : 1000);
+    }
+
+    parse_bench_t bench = parse_bench(msgs, n, parse_runs);
+
+    int64_t p[4] = {0}; /* min, avg, p99, max in us */
+    if (render.frames > 0)
+    {
+        int64_t sum = 0;
+        for (uint32_t i = 0; i < render.frames; i++)
+        {
+            sum += render.frame_ns[i];
+        }
+        qsort(render.frame_ns, render.frames, sizeof(int64_t), cmp_i64);
+        p[0] = render.frame_ns[0] / 1000;
+        p[1] = sum / render.frames / 1000;
+        p[2] = render.frame_ns[(render.frames - 1) * 99 / 100] / 1000;
+        p[3] = render.frame_ns[render.frames - 1] / 1000;
+    }
+
+    coin_rain_stats_t rain;
+    coin_rain_get_stats(&rain);
+    lv_mem_monitor_t mem;
+    lv_mem_monitor(&mem);
+
+    printf("{\"type\":\"sim\",\"trace\":\"%s\",\"sim_ms\":%" PRId64 ","
+           "\"msgs\":{\"total\":%" PRIu32 ",\"sales\":%" PRIu32 ",\"dups\":%" PRIu32 ",\"filtered\":%" PRIu32
+           ",\"malformed\":%" PRIu32 ",\"commands\":%" PRIu32 ",\"skipped\":%" PRIu32 ",\"batches\":%" PRIu32
+           ",\"handle_ns\":%" PRIu64 "},"
+           "\"frames\":%" PRIu32 ",\"frame_us\":[%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 "],"
+           "\"px_per_frame\":%" PRIu64 ","
+           "\"rain\":{\"spawned\":%" PRIu32 ",\"trimmed\":%" PRIu32 ",\"peak_live\":%" PRIu32 "},"
+           "\"parse\":{\"runs\":%" PRIu32 ",\"msgs\":%" PRIu64 ",\"ns_per_msg\":%.1f,\"mb_s\":%.1f,\"allocs\":%" PRIu64
+           "},"
+           "\"lvgl_mem\":{\"max_used\":%lu,\"frag_pct\":%u}}\n",
+           trace_path, host_time_us() / 1000, counts.messages, counts.sales, dedup.duplicates, counts.filtered,
+           counts.malformed, counts.commands, counts.skipped, counts.batches,
+           counts.messages ? counts.handle_ns / counts.messages : 0, render.frames, p[0], p[1], p[2], p[3],
+           render.frames ? render.px / render.frames : 0, rain.spawned, rain.trimmed, rain.peak_live, bench.runs,
+           bench.msgs, bench.msgs ? (double)bench.ns / bench.msgs : 0.0,
+           bench.ns ? bench.bytes * 1e3 / bench.ns : 0.0, bench.allocs, (unsigned long)mem.max_used,
+           mem.frag_pct);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        free(msgs[i].payload);
+    }
+    free(msgs);
+    free(render.frame_ns);
+
+    if (max_frame_us > 0 && p[2] > max_frame_us)
+    {
+        fprintf(stderr, "moneybot_sim: p99 frame time %" PRId64 " us is over the %" PRId64 " us budget\n", p[2],
+                max_frame_us);
+        return 2;
+    }
+    return 0;
+}
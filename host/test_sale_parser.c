@@ -0,0 +1,501 @@
+/*
+ * Sale Parser Tests
+ * The in-place JSON and binary decoders and MQTT reassembly, checked
+ * against the cJSON behaviour the firmware used to get from
+ * cJSON_Parse/cJSON_GetObjectItem
+ */
+
+#include "sale_dedup.h"
+#include "sale_parser.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                                        \
+    do                                                                                     \
+    {                                                                                      \
+        if (!(cond))                                                                       \
+        {                                                                                  \
+            fprintf(stderr, "%s:%d: %s: CHECK(%s) failed\n", __FILE__, __LINE__, __func__, #cond); \
+            failures++;                                                                    \
+        }                                                                                  \
+    } while (0)
+
+static sale_parse_result_t parse(const char *json, sale_event_t *event)
+{
+    return sale_parse_json(json, strlen(json), event);
+}
+
+/* ---- JSON ---- */
+static void test_json_sale(void)
+{
+    sale_event_t e;
+    CHECK(parse("{\"type\":\"sale\",\"status\":\"succeeded\",\"amount\":2000,\"currency\":\"usd\","
+                "\"eventId\":\"evt_123\",\"ts\":1760400000123}",
+                &e) == SALE_PARSE_OK);
+    CHECK(e.amount == 2000);
+    CHECK(strcmp(e.currency, "usd") == 0);
+    CHECK(strcmp(e.event_id, "evt_123") == 0);
+    CHECK(strcmp(e.type, "sale") == 0);
+    CHECK(e.origin_ms == 1760400000123LL);
+    CHECK(e.event_hash == sale_dedup_hash("evt_123"));
+
+    /* Whitespace anywhere, members in any order, no status */
+    CHECK(parse(" \r\n{ \"amount\" :\t5 ,\n\"type\" : \"sale\" } ", &e) == SALE_PARSE_OK);
+    CHECK(e.amount == 5);
+    CHECK(e.event_hash == 0);
+
+    /* Not NUL-terminated: only len bytes are read */
+    const char buf[] = "{\"type\":\"sale\"}XXXX";
+    CHECK(sale_parse_json(buf, 15, &e) == SALE_PARSE_OK);
+    CHECK(sale_parse_json(buf, 14, &e) == SALE_PARSE_MALFORMED);
+}
+
+static void test_json_truncated(void)
+{
+    static const char full[] = "{\"type\":\"sale\",\"amount\":12,\"meta\":{\"a\":[1,2,{\"b\":\"x\\\"y\"}]},"
+                               "\"eventId\":\"evt_\\u00e9\"}";
+    sale_event_t e;
+    CHECK(sale_parse_json(full, sizeof(full) - 1, &e) == SALE_PARSE_OK);
+    /* cJSON_Parse fails on every proper prefix of an object */
+    for (size_t len = 0; len < sizeof(full) - 1; len++)
+    {
+        if (sale_parse_json(full, len, &e) != SALE_PARSE_MALFORMED)
+        {
+            fprintf(stderr, "prefix of %zu bytes parsed\n", len);
+            failures++;
+        }
+    }
+}
+
+static void test_json_malformed(void)
+{
+    static const char *const bad[] = {
+        "",
+        "sale: 50.00 USD",
+        "[1,2]",                       /* Not an object */
+        "{",
+        "{\"type\"}",
+        "{\"type\":}",
+        "{\"type\":\"sale\",}",
+        "{\"type\":\"sale\" \"amount\":1}",
+        "{\"type\":\"sa",              /* Unterminated string */
+        "{\"type\":\"s\\x\"}",         /* Unknown escape */
+        "{\"type\":\"\\u12\"}",        /* Short \u */
+        "{\"type\":\"\\u12g4\"}",
+        "{\"type\":\"a\nb\"}",         /* Raw control character; stricter than cJSON */
+        "{\"meta\":{\"a\":[1,2}]}",    /* Mismatched brackets */
+        "{\"meta\":[[[[[]]]]}",        /* Unterminated nesting */
+        "{\"meta\":{\"a\":{\"b\":1}}",
+        "{\"amount\":+5}",             /* cJSON numbers start with - or a digit */
+        "{\"amount\":-}",
+        "{\"amount\":1.2.3}",
+        "{\"amount\":.5}",
+        "{\"flag\":tru}",
+        "{\"flag\":nul}",
+        "{\"x\":undefined}",
+        "{'type':'sale'}",
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        sale_event_t e;
+        memset(&e, 0xA5, sizeof(e));
+        if (parse(bad[i], &e) != SALE_PARSE_MALFORMED)
+        {
+            fprintf(stderr, "parsed: %s\n", bad[i]);
+            failures++;
+        }
+        CHECK(e.amount == 0 && e.type[0] == '\0' && e.event_hash == 0); /* Zeroed */
+    }
+}
+
+/* "deep": @p depth containers, arrays and objects alternating */
+static size_t nested(char *json, size_t depth)
+{
+    size_t n = (size_t)sprintf(json, "{\"type\":\"sale\",\"deep\":");
+    for (size_t i = 0; i < depth; i++)
+    {
+        n += (size_t)sprintf(json + n, "%s", i % 2 ? "{\"k\":" : "[");
+    }
+    n += (size_t)sprintf(json + n, "1");
+    for (size_t i = depth; i-- > 0;)
+    {
+        json[n++] = i % 2 ? '}' : ']';
+    }
+    json[n++] = '}';
+    return n;
+}
+
+static void test_json_nesting(void)
+{
+    static char json[8 * SALE_MSG_MAX_LEN];
+    sale_event_t e;
+
+    /* Deep but closed nesting in a skipped member */
+    size_t n = nested(json, 200);
+    CHECK(n <= SALE_MSG_MAX_LEN);
+    CHECK(sale_parse_json(json, n, &e) == SALE_PARSE_OK);
+    /* One closer short, and one closer of the wrong kind */
+    CHECK(sale_parse_json(json, n - 2, &e) == SALE_PARSE_MALFORMED);
+    json[n - 2] = json[n - 2] == ']' ? '}' : ']';
+    CHECK(sale_parse_json(json, n, &e) == SALE_PARSE_MALFORMED);
+
+    /* Deeper than a message could hold is rejected (cJSON stops at 1000) */
+    n = nested(json, SALE_MSG_MAX_LEN);
+    CHECK(sale_parse_json(json, n, &e) == SALE_PARSE_MALFORMED);
+
+    /* Brackets inside skipped strings do not count */
+    CHECK(parse("{\"type\":\"sale\",\"note\":{\"s\":\"]}[{\"}}", &e) == SALE_PARSE_OK);
+}
+
+static void test_json_keys(void)
+{
+    sale_event_t e;
+    /* Case-insensitive, like cJSON_GetObjectItem */
+    CHECK(parse("{\"TYPE\":\"sale\",\"Amount\":7,\"EVENTID\":\"a\"}", &e) == SALE_PARSE_OK);
+    CHECK(e.amount == 7);
+    CHECK(strcmp(e.event_id, "a") == 0);
+    /* Values keep their case: "Sale" is not a sale */
+    CHECK(parse("{\"type\":\"Sale\"}", &e) == SALE_PARSE_IGNORED);
+
+    /* Duplicate keys: the first occurrence wins */
+    CHECK(parse("{\"type\":\"sale\",\"type\":\"diag\",\"amount\":1,\"amount\":2}", &e) == SALE_PARSE_OK);
+    CHECK(strcmp(e.type, "sale") == 0);
+    CHECK(e.amount == 1);
+    CHECK(parse("{\"type\":\"diag\",\"TYPE\":\"sale\"}", &e) == SALE_PARSE_IGNORED);
+    CHECK(parse("{\"type\":1,\"type\":\"sale\"}", &e) == SALE_PARSE_IGNORED);
+
+    /* Keys too long to be one we know are skipped, not truncated into one */
+    CHECK(parse("{\"typeXXXXXXXXXXXXXXXX\":\"sale\"}", &e) == SALE_PARSE_IGNORED);
+    CHECK(parse("{\"amountXXXXXXXXXXXXXXX\":5,\"type\":\"sale\"}", &e) == SALE_PARSE_OK);
+    CHECK(e.amount == 0);
+    /* Escapes in keys are decoded before matching */
+    CHECK(parse("{\"t\\u0079pe\":\"sale\"}", &e) == SALE_PARSE_OK);
+}
+
+static void test_json_types(void)
+{
+    sale_event_t e;
+    /* type must be the string "sale" (cJSON_IsString) */
+    CHECK(parse("{\"type\":1}", &e) == SALE_PARSE_IGNORED);
+    CHECK(parse("{\"type\":null}", &e) == SALE_PARSE_IGNORED);
+    CHECK(parse("{\"type\":[\"sale\"]}", &e) == SALE_PARSE_IGNORED);
+    CHECK(parse("{\"type\":{\"sale\":true}}", &e) == SALE_PARSE_IGNORED);
+    CHECK(parse("{}", &e) == SALE_PARSE_IGNORED);
+    /* Longer types are truncated and never match */
+    CHECK(parse("{\"type\":\"saleXXXXXXXXXXXXXXXXXX\"}", &e) == SALE_PARSE_IGNORED);
+    CHECK(strlen(e.type) == SALE_TYPE_MAX_LEN - 1);
+
+    /* A status that is not a string counts as succeeded; any other string does not */
+    CHECK(parse("{\"type\":\"sale\",\"status\":1}", &e) == SALE_PARSE_OK);
+    CHECK(parse("{\"type\":\"sale\",\"status\":null}", &e) == SALE_PARSE_OK);
+    CHECK(parse("{\"type\":\"sale\",\"status\":\"pending\"}", &e) == SALE_PARSE_IGNORED);
+    CHECK(parse("{\"type\":\"sale\",\"status\":\"SUCCEEDED\"}", &e) == SALE_PARSE_IGNORED);
+    CHECK(strcmp(e.type, "sale") == 0); /* Still filled for the command dispatch */
+
+    /* Non-string currency and eventId are left empty */
+    CHECK(parse("{\"type\":\"sale\",\"currency\":840,\"eventId\":12345}", &e) == SALE_PARSE_OK);
+    CHECK(e.currency[0] == '\0' && e.event_id[0] == '\0' && e.event_hash == 0);
+    /* Non-number amount and ts are left 0 */
+    CHECK(parse("{\"type\":\"sale\",\"amount\":\"20\",\"ts\":\"1\"}", &e) == SALE_PARSE_OK);
+    CHECK(e.amount == 0 && e.origin_ms == 0);
+    CHECK(parse("{\"type\":\"sale\",\"ts\":-5}", &e) == SALE_PARSE_OK);
+    CHECK(e.origin_ms == 0);
+}
+
+static int32_t amount_of(const char *number)
+{
+    char json[128];
+    snprintf(json, sizeof(json), "{\"type\":\"sale\",\"amount\":%s}", number);
+    sale_event_t e;
+    if (parse(json, &e) != SALE_PARSE_OK)
+    {
+        fprintf(stderr, "amount %s did not parse\n", number);
+        failures++;
+        return -12345;
+    }
+    return e.amount;
+}
+
+static void test_json_numbers(void)
+{
+    /* cJSON: valueint is valuedouble truncated and clamped to int */
+    CHECK(amount_of("0") == 0);
+    CHECK(amount_of("-0") == 0);
+    CHECK(amount_of("007") == 7);
+    CHECK(amount_of("12.9") == 12);
+    CHECK(amount_of("-12.9") == -12);
+    CHECK(amount_of("1e3") == 1000);
+    CHECK(amount_of("1E+3") == 1000);
+    CHECK(amount_of("2.5e1") == 25);
+    CHECK(amount_of("15e-1") == 1);
+    CHECK(amount_of("1e-400") == 0);
+    CHECK(amount_of("2147483647") == INT32_MAX);
+    CHECK(amount_of("2147483648") == INT32_MAX);
+    CHECK(amount_of("-2147483648") == INT32_MIN);
+    CHECK(amount_of("-2147483649") == INT32_MIN);
+    CHECK(amount_of("99999999999999999999999") == INT32_MAX);
+    CHECK(amount_of("-99999999999999999999999") == INT32_MIN);
+    CHECK(amount_of("1e400") == INT32_MAX);
+    CHECK(amount_of("-1e400") == INT32_MIN);
+    CHECK(amount_of("1.0000000000000000000000000000000000000001") == 1); /* Over 32 characters */
+
+    /* ts keeps 64 bits */
+    sale_event_t e;
+    CHECK(parse("{\"type\":\"sale\",\"ts\":1760400000123.7}", &e) == SALE_PARSE_OK);
+    CHECK(e.origin_ms == 1760400000123LL);
+    CHECK(parse("{\"type\":\"sale\",\"ts\":99999999999999999999}", &e) == SALE_PARSE_OK);
+    CHECK(e.origin_ms == INT64_MAX);
+    CHECK(parse("{\"type\":\"sale\",\"ts\":1.7604e12}", &e) == SALE_PARSE_OK);
+    CHECK(e.origin_ms == 1760400000000LL);
+}
+
+static void test_json_strings(void)
+{
+    sale_event_t e;
+    CHECK(parse("{\"type\":\"sale\",\"eventId\":\"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t\"}", &e) == SALE_PARSE_OK);
+    CHECK(strcmp(e.event_id, "a\"b\\c/d\b\f\n\r\t") == 0);
+    CHECK(parse("{\"type\":\"sale\",\"eventId\":\"\\u0041\\u00e9\\u20ac\"}", &e) == SALE_PARSE_OK);
+    CHECK(strcmp(e.event_id, "A\xc3\xa9\xe2\x82\xac") == 0);
+    /* Unlike cJSON, surrogates are not paired up: each half becomes '?' */
+    CHECK(parse("{\"type\":\"sale\",\"eventId\":\"\\ud83d\\udcb0\"}", &e) == SALE_PARSE_OK);
+    CHECK(strcmp(e.event_id, "??") == 0);
+    /* Raw UTF-8 passes through */
+    CHECK(parse("{\"type\":\"sale\",\"eventId\":\"caf\xc3\xa9\"}", &e) == SALE_PARSE_OK);
+    CHECK(strcmp(e.event_id, "caf\xc3\xa9") == 0);
+}
+
+/* The hash covers the whole id even where event_id is cut short */
+static void test_json_event_hash(void)
+{
+    char id_a[201], id_b[201];
+    memset(id_a, 'a', 200);
+    id_a[200] = '\0';
+    memcpy(id_b, id_a, sizeof(id_b));
+    id_b[150] = 'b';
+
+    char json[300];
+    sale_event_t a, b;
+    snprintf(json, sizeof(json), "{\"type\":\"sale\",\"eventId\":\"%s\"}", id_a);
+    CHECK(parse(json, &a) == SALE_PARSE_OK);
+    snprintf(json, sizeof(json), "{\"type\":\"sale\",\"eventId\":\"%s\"}", id_b);
+    CHECK(parse(json, &b) == SALE_PARSE_OK);
+
+    CHECK(strlen(a.event_id) == sizeof(a.event_id) - 1);
+    CHECK(strcmp(a.event_id, b.event_id) == 0); /* Same shown prefix... */
+    CHECK(a.event_hash != b.event_hash);        /* ...different sales */
+    CHECK(a.event_hash == sale_dedup_hash(id_a));
+
+    /* Escapes hash as their decoded bytes, as a publisher hashing the id would */
+    CHECK(parse("{\"type\":\"sale\",\"eventId\":\"evt_\\u00e9\"}", &a) == SALE_PARSE_OK);
+    CHECK(a.event_hash == sale_dedup_hash("evt_\xc3\xa9"));
+    /* An empty id is no id */
+    CHECK(parse("{\"type\":\"sale\",\"eventId\":\"\"}", &a) == SALE_PARSE_OK);
+    CHECK(a.event_hash == 0);
+}
+
+static void test_json_members(void)
+{
+    static const char cmd[] = "{\"type\":\"topics\",\"GROUP\":\"lobby\",\"fleet\":false,\"fleet_min\":1e3,"
+                              "\"nested\":{\"group\":\"no\"},\"long\":\"0123456789\"}";
+    char out[8];
+    int64_t n;
+    bool flag;
+    CHECK(sale_json_get_string(cmd, sizeof(cmd) - 1, "group", out, sizeof(out)));
+    CHECK(strcmp(out, "lobby") == 0);
+    CHECK(!sale_json_get_string(cmd, sizeof(cmd) - 1, "long", out, sizeof(out))); /* Does not fit */
+    CHECK(!sale_json_get_string(cmd, sizeof(cmd) - 1, "fleet", out, sizeof(out))); /* Not a string */
+    CHECK(!sale_json_get_string(cmd, sizeof(cmd) - 1, "missing", out, sizeof(out)));
+    CHECK(sale_json_get_bool(cmd, sizeof(cmd) - 1, "fleet", &flag) && !flag);
+    CHECK(sale_json_get_int(cmd, sizeof(cmd) - 1, "fleet_min", &n) && n == 1000);
+    CHECK(!sale_json_get_int(cmd, sizeof(cmd) - 1, "group", &n));
+    /* Malformed before the member */
+    CHECK(!sale_json_get_string("{\"a\":[}, \"group\":\"x\"}", 22, "group", out, sizeof(out)));
+}
+
+/* ---- Binary ---- */
+static void put_le64(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static void make_record(uint8_t *r, size_t len)
+{
+    memset(r, 0, len);
+    r[0] = SALE_BIN_VERSION;
+    r[1] = SALE_BIN_TYPE_SALE;
+    r[2] = SALE_BIN_STATUS_SUCCEEDED;
+    r[4] = 0xd0; /* 2000 */
+    r[5] = 0x07;
+    memcpy(r + 8, "usd", 3);
+    put_le64(r + 12, sale_dedup_hash("evt_123"));
+    put_le64(r + 20, 1760400000123ULL);
+}
+
+static void test_binary(void)
+{
+    uint8_t r[64];
+    sale_event_t e;
+
+    make_record(r, SALE_BIN_LEN);
+    CHECK(sale_parse_binary(r, SALE_BIN_LEN, &e) == SALE_PARSE_OK);
+    CHECK(e.amount == 2000);
+    CHECK(strcmp(e.currency, "usd") == 0);
+    CHECK(strcmp(e.type, "sale") == 0);
+    CHECK(e.origin_ms == 1760400000123LL);
+    CHECK(e.event_hash == sale_dedup_hash("evt_123"));
+    CHECK(strlen(e.event_id) == 16); /* The hash in hex */
+
+    /* Every short length is rejected and reads nothing past it */
+    for (size_t len = 0; len < SALE_BIN_LEN; len++)
+    {
+        uint8_t copy[SALE_BIN_LEN];
+        memcpy(copy, r, len);
+        if (sale_parse_binary(copy, len, &e) != SALE_PARSE_MALFORMED)
+        {
+            fprintf(stderr, "binary record of %zu bytes parsed\n", len);
+            failures++;
+        }
+    }
+
+    /* A longer record from a newer firmware: the tail is ignored */
+    make_record(r, sizeof(r));
+    memset(r + SALE_BIN_LEN, 0xFF, sizeof(r) - SALE_BIN_LEN);
+    CHECK(sale_parse_binary(r, sizeof(r), &e) == SALE_PARSE_OK);
+    CHECK(e.amount == 2000);
+
+    make_record(r, SALE_BIN_LEN);
+    r[0] = SALE_BIN_VERSION + 1;
+    CHECK(sale_parse_binary(r, SALE_BIN_LEN, &e) == SALE_PARSE_MALFORMED);
+
+    /* Currency: three letters, lowercased, or all NUL */
+    make_record(r, SALE_BIN_LEN);
+    memcpy(r + 8, "EUR", 3);
+    CHECK(sale_parse_binary(r, SALE_BIN_LEN, &e) == SALE_PARSE_OK);
+    CHECK(strcmp(e.currency, "eur") == 0);
+    memset(r + 8, 0, 3);
+    CHECK(sale_parse_binary(r, SALE_BIN_LEN, &e) == SALE_PARSE_OK);
+    CHECK(e.currency[0] == '\0');
+    memcpy(r + 8, "u1d", 3);
+    CHECK(sale_parse_binary(r, SALE_BIN_LEN, &e) == SALE_PARSE_MALFORMED);
+    memcpy(r + 8, "\0sd", 3);
+    CHECK(sale_parse_binary(r, SALE_BIN_LEN, &e) == SALE_PARSE_MALFORMED);
+
+    /* Status and type map onto the JSON names */
+    make_record(r, SALE_BIN_LEN);
+    r[2] = SALE_BIN_STATUS_PENDING;
+    CHECK(sale_parse_binary(r, SALE_BIN_LEN, &e) == SALE_PARSE_IGNORED);
+    CHECK(strcmp(e.type, "sale") == 0);
+    r[1] = SALE_BIN_TYPE_DIAG;
+    CHECK(sale_parse_binary(r, SALE_BIN_LEN, &e) == SALE_PARSE_IGNORED);
+    CHECK(strcmp(e.type, "diag") == 0);
+    r[1] = 99;
+    CHECK(sale_parse_binary(r, SALE_BIN_LEN, &e) == SALE_PARSE_IGNORED);
+    CHECK(e.type[0] == '\0');
+
+    /* Negative amount kept, negative ts dropped, no id */
+    make_record(r, SALE_BIN_LEN);
+    memset(r + 4, 0xFF, 4);
+    memset(r + 12, 0, 8);
+    put_le64(r + 20, (uint64_t)-1);
+    CHECK(sale_parse_binary(r, SALE_BIN_LEN, &e) == SALE_PARSE_OK);
+    CHECK(e.amount == -1 && e.origin_ms == 0 && e.event_hash == 0 && e.event_id[0] == '\0');
+}
+
+/* ---- Reassembly ---- */
+static sale_reassembly_t ra;
+
+static sale_frag_result_t feed(const char *data, size_t len, size_t offset, size_t total, const char **msg,
+                               size_t *msg_len)
+{
+    return sale_reassembly_feed(&ra, data, len, offset, total, msg, msg_len);
+}
+
+static void test_reassembly(void)
+{
+    static const char payload[] = "{\"type\":\"sale\",\"amount\":1}";
+    const size_t total = sizeof(payload) - 1;
+    const char *msg = NULL;
+    size_t msg_len = 0;
+    memset(&ra, 0, sizeof(ra));
+
+    /* Unfragmented: handed back in place */
+    CHECK(feed(payload, total, 0, total, &msg, &msg_len) == SALE_FRAG_COMPLETE);
+    CHECK(msg == payload && msg_len == total);
+
+    /* In three pieces */
+    CHECK(feed(payload, 5, 0, total, &msg, &msg_len) == SALE_FRAG_PENDING);
+    CHECK(feed(payload + 5, 10, 5, total, &msg, &msg_len) == SALE_FRAG_PENDING);
+    CHECK(feed(payload + 15, total - 15, 15, total, &msg, &msg_len) == SALE_FRAG_COMPLETE);
+    CHECK(msg == ra.buf && msg_len == total && memcmp(msg, payload, total) == 0);
+    CHECK(ra.messages == 2 && ra.fragmented == 1);
+    /* A stray chunk after completion needs a new start */
+    CHECK(feed(payload, 3, total, total, &msg, &msg_len) == SALE_FRAG_DROPPED);
+
+    /* Out of order: a gap, then the rest of the message is dropped */
+    CHECK(feed(payload, 5, 0, total, &msg, &msg_len) == SALE_FRAG_PENDING);
+    CHECK(feed(payload + 10, 5, 10, total, &msg, &msg_len) == SALE_FRAG_DROPPED);
+    CHECK(feed(payload + 5, 5, 5, total, &msg, &msg_len) == SALE_FRAG_DROPPED);
+    CHECK(ra.dropped == 1);
+
+    /* Repeated chunk */
+    CHECK(feed(payload, 5, 0, total, &msg, &msg_len) == SALE_FRAG_PENDING);
+    CHECK(feed(payload, 5, 0, total, &msg, &msg_len) == SALE_FRAG_PENDING); /* Offset 0 restarts */
+    CHECK(feed(payload + 3, 5, 3, total, &msg, &msg_len) == SALE_FRAG_DROPPED);
+    CHECK(ra.dropped == 2);
+
+    /* A total that changes mid-message */
+    CHECK(feed(payload, 5, 0, total, &msg, &msg_len) == SALE_FRAG_PENDING);
+    CHECK(feed(payload + 5, 5, 5, total + 1, &msg, &msg_len) == SALE_FRAG_DROPPED);
+
+    /* A chunk running past the announced total */
+    CHECK(feed(payload, 5, 0, total, &msg, &msg_len) == SALE_FRAG_PENDING);
+    CHECK(feed(payload + 5, total, 5, total, &msg, &msg_len) == SALE_FRAG_DROPPED);
+
+    /* Oversize: rejected up front, its remaining chunks dropped without copying */
+    static char big[SALE_MSG_MAX_LEN + 100];
+    memset(big, ' ', sizeof(big));
+    uint32_t dropped = ra.dropped;
+    CHECK(feed(big, 100, 0, sizeof(big), &msg, &msg_len) == SALE_FRAG_OVERSIZE);
+    CHECK(feed(big + 100, SALE_MSG_MAX_LEN, 100, sizeof(big), &msg, &msg_len) == SALE_FRAG_DROPPED);
+    CHECK(ra.oversize == 1 && ra.dropped == dropped);
+    /* Exactly the limit is fine, in one piece or several */
+    CHECK(feed(big, SALE_MSG_MAX_LEN, 0, SALE_MSG_MAX_LEN, &msg, &msg_len) == SALE_FRAG_COMPLETE);
+    CHECK(feed(big, 1000, 0, SALE_MSG_MAX_LEN, &msg, &msg_len) == SALE_FRAG_PENDING);
+    CHECK(feed(big + 1000, SALE_MSG_MAX_LEN - 1000, 1000, SALE_MSG_MAX_LEN, &msg, &msg_len) ==
+          SALE_FRAG_COMPLETE);
+    CHECK(msg_len == SALE_MSG_MAX_LEN);
+
+    /* The next message after any of that arrives intact */
+    CHECK(feed(payload, total, 0, total, &msg, &msg_len) == SALE_FRAG_COMPLETE);
+    CHECK(msg == payload);
+}
+
+int main(void)
+{
+    test_json_sale();
+    test_json_truncated();
+    test_json_malformed();
+    test_json_nesting();
+    test_json_keys();
+    test_json_types();
+    test_json_numbers();
+    test_json_strings();
+    test_json_event_hash();
+    test_json_members();
+    test_binary();
+    test_reassembly();
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("sale_parser: all checks passed\n");
+    return 0;
+}
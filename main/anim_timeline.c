@@ -0,0 +1,107 @@
+/*
+ * Animation Timeline
+ * Declarative, non-blocking phase sequencer driven by an lv_timer inside
+ * the LVGL task
+ */
+
+#include "anim_timeline.h"
+
+/* Re-arm the timer for the next pending phase, or park it when done */
+static void schedule_next(anim_timeline_t *tl)
+{
+    if (!tl->running || tl->next >= tl->num_phases)
+    {
+        tl->running = false;
+        lv_timer_pause(tl->timer);
+        return;
+    }
+
+    uint32_t elapsed = anim_timeline_elapsed(tl);
+    uint32_t at = tl->phases[tl->next].at_ms;
+    if (at <= elapsed)
+    {
+        lv_timer_ready(tl->timer);
+    }
+    else
+    {
+        lv_timer_set_period(tl->timer, at - elapsed);
+        lv_timer_reset(tl->timer);
+    }
+    lv_timer_resume(tl->timer);
+}
+
+static void timeline_timer_cb(lv_timer_t *timer)
+{
+    anim_timeline_t *tl = timer->user_data;
+
+    /* Phase callbacks may seek or stop; re-read state after each one */
+    while (tl->running && tl->next < tl->num_phases &&
+           tl->phases[tl->next].at_ms <= anim_timeline_elapsed(tl))
+    {
+        const anim_timeline_phase_t *phase = &tl->phases[tl->next++];
+        LV_LOG_INFO("timeline phase '%s' at %lu ms", phase->name,
+                    (unsigned long)anim_timeline_elapsed(tl));
+        if (phase->cb)
+        {
+            phase->cb(tl->user_data);
+        }
+    }
+
+    schedule_next(tl);
+}
+
+void anim_timeline_init(anim_timeline_t *tl, const anim_timeline_phase_t *phases,
+                        size_t num_phases, void *user_data)
+{
+    tl->phases = phases;
+    tl->num_phases = num_phases;
+    tl->user_data = user_data;
+    tl->next = 0;
+    tl->running = false;
+    tl->start_tick = lv_tick_get();
+    tl->timer = lv_timer_create(timeline_timer_cb, 1000, tl);
+    lv_timer_pause(tl->timer);
+}
+
+void anim_timeline_start(anim_timeline_t *tl)
+{
+    tl->start_tick = lv_tick_get();
+    tl->next = 0;
+    tl->running = true;
+    schedule_next(tl);
+}
+
+void anim_timeline_seek(anim_timeline_t *tl, uint32_t ms)
+{
+    tl->start_tick = lv_tick_get() - ms;
+    tl->next = 0;
+    while (tl->next < tl->num_phases && tl->phases[tl->next].at_ms < ms)
+    {
+        tl->next++;
+    }
+    tl->running = true;
+    schedule_next(tl);
+}
+
+void anim_timeline_stop(anim_timeline_t *tl, bool run_last)
+{
+    bool was_running = tl->running;
+    tl->running = false;
+    tl->next = tl->num_phases;
+    lv_timer_pause(tl->timer);
+
+    if (run_last && was_running && tl->num_phases > 0 && tl->phases[tl->num_phases - 1].cb)
+    {
+        tl->phases[tl->num_phases - 1].cb(tl->user_data);
+    }
+}
+
+uint32_t anim_timeline_elapsed(const anim_timeline_t *tl)
+{
+    return lv_tick_elaps(tl->start_tick);
+}
+
+int anim_timeline_current_phase(const anim_timeline_t *tl)
+{
+    return (int)tl->next - 1;
+}
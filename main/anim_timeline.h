@@ -0,0 +1,91 @@
+/*
+ * Animation Timeline
+ * Declarative, non-blocking phase sequencer driven by an lv_timer inside
+ * the LVGL task
+ */
+
+#ifndef ANIM_TIMELINE_H
+#define ANIM_TIMELINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef void (*anim_timeline_cb_t)(void *user_data);
+
+    /**
+     * @brief One step of a timeline: @p cb runs @p at_ms after the start
+     */
+    typedef struct
+    {
+        const char *name;
+        uint32_t at_ms;
+        anim_timeline_cb_t cb;
+    } anim_timeline_phase_t;
+
+    /**
+     * @brief Timeline state; phases must be sorted by at_ms
+     */
+    typedef struct
+    {
+        const anim_timeline_phase_t *phases;
+        size_t num_phases;
+        void *user_data;
+        lv_timer_t *timer;
+        uint32_t start_tick;
+        size_t next;
+        bool running;
+    } anim_timeline_t;
+
+    /*
+     * All functions below must be called from the LVGL task or with the
+     * LVGL port lock held. Phase callbacks run in the LVGL task.
+     */
+
+    /**
+     * @brief Bind a phase table to a timeline (creates a paused lv_timer)
+     */
+    void anim_timeline_init(anim_timeline_t *tl, const anim_timeline_phase_t *phases,
+                            size_t num_phases, void *user_data);
+
+    /**
+     * @brief Start from 0 ms; a running timeline is restarted
+     */
+    void anim_timeline_start(anim_timeline_t *tl);
+
+    /**
+     * @brief Move the clock to @p ms without replaying earlier phases
+     *
+     * Phases at or after @p ms run again at their offsets, so seeking back
+     * extends a running sequence in flight.
+     */
+    void anim_timeline_seek(anim_timeline_t *tl, uint32_t ms);
+
+    /**
+     * @brief Interrupt the timeline
+     *
+     * @param run_last Run the final phase first, e.g. to restore the idle state
+     */
+    void anim_timeline_stop(anim_timeline_t *tl, bool run_last);
+
+    /**
+     * @brief Milliseconds since the (possibly seeked) start
+     */
+    uint32_t anim_timeline_elapsed(const anim_timeline_t *tl);
+
+    /**
+     * @brief Index of the last phase that ran, or -1 if none has yet
+     */
+    int anim_timeline_current_phase(const anim_timeline_t *tl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ANIM_TIMELINE_H */
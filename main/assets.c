@@ -0,0 +1,351 @@
+/*
+ * Asset Partition
+ * Subsetted fonts and portal pages built by main/assets/pack_assets.py,
+ * memory-mapped from the "assets" partition and used in place
+ */
+
+#include "assets.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include <string.h>
+
+static const char *TAG = "assets";
+
+#define IMAGE_MAGIC "MBAS"
+#define IMAGE_VERSION 1
+#define FONT_MAGIC "LVFT"
+#define FONT_VERSION 1
+#define NAME_LEN 24
+
+#if LV_FONT_FMT_TXT_LARGE
+#error "Font entries store the compact glyph descriptor; disable LV_FONT_FMT_TXT_LARGE"
+#endif
+_Static_assert(sizeof(lv_font_fmt_txt_glyph_dsc_t) == 8, "glyph descriptor layout differs from pack_assets.py");
+
+/* Layouts written by pack_assets.py; keep the two in step */
+typedef struct
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t count;
+    uint32_t size; /* Whole image, header included */
+    uint32_t reserved;
+} image_header_t;
+
+typedef struct
+{
+    char name[NAME_LEN];
+    uint32_t offset; /* From the image start */
+    uint32_t size;
+    uint32_t crc;
+} image_entry_t;
+
+typedef struct
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t glyph_count; /* Including reserved glyph 0 */
+    uint32_t range_start; /* One sparse cmap: glyph i + 1 is range_start + unicode_list[i] */
+    uint16_t range_length;
+    uint16_t list_length;
+    uint16_t line_height;
+    int16_t base_line;
+    uint16_t kern_scale;
+    int8_t underline_position;
+    uint8_t underline_thickness;
+    uint8_t bpp;
+    uint8_t bitmap_format;
+    uint8_t has_kern;
+    uint8_t kern_classes;
+    uint8_t left_class_cnt;
+    uint8_t right_class_cnt;
+    uint16_t reserved;
+    /* Offsets from the font entry start, 0 when absent */
+    uint32_t glyph_dsc;
+    uint32_t bitmap;
+    uint32_t unicode_list;
+    uint32_t kern_left; /* Left classes, or the pair glyph ids */
+    uint32_t kern_right;
+    uint32_t kern_values;
+    uint32_t pair_cnt;
+} font_header_t;
+
+_Static_assert(sizeof(image_header_t) == 16, "image header layout");
+_Static_assert(sizeof(image_entry_t) == 36, "image entry layout");
+_Static_assert(sizeof(font_header_t) == 60, "font header layout");
+
+typedef enum
+{
+    ENTRY_UNCHECKED,
+    ENTRY_OK,
+    ENTRY_CORRUPT,
+} entry_state_t;
+
+typedef struct
+{
+    const char *name; /* The entry's, in flash */
+    lv_font_t font;
+    lv_font_fmt_txt_dsc_t dsc;
+    lv_font_fmt_txt_cmap_t cmap;
+    union
+    {
+        lv_font_fmt_txt_kern_classes_t classes;
+        lv_font_fmt_txt_kern_pair_t pairs;
+    } kern;
+    lv_font_fmt_txt_glyph_cache_t cache;
+} asset_font_t;
+
+static const uint8_t *image = NULL;
+static const image_header_t *header = NULL;
+static const image_entry_t *entries = NULL;
+static esp_partition_mmap_handle_t map_handle;
+
+/* Read and written from any task; a race only repeats the CRC check */
+static volatile uint8_t entry_state[ASSETS_MAX_ENTRIES];
+
+/* Fonts are opened under the LVGL lock */
+static asset_font_t fonts[ASSETS_MAX_FONTS];
+static int num_fonts = 0;
+
+esp_err_t assets_init(void)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ASSETS_PARTITION_SUBTYPE,
+                                                           ASSETS_PARTITION_LABEL);
+    if (part == NULL)
+    {
+        ESP_LOGE(TAG, "No \"%s\" partition; flash the partition table", ASSETS_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    /* Map only what the image uses */
+    image_header_t hdr;
+    esp_err_t err = esp_partition_read(part, 0, &hdr, sizeof(hdr));
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    if (memcmp(hdr.magic, IMAGE_MAGIC, 4) != 0)
+    {
+        ESP_LOGE(TAG, "Assets partition is empty; run idf.py flash");
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (hdr.version != IMAGE_VERSION)
+    {
+        ESP_LOGE(TAG, "Assets image version %u, firmware reads %u", hdr.version, IMAGE_VERSION);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (hdr.size > part->size || hdr.count > ASSETS_MAX_ENTRIES ||
+        sizeof(hdr) + (size_t)hdr.count * sizeof(image_entry_t) > hdr.size)
+    {
+        ESP_LOGE(TAG, "Assets image header is corrupt");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const void *ptr;
+    err = esp_partition_mmap(part, 0, hdr.size, ESP_PARTITION_MMAP_DATA, &ptr, &map_handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to map assets: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    const image_entry_t *table = (const image_entry_t *)((const uint8_t *)ptr + sizeof(image_header_t));
+    for (int i = 0; i < hdr.count; i++)
+    {
+        if (table[i].offset > hdr.size || table[i].size > hdr.size - table[i].offset ||
+            (table[i].offset & 3) != 0 || memchr(table[i].name, '\0', NAME_LEN) == NULL)
+        {
+            ESP_LOGE(TAG, "Assets entry %d is out of bounds", i);
+            esp_partition_munmap(map_handle);
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+    image = ptr;
+    header = ptr;
+    entries = table;
+    ESP_LOGI(TAG, "%u assets, %lu bytes mapped at %p", hdr.count, (unsigned long)hdr.size, ptr);
+    return ESP_OK;
+}
+
+static int find_entry(const char *name)
+{
+    for (int i = 0; i < header->count; i++)
+    {
+        if (strncmp(entries[i].name, name, NAME_LEN) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+esp_err_t assets_get(const char *name, asset_t *out)
+{
+    if (entries == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int i = find_entry(name);
+    if (i < 0)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const image_entry_t *e = &entries[i];
+    if (entry_state[i] == ENTRY_UNCHECKED)
+    {
+        bool ok = esp_rom_crc32_le(0, image + e->offset, e->size) == e->crc;
+        entry_state[i] = ok ? ENTRY_OK : ENTRY_CORRUPT;
+        if (!ok)
+        {
+            ESP_LOGE(TAG, "Asset %s is corrupt", name);
+        }
+    }
+    if (entry_state[i] == ENTRY_CORRUPT)
+    {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    out->data = image + e->offset;
+    out->size = e->size;
+    out->crc = e->crc;
+    return ESP_OK;
+}
+
+/* Section at @p ofs holding @p len bytes, or NULL if it is absent or overruns */
+static const void *font_section(const asset_t *a, uint32_t ofs, size_t len)
+{
+    if (ofs == 0 || ofs > a->size || len > a->size - ofs || (ofs & 3) != 0)
+    {
+        return NULL;
+    }
+    return a->data + ofs;
+}
+
+static bool load_font(const asset_t *a, asset_font_t *f)
+{
+    const font_header_t *h = (const font_header_t *)a->data;
+    if (a->size < sizeof(*h) || memcmp(h->magic, FONT_MAGIC, 4) != 0 || h->version != FONT_VERSION ||
+        h->glyph_count != h->list_length + 1)
+    {
+        return false;
+    }
+
+    const void *glyph_dsc = font_section(a, h->glyph_dsc, (size_t)h->glyph_count * sizeof(lv_font_fmt_txt_glyph_dsc_t));
+    const void *unicode_list = font_section(a, h->unicode_list, (size_t)h->list_length * sizeof(uint16_t));
+    const void *bitmap = h->bitmap ? font_section(a, h->bitmap, 0) : a->data; /* No bitmap: only blank glyphs */
+    if (glyph_dsc == NULL || unicode_list == NULL || bitmap == NULL)
+    {
+        return false;
+    }
+
+    f->cmap = (lv_font_fmt_txt_cmap_t){
+        .range_start = h->range_start,
+        .range_length = h->range_length,
+        .glyph_id_start = 1,
+        .unicode_list = unicode_list,
+        .glyph_id_ofs_list = NULL,
+        .list_length = h->list_length,
+        .type = LV_FONT_FMT_TXT_CMAP_SPARSE_TINY,
+    };
+
+    const void *kern = NULL;
+    bool kern_classes = h->has_kern && h->kern_classes;
+    if (kern_classes)
+    {
+        const void *left = font_section(a, h->kern_left, h->glyph_count);
+        const void *right = font_section(a, h->kern_right, h->glyph_count);
+        const void *values = font_section(a, h->kern_values, (size_t)h->left_class_cnt * h->right_class_cnt);
+        if (left == NULL || right == NULL || values == NULL)
+        {
+            return false;
+        }
+        f->kern.classes = (lv_font_fmt_txt_kern_classes_t){
+            .class_pair_values = values,
+            .left_class_mapping = left,
+            .right_class_mapping = right,
+            .left_class_cnt = h->left_class_cnt,
+            .right_class_cnt = h->right_class_cnt,
+        };
+        kern = &f->kern.classes;
+    }
+    else if (h->has_kern && h->pair_cnt > 0)
+    {
+        size_t id_size = h->glyph_count <= 256 ? 1 : 2;
+        const void *ids = font_section(a, h->kern_left, (size_t)h->pair_cnt * 2 * id_size);
+        const void *values = font_section(a, h->kern_values, h->pair_cnt);
+        if (ids == NULL || values == NULL)
+        {
+            return false;
+        }
+        f->kern.pairs = (lv_font_fmt_txt_kern_pair_t){
+            .glyph_ids = ids,
+            .values = values,
+            .pair_cnt = h->pair_cnt,
+            .glyph_ids_size = id_size == 1 ? 0 : 1,
+        };
+        kern = &f->kern.pairs;
+    }
+
+    f->dsc = (lv_font_fmt_txt_dsc_t){
+        .glyph_bitmap = bitmap,
+        .glyph_dsc = glyph_dsc,
+        .cmaps = &f->cmap,
+        .kern_dsc = kern,
+        .kern_scale = h->kern_scale,
+        .cmap_num = 1,
+        .bpp = h->bpp,
+        .kern_classes = kern_classes,
+        .bitmap_format = h->bitmap_format,
+        .cache = &f->cache,
+    };
+
+    f->font = (lv_font_t){
+        .get_glyph_dsc = lv_font_get_glyph_dsc_fmt_txt,
+        .get_glyph_bitmap = lv_font_get_bitmap_fmt_txt,
+        .line_height = h->line_height,
+        .base_line = h->base_line,
+        .subpx = LV_FONT_SUBPX_NONE,
+        .underline_position = h->underline_position,
+        .underline_thickness = h->underline_thickness,
+        .dsc = &f->dsc,
+    };
+    return true;
+}
+
+const lv_font_t *assets_font(const char *name)
+{
+    for (int i = 0; i < num_fonts; i++)
+    {
+        if (strncmp(fonts[i].name, name, NAME_LEN) == 0)
+        {
+            return &fonts[i].font;
+        }
+    }
+
+    asset_t a;
+    esp_err_t err = assets_get(name, &a);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Font %s unavailable: %s", name, esp_err_to_name(err));
+        return NULL;
+    }
+    if (num_fonts == ASSETS_MAX_FONTS)
+    {
+        ESP_LOGE(TAG, "Font pool full; raise ASSETS_MAX_FONTS for %s", name);
+        return NULL;
+    }
+
+    asset_font_t *f = &fonts[num_fonts];
+    memset(f, 0, sizeof(*f));
+    if (!load_font(&a, f))
+    {
+        ESP_LOGE(TAG, "Font %s is not a font this firmware reads", name);
+        return NULL;
+    }
+    f->name = (const char *)entries[find_entry(name)].name;
+    num_fonts++;
+    return &f->font;
+}
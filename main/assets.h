@@ -0,0 +1,65 @@
+/*
+ * Asset Partition
+ * Subsetted fonts and portal pages built by main/assets/pack_assets.py,
+ * memory-mapped from the "assets" partition and used in place
+ */
+
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Partition label and subtype, as in partitions.csv */
+#define ASSETS_PARTITION_LABEL "assets"
+#define ASSETS_PARTITION_SUBTYPE 0x40
+/* Entries an image may hold */
+#define ASSETS_MAX_ENTRIES 32
+/* Fonts that can be open at once */
+#define ASSETS_MAX_FONTS 4
+
+    typedef struct
+    {
+        const uint8_t *data; /* Points into mapped flash */
+        size_t size;
+        uint32_t crc; /* CRC32 of the data, stable until the image changes */
+    } asset_t;
+
+    /**
+     * @brief Map the partition and check the image header
+     *
+     * @return ESP_ERR_NOT_FOUND without the partition, ESP_ERR_INVALID_VERSION
+     *         for an image this firmware cannot read (flash the assets again)
+     */
+    esp_err_t assets_init(void);
+
+    /**
+     * @brief Look up an entry by name; its CRC is checked on first use
+     *
+     * @return ESP_ERR_INVALID_STATE before a successful assets_init(),
+     *         ESP_ERR_NOT_FOUND for an unknown name, ESP_ERR_INVALID_CRC for
+     *         a corrupt entry
+     */
+    esp_err_t assets_get(const char *name, asset_t *out);
+
+    /**
+     * @brief LVGL font over a font entry; glyphs are read straight from flash
+     *
+     * Repeated calls with the same name return the same font.
+     *
+     * @return NULL if the entry is missing, corrupt, or the font pool is full
+     */
+    const lv_font_t *assets_font(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ASSETS_H */
@@ -0,0 +1,310 @@
+#!/usr/bin/env python3
+"""Build the image flashed to the "assets" partition.
+
+Fonts are cut down to the glyphs listed in fonts.txt, straight from LVGL's
+built-in Montserrat sources, so no font tools are needed. Portal pages are
+stored plain and gzipped. The layout is what main/assets.c maps at runtime:
+
+    header   magic "MBAS", u16 version, u16 count, u32 image size, u32 0
+    entries  count x (char name[24], u32 offset, u32 size, u32 crc32)
+    data     each entry 4-byte aligned
+
+Font entries keep LVGL's own glyph descriptor and bitmap layout, so the
+firmware can point lv_font_t straight at flash.
+
+    pack_assets.py --lvgl <lvgl dir> --fonts fonts.txt --out assets.bin
+                   [--max-size N] [--file name=path ...]
+"""
+
+import argparse
+import gzip
+import os
+import re
+import struct
+import sys
+import zlib
+
+IMAGE_MAGIC = b"MBAS"
+IMAGE_VERSION = 1
+NAME_LEN = 24
+FONT_MAGIC = b"LVFT"
+FONT_VERSION = 1
+
+# Mirrors font_header_t in main/assets.c (naturally aligned, 60 bytes)
+FONT_HEADER = struct.Struct("<4sHHIHHHhHbBBBBBBBHIIIIIII")
+
+
+def fail(msg):
+    sys.exit(f"pack_assets: {msg}")
+
+
+def align4(buf):
+    buf.extend(b"\0" * (-len(buf) % 4))
+
+
+# ---------------------------------------------------------------------------
+# LVGL font source parsing
+# ---------------------------------------------------------------------------
+def strip_comments(src):
+    src = re.sub(r"/\*.*?\*/", "", src, flags=re.S)
+    return re.sub(r"//[^\n]*", "", src)
+
+
+def c_array(src, name, required=True):
+    m = re.search(r"\b" + re.escape(name) + r"\s*\[\s*\]\s*=\s*\{(.*?)\};", src, re.S)
+    if not m:
+        if required:
+            fail(f"array {name} not found")
+        return None
+    return [int(v, 0) for v in re.findall(r"-?(?:0x[0-9a-fA-F]+|\d+)", m.group(1))]
+
+
+def c_field(block, name, default=None):
+    m = re.search(r"\." + name + r"\s*=\s*([-&\w]+)", block)
+    if not m:
+        if default is None:
+            fail(f"field .{name} not found")
+        return default
+    value = m.group(1)
+    try:
+        return int(value, 0)
+    except ValueError:
+        return value
+
+
+def parse_font(path):
+    with open(path, encoding="utf-8") as f:
+        src = strip_comments(f.read())
+
+    bitmap = bytes(v & 0xFF for v in c_array(src, "glyph_bitmap"))
+
+    m = re.search(r"glyph_dsc\s*\[\s*\]\s*=\s*\{(.*?)\};", src, re.S)
+    if not m:
+        fail(f"{path}: glyph_dsc not found")
+    glyphs = []
+    for body in re.findall(r"\{([^{}]*)\}", m.group(1)):
+        glyphs.append({k: c_field(body, k, 0) for k in ("bitmap_index", "adv_w", "box_w", "box_h", "ofs_x", "ofs_y")})
+
+    m = re.search(r"cmaps\s*\[\s*\]\s*=\s*\{((?:\s*\{[^{}]*\}\s*,?)*)\s*\};", src)
+    if not m:
+        fail(f"{path}: cmaps not found")
+    cp_to_gid = {}
+    for body in re.findall(r"\{([^{}]*)\}", m.group(1)):
+        start = c_field(body, "range_start")
+        length = c_field(body, "range_length")
+        gid_start = c_field(body, "glyph_id_start")
+        kind = c_field(body, "type").replace("LV_FONT_FMT_TXT_CMAP_", "")
+        unicode_name = c_field(body, "unicode_list", "NULL")
+        ofs_name = c_field(body, "glyph_id_ofs_list", "NULL")
+        unicode_list = c_array(src, unicode_name) if unicode_name != "NULL" else None
+        ofs_list = c_array(src, ofs_name) if ofs_name != "NULL" else None
+        if kind == "FORMAT0_TINY":
+            for i in range(length):
+                cp_to_gid[start + i] = gid_start + i
+        elif kind == "FORMAT0_FULL":
+            for i in range(length):
+                if ofs_list[i] or i == 0:
+                    cp_to_gid[start + i] = gid_start + ofs_list[i]
+        elif kind == "SPARSE_TINY":
+            for i, u in enumerate(unicode_list):
+                cp_to_gid[start + u] = gid_start + i
+        elif kind == "SPARSE_FULL":
+            for i, u in enumerate(unicode_list):
+                cp_to_gid[start + u] = gid_start + ofs_list[i]
+        else:
+            fail(f"{path}: unknown cmap type {kind}")
+
+    font = {
+        "bitmap": bitmap,
+        "glyphs": glyphs,
+        "cmap": cp_to_gid,
+        "line_height": c_field(src, "line_height"),
+        "base_line": c_field(src, "base_line"),
+        "underline_position": c_field(src, "underline_position", 0),
+        "underline_thickness": c_field(src, "underline_thickness", 0),
+        "bpp": c_field(src, "bpp"),
+        "kern_scale": c_field(src, "kern_scale", 16),
+        "kern_classes": c_field(src, "kern_classes", 0),
+        "bitmap_format": c_field(src, "bitmap_format", 0),
+        "kern": None,
+    }
+
+    if c_field(src, "kern_dsc", "NULL") != "NULL":
+        if font["kern_classes"]:
+            font["kern"] = {
+                "left": c_array(src, "kern_left_class_mapping"),
+                "right": c_array(src, "kern_right_class_mapping"),
+                "values": c_array(src, "kern_class_values"),
+                "left_cnt": c_field(src, "left_class_cnt"),
+                "right_cnt": c_field(src, "right_class_cnt"),
+            }
+        else:
+            ids = c_array(src, "kern_pair_glyph_ids")
+            font["kern"] = {
+                "pairs": list(zip(ids[0::2], ids[1::2])),
+                "values": c_array(src, "kern_pair_values"),
+            }
+    return font
+
+
+# ---------------------------------------------------------------------------
+# Subsetting
+# ---------------------------------------------------------------------------
+def subset_font(font, codepoints, name):
+    missing = [cp for cp in codepoints if cp not in font["cmap"]]
+    if missing:
+        fail(f"{name}: no glyph for " + ", ".join(f"U+{cp:04X}" for cp in missing))
+    cps = sorted(codepoints)
+    if cps[-1] - cps[0] >= 0xFFFF:
+        fail(f"{name}: glyphs span 64K code points or more")
+
+    glyphs = font["glyphs"]
+    old_ids = [0] + [font["cmap"][cp] for cp in cps]  # New id -> old id; id 0 is reserved
+    new_id = {old: new for new, old in enumerate(old_ids)}
+
+    def bitmap_of(gid):
+        start = glyphs[gid]["bitmap_index"]
+        end = len(font["bitmap"])
+        for g in glyphs[gid + 1 :]:
+            if g["bitmap_index"] > start:
+                end = g["bitmap_index"]
+                break
+        return font["bitmap"][start:end] if glyphs[gid]["box_w"] else b""
+
+    bitmap = bytearray()
+    dsc = bytearray()
+    for old in old_ids:
+        g = glyphs[old]
+        data = bitmap_of(old) if old else b""
+        index = len(bitmap) if data else 0
+        if index >= 1 << 20 or g["adv_w"] >= 1 << 12:
+            fail(f"{name}: glyph too large for the compact descriptor")
+        bitmap += data
+        # lv_font_fmt_txt_glyph_dsc_t: bitmap_index:20, adv_w:12, box_w, box_h, ofs_x, ofs_y
+        dsc += struct.pack("<IBBbb", index | (g["adv_w"] << 20), g["box_w"], g["box_h"], g["ofs_x"], g["ofs_y"])
+
+    kern = font["kern"]
+    left = right = values = b""
+    left_cnt = right_cnt = 0
+    pair_cnt = 0
+    kern_classes = font["kern_classes"]
+    if kern and kern_classes:
+        left = bytes(kern["left"][old] for old in old_ids)
+        right = bytes(kern["right"][old] for old in old_ids)
+        values = struct.pack(f"<{len(kern['values'])}b", *kern["values"])
+        left_cnt, right_cnt = kern["left_cnt"], kern["right_cnt"]
+    elif kern:
+        # LVGL binary-searches the pairs, so keep them sorted by the new ids
+        kept = sorted((new_id[a], new_id[b], v) for (a, b), v in zip(kern["pairs"], kern["values"])
+                      if a in new_id and b in new_id)
+        pair_cnt = len(kept)
+        fmt = "<BB" if len(old_ids) <= 256 else "<HH"
+        left = b"".join(struct.pack(fmt, a, b) for a, b, _ in kept)  # Pair glyph ids
+        values = struct.pack(f"<{pair_cnt}b", *(v for _, _, v in kept))
+
+    unicode_list = struct.pack(f"<{len(cps)}H", *(cp - cps[0] for cp in cps))
+
+    body = bytearray()
+    offsets = []
+    for section in (bytes(dsc), bytes(bitmap), unicode_list, left, right, values):
+        align4(body)
+        offsets.append(FONT_HEADER.size + len(body) if section else 0)
+        body += section
+
+    header = FONT_HEADER.pack(
+        FONT_MAGIC, FONT_VERSION, len(old_ids),
+        cps[0], cps[-1] - cps[0] + 1, len(cps),
+        font["line_height"], font["base_line"], font["kern_scale"],
+        font["underline_position"], font["underline_thickness"],
+        font["bpp"], font["bitmap_format"], 1 if kern else 0, kern_classes, left_cnt, right_cnt, 0,
+        *offsets, pair_cnt,
+    )
+    saved = len(font["bitmap"]) + 8 * len(glyphs) - len(bitmap) - len(dsc)
+    print(f"  {name}: {len(cps)} of {len(glyphs) - 1} glyphs, {FONT_HEADER.size + len(body)} bytes ({saved} saved)")
+    return header + bytes(body)
+
+
+def parse_glyph_spec(spec, what):
+    """Space-separated ranges (0x20-0x7E, U+0024) and quoted text."""
+    cps = set()
+    for text in re.findall(r'"((?:[^"\\]|\\.)*)"', spec):
+        cps.update(ord(ch) for ch in text.encode().decode("unicode_escape"))
+    for token in re.sub(r'"(?:[^"\\]|\\.)*"', " ", spec).split():
+        m = re.fullmatch(r"(?:U\+|0x)([0-9a-fA-F]+)(?:-(?:U\+|0x)([0-9a-fA-F]+))?", token)
+        if not m:
+            fail(f"{what}: bad glyph range {token!r}")
+        lo = int(m.group(1), 16)
+        hi = int(m.group(2), 16) if m.group(2) else lo
+        cps.update(range(lo, hi + 1))
+    cps.discard(ord("\n"))
+    if not cps:
+        fail(f"{what}: no glyphs")
+    return cps
+
+
+def read_fonts_list(path):
+    fonts = []
+    with open(path, encoding="utf-8") as f:
+        for n, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            name, sep, spec = line.partition("=")
+            if not sep:
+                fail(f"{path}:{n}: expected <font> = <glyphs>")
+            fonts.append((name.strip(), parse_glyph_spec(spec, f"{path}:{n}")))
+    return fonts
+
+
+# ---------------------------------------------------------------------------
+# Image
+# ---------------------------------------------------------------------------
+def pack_image(entries):
+    table_size = 16 + len(entries) * (NAME_LEN + 12)
+    data = bytearray()
+    table = bytearray()
+    for name, blob in entries:
+        if len(name.encode()) >= NAME_LEN:
+            fail(f"asset name {name!r} too long")
+        align4(data)
+        table += struct.pack(f"<{NAME_LEN}sIII", name.encode(), table_size + len(data), len(blob), zlib.crc32(blob))
+        data += blob
+    align4(data)
+    size = table_size + len(data)
+    return struct.pack("<4sHHII", IMAGE_MAGIC, IMAGE_VERSION, len(entries), size, 0) + table + data
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--lvgl", required=True, help="LVGL component directory")
+    ap.add_argument("--fonts", required=True, help="fonts.txt: <font> = <glyphs> per line")
+    ap.add_argument("--file", action="append", default=[], metavar="NAME=PATH",
+                    help="store a file plain, and gzipped as NAME.gz")
+    ap.add_argument("--out", required=True)
+    ap.add_argument("--max-size", type=lambda v: int(v, 0), default=0)
+    args = ap.parse_args()
+
+    entries = []
+    for name, cps in read_fonts_list(args.fonts):
+        path = os.path.join(args.lvgl, "src", "font", f"lv_font_{name}.c")
+        if not os.path.exists(path):
+            fail(f"no LVGL source for font {name} ({path})")
+        entries.append((name, subset_font(parse_font(path), cps, name)))
+
+    for spec in args.file:
+        name, _, path = spec.partition("=")
+        with open(path, "rb") as f:
+            data = f.read()
+        entries.append((name, data))
+        entries.append((name + ".gz", gzip.compress(data, compresslevel=9, mtime=0)))
+
+    image = pack_image(entries)
+    if args.max_size and len(image) > args.max_size:
+        fail(f"image is {len(image)} bytes, partition holds {args.max_size}")
+    with open(args.out, "wb") as f:
+        f.write(image)
+    print(f"  assets: {len(entries)} entries, {len(image)} bytes")
+
+
+if __name__ == "__main__":
+    main()
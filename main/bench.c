@@ -0,0 +1,134 @@
+/*
+ * On-Target Benchmarks
+ * Cycle-counted timing loops with heap deltas, collected into one report
+ * and written as JSON so builds, clocks and boards can be compared
+ */
+
+#include "bench.h"
+#include "esp_app_desc.h"
+#include "esp_chip_info.h"
+#include "esp_heap_caps.h"
+#include "esp_idf_version.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CALIBRATION_RUNS 32
+
+#if CONFIG_COMPILER_OPTIMIZATION_PERF
+#define OPT_LEVEL "perf"
+#elif CONFIG_COMPILER_OPTIMIZATION_SIZE
+#define OPT_LEVEL "size"
+#elif CONFIG_COMPILER_OPTIMIZATION_NONE
+#define OPT_LEVEL "none"
+#else
+#define OPT_LEVEL "debug"
+#endif
+
+void bench_report_init(bench_report_t *report, uint32_t pclk_hz)
+{
+    memset(report, 0, sizeof(*report));
+    report->pclk_hz = pclk_hz;
+    report->start_us = esp_timer_get_time();
+
+    /* The cheapest of a few empty samples; an interrupt can only add */
+    uint32_t overhead = UINT32_MAX;
+    for (int i = 0; i < CALIBRATION_RUNS; i++)
+    {
+        uint32_t start = bench_cycles();
+        uint32_t cycles = bench_cycles() - start;
+        if (cycles < overhead)
+        {
+            overhead = cycles;
+        }
+    }
+    report->overhead_cycles = overhead;
+}
+
+bench_case_t *bench_case_begin(bench_report_t *report, const char *name)
+{
+    if (report->count == BENCH_MAX_CASES)
+    {
+        return NULL;
+    }
+    bench_case_t *c = &report->cases[report->count++];
+    memset(c, 0, sizeof(*c));
+    c->name = name;
+    c->min_cycles = UINT32_MAX;
+    c->overhead = report->overhead_cycles;
+    c->heap_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    c->internal_before = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    return c;
+}
+
+void bench_case_sample(bench_case_t *c, uint32_t start_cycles)
+{
+    if (c == NULL)
+    {
+        return;
+    }
+    uint32_t cycles = bench_cycles() - start_cycles;
+    cycles = cycles > c->overhead ? cycles - c->overhead : 0;
+
+    c->runs++;
+    c->total_cycles += cycles;
+    if (cycles < c->min_cycles)
+    {
+        c->min_cycles = cycles;
+    }
+    if (cycles > c->max_cycles)
+    {
+        c->max_cycles = cycles;
+    }
+}
+
+void bench_case_end(bench_case_t *c)
+{
+    if (c == NULL)
+    {
+        return;
+    }
+    c->heap_delta = (int32_t)(c->heap_before - heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+    c->internal_delta = (int32_t)(c->internal_before - heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+}
+
+size_t bench_format_json(const bench_report_t *report, char *buf, size_t size)
+{
+    esp_chip_info_t chip;
+    esp_chip_info(&chip);
+
+    size_t pos = 0;
+#define APPEND(...)                                                  \
+    do                                                               \
+    {                                                                \
+        int n = snprintf(buf + pos, size - pos, __VA_ARGS__);        \
+        if (n < 0 || (size_t)n >= size - pos)                        \
+        {                                                            \
+            return 0;                                                \
+        }                                                            \
+        pos += (size_t)n;                                            \
+    } while (0)
+
+    APPEND("{\"type\":\"bench\",\"app\":\"%s\",\"idf\":\"%s\",\"chip\":{\"model\":%d,\"rev\":%u,\"cores\":%u},"
+           "\"cpu_mhz\":%lu,\"freertos_hz\":%d,\"opt\":\"" OPT_LEVEL "\",\"flash\":\"%s\",\"pclk_hz\":%lu,"
+           "\"overhead_cycles\":%lu,\"elapsed_ms\":%lu,\"cases\":[",
+           esp_app_get_description()->version, esp_get_idf_version(), (int)chip.model, (unsigned)chip.revision,
+           (unsigned)chip.cores, (unsigned long)esp_rom_get_cpu_ticks_per_us(), CONFIG_FREERTOS_HZ,
+           CONFIG_ESPTOOLPY_FLASHFREQ, (unsigned long)report->pclk_hz, (unsigned long)report->overhead_cycles,
+           (unsigned long)((esp_timer_get_time() - report->start_us) / 1000));
+
+    for (int i = 0; i < report->count; i++)
+    {
+        const bench_case_t *c = &report->cases[i];
+        APPEND("%s{\"name\":\"%s\",\"runs\":%lu,\"cycles\":[%lu,%lu,%lu],\"heap\":%ld,\"heap_int\":%ld}",
+               i ? "," : "", c->name, (unsigned long)c->runs, (unsigned long)(c->runs ? c->min_cycles : 0),
+               (unsigned long)(c->runs ? c->total_cycles / c->runs : 0), (unsigned long)c->max_cycles,
+               (long)c->heap_delta, (long)c->internal_delta);
+    }
+    APPEND("]}");
+#undef APPEND
+
+    return pos;
+}
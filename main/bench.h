@@ -0,0 +1,104 @@
+/*
+ * On-Target Benchmarks
+ * Cycle-counted timing loops with heap deltas, collected into one report
+ * and written as JSON so builds, clocks and boards can be compared
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_cpu.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Cases one report can hold */
+#define BENCH_MAX_CASES 16
+
+    /**
+     * @brief Timings for one case, in CPU cycles with the sampling cost removed
+     */
+    typedef struct
+    {
+        const char *name;
+        uint32_t runs;
+        uint32_t min_cycles;
+        uint32_t max_cycles;
+        uint64_t total_cycles;
+        int32_t heap_delta;     /* Free heap lost over the case; negative when it gave memory back */
+        int32_t internal_delta; /* The same for internal RAM */
+        /* Private */
+        uint32_t overhead;
+        size_t heap_before;
+        size_t internal_before;
+    } bench_case_t;
+
+    typedef struct
+    {
+        bench_case_t cases[BENCH_MAX_CASES];
+        int count;
+        uint32_t overhead_cycles; /* Cost of an empty sample */
+        uint32_t pclk_hz;         /* Display SPI clock, reported with the build settings */
+        int64_t start_us;
+    } bench_report_t;
+
+    /**
+     * @brief Cycle counter of the calling core
+     *
+     * Run benchmarks on a task pinned to one core; the counters of the two
+     * cores are unrelated.
+     */
+    static inline uint32_t bench_cycles(void)
+    {
+        return esp_cpu_get_cycle_count();
+    }
+
+    /**
+     * @brief Keep the compiler from dropping work whose result goes unused
+     */
+    static inline void bench_keep(const void *result)
+    {
+        __asm__ volatile("" : : "r"(result) : "memory");
+    }
+
+    /**
+     * @brief Start a report and calibrate the sampling cost
+     */
+    void bench_report_init(bench_report_t *report, uint32_t pclk_hz);
+
+    /**
+     * @brief Open the next case and record the heap before it
+     *
+     * @return NULL when the report is full; the calls below accept it and
+     *         record nothing
+     */
+    bench_case_t *bench_case_begin(bench_report_t *report, const char *name);
+
+    /**
+     * @brief Add one run that started at @p start_cycles (from bench_cycles())
+     */
+    void bench_case_sample(bench_case_t *c, uint32_t start_cycles);
+
+    /**
+     * @brief Close the case and record the heap after it
+     */
+    void bench_case_end(bench_case_t *c);
+
+    /**
+     * @brief Write the report, with chip, clocks and the sdkconfig options
+     * that move the numbers, as one JSON object
+     *
+     * @return Length written, or 0 if the buffer was too small
+     */
+    size_t bench_format_json(const bench_report_t *report, char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_H */
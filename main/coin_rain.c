@@ -0,0 +1,300 @@
+/*
+ * Coin Rain
+ * Money-rain particle system drawn by a single LVGL object: a fixed pool of
+ * coins in structure-of-arrays form, stepped in fixed-point integer math,
+ * invalidating only the column bands the coins moved through
+ */
+
+#include "coin_rain.h"
+#include "coin_sprite.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* Positions and speeds are Q8 pixels (per tick, per tick squared) */
+#define Q8(v) ((int32_t)(v) * 256)
+#define PX(v) ((v) >> 8)
+
+#define RAIN_MARGIN 20        /* Spawn band inset from the left/right edge */
+#define RAIN_SPAWN_TICKS 32   /* A burst starts over ~0.5 s */
+#define RAIN_MAX_STEPS 4      /* Catch-up steps per timer run after a stall */
+#define RAIN_FADE_STEP 12     /* Alpha lost per tick once in the bottom quarter */
+#define BURST_BASE 8          /* Coins for a sale under $10 */
+#define BURST_PER_DECADE 6    /* Extra coins per decade above that */
+#define BURST_MAX_DECADES 4   /* $10, $100, $1,000, $10,000; more looks the same */
+#define GRAVITY_BASE 10       /* ~1.8 s from top to bottom, like the old tween */
+#define GRAVITY_PER_DECADE 3
+
+/* Structure of arrays; slots [0, count) are in use, live or still waiting */
+static struct
+{
+    int32_t x[COIN_RAIN_POOL]; /* Sprite top-left, relative to the layer */
+    int32_t y[COIN_RAIN_POOL];
+    int16_t vx[COIN_RAIN_POOL];
+    int16_t vy[COIN_RAIN_POOL];
+    int16_t g[COIN_RAIN_POOL];
+    uint16_t wait[COIN_RAIN_POOL]; /* Ticks until it may start falling */
+    uint8_t alpha[COIN_RAIN_POOL];
+    uint8_t live[COIN_RAIN_POOL];
+} pool;
+
+static int count = 0;
+static int live_count = 0;
+
+static lv_obj_t *layer = NULL;
+static lv_timer_t *timer = NULL;
+static uint32_t last_step = 0;
+static int side = 0; /* Sprite edge, glow included */
+static int pad = 0;  /* Glow margin around the coin disc */
+
+static lv_area_t dirty[COIN_RAIN_BANDS];
+static bool dirty_set[COIN_RAIN_BANDS];
+static coin_rain_stats_t stats;
+
+/* Fold the sprite rectangle of slot @p i into its band's dirty box */
+static void mark(int i, const lv_area_t *coords)
+{
+    int w = lv_area_get_width(coords);
+    int x = PX(pool.x[i]);
+    int y = PX(pool.y[i]);
+    int band = (x + side / 2) * COIN_RAIN_BANDS / (w > 0 ? w : 1);
+    band = band < 0 ? 0 : (band >= COIN_RAIN_BANDS ? COIN_RAIN_BANDS - 1 : band);
+
+    lv_area_t a = {
+        .x1 = coords->x1 + x,
+        .y1 = coords->y1 + y,
+        .x2 = coords->x1 + x + side - 1,
+        .y2 = coords->y1 + y + side - 1,
+    };
+    if (!dirty_set[band])
+    {
+        dirty[band] = a;
+        dirty_set[band] = true;
+    }
+    else
+    {
+        _lv_area_join(&dirty[band], &dirty[band], &a);
+    }
+}
+
+/* Swap-remove; order does not matter for coins */
+static void remove_slot(int i)
+{
+    int last = --count;
+    pool.x[i] = pool.x[last];
+    pool.y[i] = pool.y[last];
+    pool.vx[i] = pool.vx[last];
+    pool.vy[i] = pool.vy[last];
+    pool.g[i] = pool.g[last];
+    pool.wait[i] = pool.wait[last];
+    pool.alpha[i] = pool.alpha[last];
+    pool.live[i] = pool.live[last];
+}
+
+static void step(const lv_area_t *coords)
+{
+    int h = lv_area_get_height(coords);
+    int fade_y = h * 3 / 4;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!pool.live[i])
+        {
+            if (pool.wait[i])
+            {
+                pool.wait[i]--;
+            }
+            else if (live_count < COIN_RAIN_MAX_LIVE)
+            {
+                pool.live[i] = 1;
+                live_count++;
+                stats.spawned++;
+                mark(i, coords);
+            }
+            continue;
+        }
+
+        mark(i, coords); /* Where it was */
+        pool.vy[i] += pool.g[i];
+        pool.x[i] += pool.vx[i];
+        pool.y[i] += pool.vy[i];
+        if (PX(pool.y[i]) + pad > fade_y)
+        {
+            pool.alpha[i] = pool.alpha[i] > RAIN_FADE_STEP ? pool.alpha[i] - RAIN_FADE_STEP : 0;
+        }
+
+        if (pool.alpha[i] == 0 || PX(pool.y[i]) >= h)
+        {
+            live_count--;
+            remove_slot(i--);
+            continue;
+        }
+        mark(i, coords); /* Where it is now */
+    }
+
+    if ((uint32_t)live_count > stats.peak_live)
+    {
+        stats.peak_live = live_count;
+    }
+}
+
+static void rain_timer_cb(lv_timer_t *t)
+{
+    uint32_t steps = lv_tick_elaps(last_step) / COIN_RAIN_TICK_MS;
+    if (steps == 0)
+    {
+        return;
+    }
+    if (steps > RAIN_MAX_STEPS)
+    {
+        /* Fell behind (e.g. a long flush): slow down rather than jump */
+        steps = RAIN_MAX_STEPS;
+        last_step = lv_tick_get();
+    }
+    else
+    {
+        last_step += steps * COIN_RAIN_TICK_MS;
+    }
+
+    lv_area_t coords;
+    lv_obj_get_coords(layer, &coords);
+    for (uint32_t s = 0; s < steps; s++)
+    {
+        step(&coords);
+    }
+
+    for (int b = 0; b < COIN_RAIN_BANDS; b++)
+    {
+        if (dirty_set[b])
+        {
+            stats.dirty_px += lv_area_get_size(&dirty[b]);
+            lv_obj_invalidate_area(layer, &dirty[b]);
+            dirty_set[b] = false;
+        }
+    }
+
+    if (count == 0)
+    {
+        lv_timer_pause(timer);
+    }
+}
+
+static void rain_draw_cb(lv_event_t *e)
+{
+    lv_draw_ctx_t *draw_ctx = lv_event_get_draw_ctx(e);
+    lv_area_t coords;
+    lv_obj_get_coords(layer, &coords);
+
+    lv_draw_img_dsc_t dsc;
+    lv_draw_img_dsc_init(&dsc);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!pool.live[i])
+        {
+            continue;
+        }
+        lv_area_t a = {
+            .x1 = coords.x1 + PX(pool.x[i]),
+            .y1 = coords.y1 + PX(pool.y[i]),
+        };
+        a.x2 = a.x1 + side - 1;
+        a.y2 = a.y1 + side - 1;
+
+        lv_area_t visible;
+        const lv_img_dsc_t *sprite = coin_sprite_get(pool.alpha[i]);
+        if (sprite && _lv_area_intersect(&visible, &a, draw_ctx->clip_area))
+        {
+            lv_draw_img(draw_ctx, &dsc, &a, sprite);
+        }
+    }
+}
+
+lv_obj_t *coin_rain_create(lv_obj_t *parent)
+{
+    const lv_img_dsc_t *sprite = coin_sprite_get(LV_OPA_COVER);
+    side = sprite ? sprite->header.w : 0;
+    pad = coin_sprite_pad();
+
+    layer = lv_obj_create(parent);
+    lv_obj_remove_style_all(layer);
+    lv_obj_set_size(layer, LV_PCT(100), LV_PCT(100));
+    lv_obj_clear_flag(layer, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_event_cb(layer, rain_draw_cb, LV_EVENT_DRAW_MAIN, NULL);
+
+    timer = lv_timer_create(rain_timer_cb, COIN_RAIN_TICK_MS, NULL);
+    lv_timer_pause(timer);
+    return layer;
+}
+
+void coin_rain_burst(int64_t amount)
+{
+    if (layer == NULL || side == 0)
+    {
+        return;
+    }
+
+    int decades = 0;
+    for (int64_t a = amount; a >= 1000 && decades < BURST_MAX_DECADES; a /= 10)
+    {
+        decades++;
+    }
+    int n = BURST_BASE + decades * BURST_PER_DECADE;
+    int16_t g = GRAVITY_BASE + decades * GRAVITY_PER_DECADE;
+
+    int w = lv_obj_get_width(layer);
+    int span = w - 2 * RAIN_MARGIN - (side - 2 * pad);
+    span = span > 1 ? span : 1;
+
+    for (int k = 0; k < n; k++)
+    {
+        if (count == COIN_RAIN_POOL)
+        {
+            stats.trimmed += n - k;
+            break;
+        }
+        int i = count++;
+        pool.x[i] = Q8(RAIN_MARGIN + rand() % span - pad);
+        pool.y[i] = Q8(-30 - rand() % 20 - pad);
+        pool.vx[i] = (int16_t)(rand() % 129 - 64); /* Up to 1/4 px per tick sideways */
+        pool.vy[i] = (int16_t)(rand() % 128);
+        pool.g[i] = g;
+        pool.wait[i] = (uint16_t)(rand() % RAIN_SPAWN_TICKS);
+        pool.alpha[i] = LV_OPA_COVER;
+        pool.live[i] = 0;
+    }
+
+    if (timer && timer->paused)
+    {
+        last_step = lv_tick_get();
+        lv_timer_resume(timer);
+    }
+}
+
+void coin_rain_clear(void)
+{
+    if (layer && live_count)
+    {
+        lv_obj_invalidate(layer);
+    }
+    count = 0;
+    live_count = 0;
+    stats.peak_live = 0;
+    for (int b = 0; b < COIN_RAIN_BANDS; b++)
+    {
+        dirty_set[b] = false;
+    }
+    if (timer)
+    {
+        lv_timer_pause(timer);
+    }
+}
+
+int coin_rain_active(void)
+{
+    return count;
+}
+
+void coin_rain_get_stats(coin_rain_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,71 @@
+/*
+ * Coin Rain
+ * Money-rain particle system drawn by a single LVGL object: a fixed pool of
+ * coins in structure-of-arrays form, stepped in fixed-point integer math,
+ * invalidating only the column bands the coins moved through
+ */
+
+#ifndef COIN_RAIN_H
+#define COIN_RAIN_H
+
+#include <stdint.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Coins queued or falling; bursts past this are trimmed */
+#define COIN_RAIN_POOL 48
+/* Coins drawn at once, which bounds the blit cost per frame; the rest wait */
+#define COIN_RAIN_MAX_LIVE 24
+/* Simulation step */
+#define COIN_RAIN_TICK_MS 16
+/* Vertical bands, each invalidated as one box per step */
+#define COIN_RAIN_BANDS 8
+
+    typedef struct
+    {
+        uint32_t spawned;   /* Coins that started falling */
+        uint32_t trimmed;   /* Coins dropped from bursts by a full pool */
+        uint32_t peak_live; /* Most coins on screen at once since the last clear */
+        uint32_t dirty_px;  /* Pixels invalidated; wraps, use deltas */
+    } coin_rain_stats_t;
+
+    /**
+     * @brief Create the rain layer covering @p parent
+     *
+     * Call after coin_sprite_init() and after the rest of the screen so the
+     * coins draw on top. LVGL task (or port lock) only, like everything below.
+     */
+    lv_obj_t *coin_rain_create(lv_obj_t *parent);
+
+    /**
+     * @brief Queue a burst sized by the sale
+     *
+     * Each decade of @p amount (minor units) from $10 up, to $10,000, adds
+     * coins and makes them fall faster.
+     */
+    void coin_rain_burst(int64_t amount);
+
+    /**
+     * @brief Remove every coin, queued or falling, and reset peak_live
+     */
+    void coin_rain_clear(void);
+
+    /**
+     * @brief Coins queued or falling
+     */
+    int coin_rain_active(void);
+
+    /**
+     * @brief Copy the counters
+     */
+    void coin_rain_get_stats(coin_rain_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COIN_RAIN_H */
@@ -0,0 +1,183 @@
+/*
+ * Coin Sprite Cache
+ * Renders the money-rain coin once into ARGB image descriptors, with a set
+ * of pre-faded copies, so the rain only costs image blits per frame
+ */
+
+#include "coin_sprite.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "coin_sprite";
+
+#define PX_BYTES LV_IMG_PX_SIZE_ALPHA_BYTE
+#define GLOW_MAX_OPA 150 /* Roughly what an 8 px LVGL shadow peaks at */
+
+static lv_img_dsc_t sprites[COIN_SPRITE_FADE_LEVELS];
+static uint8_t *pixels = NULL;
+static int sprite_pad = 0;
+
+static float clampf(float v, float lo, float hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static void put_px(uint8_t *buf, int side, int x, int y, lv_color_t c, uint8_t a)
+{
+    uint8_t *px = buf + (y * side + x) * PX_BYTES;
+    memcpy(px, &c, sizeof(lv_color_t));
+    px[PX_BYTES - 1] = a;
+}
+
+static void get_px(const uint8_t *buf, int side, int x, int y, lv_color_t *c, uint8_t *a)
+{
+    const uint8_t *px = buf + (y * side + x) * PX_BYTES;
+    memcpy(c, px, sizeof(lv_color_t));
+    *a = px[PX_BYTES - 1];
+}
+
+/* Disc with anti-aliased edge, border ring and a soft outer glow */
+static void render_disc(uint8_t *buf, int side, const coin_sprite_style_t *s)
+{
+    float center = side / 2.0f;
+    float r = s->diameter / 2.0f;
+    float inner_r = r - s->border_width;
+
+    for (int y = 0; y < side; y++)
+    {
+        for (int x = 0; x < side; x++)
+        {
+            float dx = x + 0.5f - center;
+            float dy = y + 0.5f - center;
+            float d = sqrtf(dx * dx + dy * dy);
+
+            float disc_cov = clampf(r + 0.5f - d, 0.0f, 1.0f);
+            float face_cov = clampf(inner_r + 0.5f - d, 0.0f, 1.0f);
+            float glow = s->glow_width > 0 ? clampf(1.0f - (d - r) / s->glow_width, 0.0f, 1.0f) : 0.0f;
+            float glow_a = glow * glow * GLOW_MAX_OPA;
+
+            lv_color_t disc = lv_color_mix(s->face, s->border, (uint8_t)(face_cov * 255));
+            lv_color_t c = lv_color_mix(disc, s->glow, (uint8_t)(disc_cov * 255));
+            float a = disc_cov * 255.0f + (1.0f - disc_cov) * glow_a;
+            put_px(buf, side, x, y, c, (uint8_t)clampf(a, 0.0f, 255.0f));
+        }
+    }
+}
+
+/* Blend the font glyph into the middle of the disc */
+static void render_glyph(uint8_t *buf, int side, const coin_sprite_style_t *s)
+{
+    lv_font_glyph_dsc_t g;
+    if (s->font == NULL || !lv_font_get_glyph_dsc(s->font, &g, s->glyph, 0))
+    {
+        return;
+    }
+    const uint8_t *bitmap = lv_font_get_glyph_bitmap(s->font, s->glyph);
+    if (bitmap == NULL || g.bpp == 0 || g.bpp > 8)
+    {
+        return;
+    }
+
+    const uint32_t mask = (1u << g.bpp) - 1;
+    int x0 = (side - g.box_w) / 2;
+    int y0 = (side - g.box_h) / 2;
+
+    for (int gy = 0; gy < g.box_h; gy++)
+    {
+        for (int gx = 0; gx < g.box_w; gx++)
+        {
+            int x = x0 + gx;
+            int y = y0 + gy;
+            if (x < 0 || y < 0 || x >= side || y >= side)
+            {
+                continue;
+            }
+
+            /* Glyph rows are packed back to back, MSB first */
+            uint32_t bit = (uint32_t)(gy * g.box_w + gx) * g.bpp;
+            uint32_t v = (bitmap[bit >> 3] >> (8 - g.bpp - (bit & 7))) & mask;
+            if (v == 0)
+            {
+                continue;
+            }
+
+            lv_color_t c;
+            uint8_t a;
+            get_px(buf, side, x, y, &c, &a);
+            put_px(buf, side, x, y, lv_color_mix(s->glyph_color, c, (uint8_t)(v * 255 / mask)), a);
+        }
+    }
+}
+
+bool coin_sprite_init(const coin_sprite_style_t *style)
+{
+    if (pixels)
+    {
+        return true;
+    }
+
+    int side = style->diameter + 2 * style->glow_width;
+    size_t sprite_bytes = (size_t)side * side * PX_BYTES;
+    size_t total = sprite_bytes * COIN_SPRITE_FADE_LEVELS;
+
+    pixels = heap_caps_malloc(total, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (pixels == NULL)
+    {
+        pixels = heap_caps_malloc(total, MALLOC_CAP_8BIT);
+    }
+    if (pixels == NULL)
+    {
+        ESP_LOGE(TAG, "No memory for %d coin sprites (%u bytes)", COIN_SPRITE_FADE_LEVELS, (unsigned)total);
+        return false;
+    }
+
+    uint32_t start = esp_log_timestamp();
+    render_disc(pixels, side, style);
+    render_glyph(pixels, side, style);
+
+    for (int level = 0; level < COIN_SPRITE_FADE_LEVELS; level++)
+    {
+        uint8_t *buf = pixels + level * sprite_bytes;
+        if (level > 0)
+        {
+            /* Pre-multiply the fade into the alpha channel */
+            uint32_t scale = 256 * (COIN_SPRITE_FADE_LEVELS - level) / COIN_SPRITE_FADE_LEVELS;
+            memcpy(buf, pixels, sprite_bytes);
+            for (size_t i = PX_BYTES - 1; i < sprite_bytes; i += PX_BYTES)
+            {
+                buf[i] = (uint8_t)((buf[i] * scale) >> 8);
+            }
+        }
+
+        sprites[level] = (lv_img_dsc_t){
+            .header.always_zero = 0,
+            .header.w = side,
+            .header.h = side,
+            .header.cf = LV_IMG_CF_TRUE_COLOR_ALPHA,
+            .data_size = sprite_bytes,
+            .data = buf,
+        };
+    }
+
+    sprite_pad = style->glow_width;
+    ESP_LOGI(TAG, "Rendered %d coin sprites (%dx%d, %u bytes) in %lu ms", COIN_SPRITE_FADE_LEVELS,
+             side, side, (unsigned)total, (unsigned long)(esp_log_timestamp() - start));
+    return true;
+}
+
+const lv_img_dsc_t *coin_sprite_get(lv_opa_t opa)
+{
+    if (pixels == NULL || opa <= LV_OPA_TRANSP)
+    {
+        return NULL;
+    }
+    int level = (LV_OPA_COVER - opa) * COIN_SPRITE_FADE_LEVELS / (LV_OPA_COVER + 1);
+    return &sprites[level];
+}
+
+int coin_sprite_pad(void)
+{
+    return sprite_pad;
+}
@@ -0,0 +1,61 @@
+/*
+ * Coin Sprite Cache
+ * Renders the money-rain coin once into ARGB image descriptors, with a set
+ * of pre-faded copies, so the rain only costs image blits per frame
+ */
+
+#ifndef COIN_SPRITE_H
+#define COIN_SPRITE_H
+
+#include <stdbool.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Pre-faded variants: level 0 is opaque, level N-1 is the faintest */
+#define COIN_SPRITE_FADE_LEVELS 4
+
+    /**
+     * @brief Look of the coin; sprite side is diameter + 2 * glow_width
+     */
+    typedef struct
+    {
+        int diameter;
+        int border_width;
+        int glow_width;
+        lv_color_t face;
+        lv_color_t border;
+        lv_color_t glow;
+        lv_color_t glyph_color;
+        const lv_font_t *font;
+        uint32_t glyph; /* Unicode letter drawn in the middle */
+    } coin_sprite_style_t;
+
+    /**
+     * @brief Rasterize the coin and its faded variants
+     *
+     * Pixel buffers go to PSRAM when available. Safe to call again; later
+     * calls are no-ops.
+     *
+     * @return true on success
+     */
+    bool coin_sprite_init(const coin_sprite_style_t *style);
+
+    /**
+     * @brief Nearest pre-faded sprite for an opacity, or NULL when invisible
+     */
+    const lv_img_dsc_t *coin_sprite_get(lv_opa_t opa);
+
+    /**
+     * @brief Offset between the sprite's top-left corner and the coin disc
+     */
+    int coin_sprite_pad(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COIN_SPRITE_H */
@@ -4,15 +4,43 @@
  */
 
 #include "dns_server.h"
+#include "task_topology.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "lwip/sockets.h"
 #include "lwip/netdb.h"
+#include <ctype.h>
 #include <string.h>
 
 static const char *TAG = "dns_server";
 
+#define DNS_PORT 53
+#define DNS_PACKET_MAX 512 /* Plain UDP DNS without EDNS */
+#define DNS_NAME_MAX 255
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_PTR 12
+#define DNS_TYPE_AAAA 28
+#define DNS_TYPE_SVCB 64
+#define DNS_TYPE_HTTPS 65
+#define DNS_TYPE_ANY 255
+#define DNS_CLASS_IN 1
+
+#define DNS_FLAG_QR 0x8000
+#define DNS_FLAG_AA 0x0400
+#define DNS_FLAG_RD 0x0100
+#define DNS_OPCODE_MASK 0x7800
+
+#define DNS_RCODE_NOERROR 0
+#define DNS_RCODE_FORMERR 1
+#define DNS_RCODE_NXDOMAIN 3
+#define DNS_RCODE_NOTIMP 4
+
+/* Generic names may be cached briefly; probe answers must not outlive the portal */
+#define DNS_TTL_DEFAULT 60
+#define DNS_TTL_PROBE 0
+
 /* DNS header structure */
 typedef struct __attribute__((packed))
 {
@@ -24,84 +52,241 @@ typedef struct __attribute__((packed))
     uint16_t arcount;
 } dns_header_t;
 
+/* Hostnames phones and laptops resolve to decide whether to pop up the portal */
+static const char *const probe_hosts[] = {
+    "connectivitycheck.gstatic.com",
+    "connectivitycheck.android.com",
+    "clients3.google.com",
+    "captive.apple.com",
+    "www.apple.com",
+    "www.msftconnecttest.com",
+    "www.msftncsi.com",
+    "detectportal.firefox.com",
+    "nmcheck.gnome.org",
+};
+
 static TaskHandle_t dns_task_handle = NULL;
 static int dns_socket = -1;
 static bool dns_running = false;
+static dns_server_stats_t stats;
 
 /* The IP address to respond with (SoftAP default gateway) */
 static const uint8_t captive_ip[4] = {192, 168, 4, 1};
 
-static void dns_server_task(void *pvParameters)
+/* Answer records appended after the question: name pointer to offset 12,
+ * type A, class IN, TTL, RDLENGTH 4, address */
+#define DNS_ANSWER_LEN 16
+static uint8_t answer_default[DNS_ANSWER_LEN];
+static uint8_t answer_probe[DNS_ANSWER_LEN];
+
+static void build_answer(uint8_t *answer, uint32_t ttl)
 {
-    uint8_t rx_buffer[512];
-    uint8_t tx_buffer[512];
-    struct sockaddr_in client_addr;
-    socklen_t addr_len = sizeof(client_addr);
+    const uint8_t head[] = {0xC0, 0x0C, 0x00, DNS_TYPE_A, 0x00, DNS_CLASS_IN};
+    memcpy(answer, head, sizeof(head));
+    answer[6] = (uint8_t)(ttl >> 24);
+    answer[7] = (uint8_t)(ttl >> 16);
+    answer[8] = (uint8_t)(ttl >> 8);
+    answer[9] = (uint8_t)ttl;
+    answer[10] = 0x00;
+    answer[11] = 0x04;
+    memcpy(&answer[12], captive_ip, 4);
+}
 
-    while (dns_running)
+static uint16_t read_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+/* Walk the uncompressed QNAME at @p name; offset just past it, or 0 if malformed */
+static size_t skip_qname(const uint8_t *packet, size_t len, size_t name)
+{
+    size_t pos = name;
+    size_t total = 0;
+    while (pos < len)
     {
-        int len = recvfrom(dns_socket, rx_buffer, sizeof(rx_buffer), 0,
-                           (struct sockaddr *)&client_addr, &addr_len);
-        if (len < 0)
+        uint8_t label = packet[pos];
+        if (label == 0)
         {
-            if (dns_running)
+            return pos + 1;
+        }
+        if (label > 63 || (total += label + 1) > DNS_NAME_MAX)
+        {
+            return 0; /* Compression pointer or oversized name */
+        }
+        pos += label + 1;
+    }
+    return 0;
+}
+
+/* Case-insensitive match of a wire-format QNAME against a dotted hostname */
+static bool qname_equals(const uint8_t *qname, const char *host)
+{
+    while (*qname)
+    {
+        uint8_t label = *qname++;
+        for (uint8_t i = 0; i < label; i++)
+        {
+            if (*host == '\0' || tolower(*qname++) != tolower((unsigned char)*host++))
             {
-                ESP_LOGE(TAG, "recvfrom failed: errno %d", errno);
+                return false;
             }
-            continue;
         }
+        if (*host == '.')
+        {
+            host++;
+        }
+        else if (*qname || *host)
+        {
+            return false;
+        }
+    }
+    return *host == '\0';
+}
 
-        if (len < (int)sizeof(dns_header_t))
+static bool is_probe_host(const uint8_t *qname)
+{
+    for (size_t i = 0; i < sizeof(probe_hosts) / sizeof(probe_hosts[0]); i++)
+    {
+        if (qname_equals(qname, probe_hosts[i]))
         {
-            continue;
+            return true;
         }
+    }
+    return false;
+}
 
-        dns_header_t *req_header = (dns_header_t *)rx_buffer;
+/* Turn the query in @p packet into its response in place.
+ * Returns the response length, or 0 to drop the packet. */
+static size_t dns_handle_query(uint8_t *packet, size_t len, size_t size)
+{
+    if (len < sizeof(dns_header_t))
+    {
+        stats.malformed++;
+        return 0;
+    }
 
-        /* Build response */
-        memcpy(tx_buffer, rx_buffer, len);
-        dns_header_t *resp_header = (dns_header_t *)tx_buffer;
+    dns_header_t *header = (dns_header_t *)packet;
+    uint16_t flags = ntohs(header->flags);
+    if (flags & DNS_FLAG_QR)
+    {
+        return 0; /* Never answer a response */
+    }
+    stats.queries++;
 
-        /* Set response flags: QR=1 (response), AA=1 (authoritative), no error */
-        resp_header->flags = htons(0x8400);
-        resp_header->ancount = htons(1);
+    uint16_t reply_flags = DNS_FLAG_QR | DNS_FLAG_AA | (flags & (DNS_OPCODE_MASK | DNS_FLAG_RD));
+    header->ancount = 0;
+    header->nscount = 0;
+    header->arcount = 0;
 
-        /* Add answer section after the query */
-        int response_len = len;
-        uint8_t *answer = tx_buffer + response_len;
+    if (flags & DNS_OPCODE_MASK)
+    {
+        stats.other++;
+        header->qdcount = 0;
+        header->flags = htons(reply_flags | DNS_RCODE_NOTIMP);
+        return sizeof(dns_header_t);
+    }
 
-        /* Name pointer to original query (0xC00C points to offset 12) */
-        answer[0] = 0xC0;
-        answer[1] = 0x0C;
+    size_t qname = sizeof(dns_header_t);
+    size_t qname_end = skip_qname(packet, len, qname);
+    if (ntohs(header->qdcount) != 1 || qname_end == 0 || qname_end + 4 > len)
+    {
+        stats.malformed++;
+        header->qdcount = 0;
+        header->flags = htons(reply_flags | DNS_RCODE_FORMERR);
+        return sizeof(dns_header_t);
+    }
 
-        /* Type A (host address) */
-        answer[2] = 0x00;
-        answer[3] = 0x01;
+    uint16_t qtype = read_u16(packet + qname_end);
+    uint16_t qclass = read_u16(packet + qname_end + 2);
+    size_t question_end = qname_end + 4; /* Anything after (EDNS OPT) is dropped */
 
-        /* Class IN */
-        answer[4] = 0x00;
-        answer[5] = 0x01;
+    uint16_t rcode = DNS_RCODE_NOERROR;
+    const uint8_t *answer = NULL;
 
-        /* TTL (60 seconds) */
-        answer[6] = 0x00;
-        answer[7] = 0x00;
-        answer[8] = 0x00;
-        answer[9] = 0x3C;
+    if (is_probe_host(packet + qname))
+    {
+        /* Short-circuit: the portal has to win this lookup, and fast */
+        stats.probes++;
+        if (qtype == DNS_TYPE_A || qtype == DNS_TYPE_ANY)
+        {
+            answer = answer_probe;
+        }
+    }
 
-        /* Data length (4 bytes for IPv4) */
-        answer[10] = 0x00;
-        answer[11] = 0x04;
+    if (qclass != DNS_CLASS_IN)
+    {
+        stats.other++;
+        rcode = DNS_RCODE_NOTIMP;
+        answer = NULL;
+    }
+    else if (qtype == DNS_TYPE_A || qtype == DNS_TYPE_ANY)
+    {
+        stats.a++;
+        answer = answer ? answer : answer_default;
+    }
+    else if (qtype == DNS_TYPE_AAAA)
+    {
+        stats.aaaa++; /* Empty NOERROR: no IPv6 here, fall back to A right away */
+    }
+    else if (qtype == DNS_TYPE_HTTPS || qtype == DNS_TYPE_SVCB)
+    {
+        stats.https++;
+    }
+    else if (qtype == DNS_TYPE_PTR)
+    {
+        stats.ptr++;
+        rcode = DNS_RCODE_NXDOMAIN;
+    }
+    else
+    {
+        stats.other++;
+    }
 
-        /* IP address */
-        memcpy(&answer[12], captive_ip, 4);
+    size_t response_len = question_end;
+    if (answer)
+    {
+        if (question_end + DNS_ANSWER_LEN > size)
+        {
+            stats.malformed++;
+            return 0;
+        }
+        memcpy(packet + question_end, answer, DNS_ANSWER_LEN);
+        response_len += DNS_ANSWER_LEN;
+        header->ancount = htons(1);
+    }
+    if (rcode == DNS_RCODE_NXDOMAIN)
+    {
+        stats.nxdomain++;
+    }
+    header->flags = htons(reply_flags | rcode);
+    return response_len;
+}
 
-        response_len += 16;
+static void dns_server_task(void *pvParameters)
+{
+    uint8_t packet[DNS_PACKET_MAX];
+    struct sockaddr_in client_addr;
 
-        /* Send response */
-        sendto(dns_socket, tx_buffer, response_len, 0,
-               (struct sockaddr *)&client_addr, addr_len);
+    while (dns_running)
+    {
+        socklen_t addr_len = sizeof(client_addr);
+        int len = recvfrom(dns_socket, packet, sizeof(packet), 0,
+                           (struct sockaddr *)&client_addr, &addr_len);
+        if (len < 0)
+        {
+            if (dns_running)
+            {
+                ESP_LOGE(TAG, "recvfrom failed: errno %d", errno);
+            }
+            continue;
+        }
 
-        ESP_LOGD(TAG, "DNS query handled, redirected to captive portal");
+        size_t response_len = dns_handle_query(packet, len, sizeof(packet));
+        if (response_len > 0)
+        {
+            sendto(dns_socket, packet, response_len, 0,
+                   (struct sockaddr *)&client_addr, addr_len);
+        }
     }
 
     vTaskDelete(NULL);
@@ -114,6 +299,10 @@ esp_err_t dns_server_start(void)
         return ESP_OK; /* Already running */
     }
 
+    build_answer(answer_default, DNS_TTL_DEFAULT);
+    build_answer(answer_probe, DNS_TTL_PROBE);
+    memset(&stats, 0, sizeof(stats));
+
     /* Create UDP socket */
     dns_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
     if (dns_socket < 0)
@@ -129,7 +318,7 @@ esp_err_t dns_server_start(void)
     /* Bind to DNS port 53 */
     struct sockaddr_in server_addr = {
         .sin_family = AF_INET,
-        .sin_port = htons(53),
+        .sin_port = htons(DNS_PORT),
         .sin_addr.s_addr = htonl(INADDR_ANY),
     };
 
@@ -144,7 +333,8 @@ esp_err_t dns_server_start(void)
     dns_running = true;
 
     /* Start DNS server task */
-    BaseType_t ret = xTaskCreate(dns_server_task, "dns_server", 4096, NULL, 5, &dns_task_handle);
+    BaseType_t ret = xTaskCreatePinnedToCore(dns_server_task, "dns_server", TASK_DNS_STACK, NULL,
+                                            TASK_PORTAL_PRIORITY, &dns_task_handle, TASK_CORE_NET);
     if (ret != pdPASS)
     {
         ESP_LOGE(TAG, "Failed to create DNS task");
@@ -181,6 +371,15 @@ esp_err_t dns_server_stop(void)
         dns_task_handle = NULL;
     }
 
-    ESP_LOGI(TAG, "DNS server stopped");
+    ESP_LOGI(TAG, "DNS server stopped: %lu queries (A %lu, AAAA %lu, HTTPS %lu, PTR %lu, other %lu), "
+                  "%lu probes, %lu NXDOMAIN, %lu malformed",
+             (unsigned long)stats.queries, (unsigned long)stats.a, (unsigned long)stats.aaaa,
+             (unsigned long)stats.https, (unsigned long)stats.ptr, (unsigned long)stats.other,
+             (unsigned long)stats.probes, (unsigned long)stats.nxdomain, (unsigned long)stats.malformed);
     return ESP_OK;
 }
+
+void dns_server_get_stats(dns_server_stats_t *out)
+{
+    *out = stats;
+}
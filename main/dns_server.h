@@ -6,6 +6,7 @@
 #ifndef DNS_SERVER_H
 #define DNS_SERVER_H
 
+#include <stdint.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -13,11 +14,25 @@ extern "C"
 {
 #endif
 
+    typedef struct
+    {
+        uint32_t queries;   /* Well-formed queries seen */
+        uint32_t a;         /* A/ANY, answered with the portal address */
+        uint32_t aaaa;      /* AAAA, answered empty */
+        uint32_t https;     /* HTTPS/SVCB, answered empty */
+        uint32_t ptr;       /* Reverse lookups, NXDOMAIN */
+        uint32_t other;     /* Other types, classes and opcodes */
+        uint32_t probes;    /* Known captive-detection hostnames */
+        uint32_t nxdomain;  /* NXDOMAIN responses */
+        uint32_t malformed; /* Runt, truncated or compressed questions */
+    } dns_server_stats_t;
+
     /**
      * @brief Start the DNS server for captive portal
      *
-     * All DNS queries will be responded to with the device's IP address,
-     * causing browsers to redirect to the captive portal.
+     * A queries are answered with the device's IP address, causing browsers
+     * to redirect to the captive portal. AAAA and HTTPS queries get an empty
+     * NOERROR so clients fall back to IPv4 without waiting for a timeout.
      *
      * @return ESP_OK on success
      */
@@ -30,6 +45,11 @@ extern "C"
      */
     esp_err_t dns_server_stop(void);
 
+    /**
+     * @brief Copy the per-type query counters (reset on each start)
+     */
+    void dns_server_get_stats(dns_server_stats_t *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,360 @@
+/*
+ * Idle Power
+ * Between sales: LVGL paused with its tick stopped, the backlight dimmed
+ * over PWM and the CPU allowed to scale down and light-sleep, all undone
+ * by the next kick
+ */
+
+#include "idle_power.h"
+#include "driver/ledc.h"
+#include "esp_log.h"
+#include "esp_lvgl_port.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+static const char *TAG = "idle_power";
+
+#define BACKLIGHT_MODE LEDC_LOW_SPEED_MODE
+#define BACKLIGHT_TIMER LEDC_TIMER_0
+#define BACKLIGHT_CHANNEL LEDC_CHANNEL_0
+#define BACKLIGHT_DUTY_MAX 1023 /* 10-bit */
+
+typedef enum
+{
+    STATE_ACTIVE,
+    STATE_IDLE,
+    STATE_WAKING, /* Kicked; tick and clocks are back, LVGL timers not yet */
+} idle_state_t;
+
+static idle_power_config_t cfg;
+static SemaphoreHandle_t state_mutex = NULL; /* Any kicking task vs. the LVGL task */
+static bool ready = false;
+static lv_timer_t *check_timer = NULL;
+static esp_timer_handle_t housekeeping_timer = NULL;
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t cpu_lock = NULL;   /* Full clock while awake */
+static esp_pm_lock_handle_t sleep_lock = NULL; /* No light sleep while awake */
+#endif
+
+/* Guarded by state_mutex */
+static idle_state_t state = STATE_ACTIVE;
+static int64_t last_activity_us = 0;
+static int64_t idle_since_us = 0;
+static int64_t wake_us = 0; /* Kick that ended the last idle period, 0 once measured */
+static lv_timer_t *paused[IDLE_POWER_MAX_TIMERS];
+static int paused_count = 0;
+static idle_power_stats_t stats;
+
+static uint32_t backlight_duty(uint8_t pct)
+{
+    return BACKLIGHT_DUTY_MAX * (pct > 100 ? 100 : pct) / 100;
+}
+
+/* Restarts from wherever a fade in flight has got to */
+static void backlight_fade(uint8_t pct, int fade_ms)
+{
+    ledc_fade_stop(BACKLIGHT_MODE, BACKLIGHT_CHANNEL);
+    if (ledc_set_fade_time_and_start(BACKLIGHT_MODE, BACKLIGHT_CHANNEL, backlight_duty(pct), fade_ms,
+                                     LEDC_FADE_NO_WAIT) != ESP_OK)
+    {
+        stats.pm_errors++;
+    }
+}
+
+static void power_locks(bool take)
+{
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t locks[] = {cpu_lock, sleep_lock};
+    for (int i = 0; i < 2; i++)
+    {
+        if (locks[i] != NULL && (take ? esp_pm_lock_acquire(locks[i]) : esp_pm_lock_release(locks[i])) != ESP_OK)
+        {
+            stats.pm_errors++;
+        }
+    }
+#endif
+}
+
+/* Pause every running timer but ours; false (nothing paused) when there
+ * are more than we can remember */
+static bool timers_pause(void)
+{
+    int count = 0;
+    for (lv_timer_t *t = lv_timer_get_next(NULL); t != NULL; t = lv_timer_get_next(t))
+    {
+        if (t == check_timer || t->paused)
+        {
+            continue;
+        }
+        if (count == IDLE_POWER_MAX_TIMERS)
+        {
+            return false;
+        }
+        paused[count++] = t;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        lv_timer_pause(paused[i]);
+    }
+    paused_count = count;
+    return true;
+}
+
+/* Only timers that still exist: one may have been deleted while idle */
+static void timers_resume(void)
+{
+    for (lv_timer_t *t = lv_timer_get_next(NULL); t != NULL; t = lv_timer_get_next(t))
+    {
+        for (int i = 0; i < paused_count; i++)
+        {
+            if (paused[i] == t)
+            {
+                lv_timer_resume(t);
+                break;
+            }
+        }
+    }
+    paused_count = 0;
+}
+
+static bool may_idle(int64_t now)
+{
+    return cfg.idle_after_ms > 0 && now - last_activity_us >= (int64_t)cfg.idle_after_ms * 1000 &&
+           cfg.disp->inv_p == 0 && lv_anim_count_running() == 0 && (cfg.busy == NULL || !cfg.busy());
+}
+
+/* LVGL task, state_mutex held */
+static void enter_idle(int64_t now)
+{
+    if (!timers_pause())
+    {
+        return;
+    }
+    state = STATE_IDLE;
+    idle_since_us = now;
+    wake_us = 0;
+    stats.entries++;
+
+    lvgl_port_stop(); /* The 5 ms tick would keep the CPU out of light sleep */
+    esp_timer_start_periodic(housekeeping_timer, IDLE_POWER_HOUSEKEEPING_MS * 1000ULL);
+    backlight_fade(cfg.backlight_idle_pct, IDLE_POWER_DIM_FADE_MS);
+    power_locks(false);
+    if (cfg.on_change != NULL)
+    {
+        cfg.on_change(true);
+    }
+    ESP_LOGD(TAG, "Idle, %d LVGL timers paused", paused_count);
+}
+
+static void check_timer_cb(lv_timer_t *timer)
+{
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    if (state == STATE_WAKING)
+    {
+        timers_resume();
+        state = STATE_ACTIVE;
+    }
+    else if (state == STATE_ACTIVE && may_idle(now))
+    {
+        enter_idle(now);
+    }
+    if (wake_us != 0 && now - wake_us > IDLE_POWER_WAKE_FRAME_MAX_MS * 1000LL)
+    {
+        wake_us = 0;
+    }
+    xSemaphoreGive(state_mutex);
+}
+
+/* esp_timer task, while idle: the hook's redraws need a wake to reach the panel */
+static void housekeeping_cb(void *arg)
+{
+    bool dirty = false;
+    if (lvgl_port_lock(0))
+    {
+        if (cfg.housekeeping != NULL)
+        {
+            cfg.housekeeping();
+        }
+        dirty = cfg.disp->inv_p > 0;
+        lvgl_port_unlock();
+    }
+    if (dirty)
+    {
+        idle_power_kick();
+    }
+}
+
+static esp_err_t backlight_init(void)
+{
+    /* RC_FAST keeps the PWM running through light sleep */
+    ledc_timer_config_t timer = {
+        .speed_mode = BACKLIGHT_MODE,
+        .duty_resolution = LEDC_TIMER_10_BIT,
+        .timer_num = BACKLIGHT_TIMER,
+        .freq_hz = IDLE_POWER_BACKLIGHT_HZ,
+        .clk_cfg = LEDC_USE_RC_FAST_CLK,
+    };
+    esp_err_t err = ledc_timer_config(&timer);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    ledc_channel_config_t channel = {
+        .gpio_num = cfg.backlight_gpio,
+        .speed_mode = BACKLIGHT_MODE,
+        .channel = BACKLIGHT_CHANNEL,
+        .timer_sel = BACKLIGHT_TIMER,
+        .duty = backlight_duty(cfg.backlight_pct),
+        .hpoint = 0,
+        .sleep_mode = LEDC_SLEEP_MODE_KEEP_ALIVE,
+    };
+    err = ledc_channel_config(&channel);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    return ledc_fade_func_install(0);
+}
+
+#if CONFIG_PM_ENABLE
+static void pm_init(void)
+{
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "idle_cpu", &cpu_lock) != ESP_OK ||
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "idle_sleep", &sleep_lock) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "No power locks; DFS left off");
+        return;
+    }
+    power_locks(true); /* Before DFS starts, so the clock never dips while awake */
+
+    esp_pm_config_t pm = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = cfg.cpu_min_mhz,
+        .light_sleep_enable = cfg.light_sleep,
+    };
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "DFS not enabled: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "DFS %lu-%d MHz, light sleep %s", (unsigned long)cfg.cpu_min_mhz, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+             cfg.light_sleep ? "on" : "off");
+}
+#endif
+
+esp_err_t idle_power_init(const idle_power_config_t *config)
+{
+    cfg = *config;
+    state_mutex = xSemaphoreCreateMutex();
+    const esp_timer_create_args_t timer_args = {
+        .callback = housekeeping_cb,
+        .name = "idle_housekeeping",
+    };
+    if (state_mutex == NULL || esp_timer_create(&timer_args, &housekeeping_timer) != ESP_OK)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = backlight_init();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Backlight PWM failed: %s", esp_err_to_name(err));
+        return err;
+    }
+#if CONFIG_PM_ENABLE
+    pm_init();
+#endif
+
+    check_timer = lv_timer_create(check_timer_cb, cfg.poll_ms, NULL);
+    if (check_timer == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    last_activity_us = esp_timer_get_time();
+    __atomic_store_n(&ready, true, __ATOMIC_RELEASE);
+
+    if (cfg.idle_after_ms > 0)
+    {
+        ESP_LOGI(TAG, "Idle after %lu s, backlight %u%% -> %u%%", (unsigned long)(cfg.idle_after_ms / 1000),
+                 cfg.backlight_pct, cfg.backlight_idle_pct);
+    }
+    return ESP_OK;
+}
+
+void idle_power_kick(void)
+{
+    if (!__atomic_load_n(&ready, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    last_activity_us = now;
+    if (state == STATE_IDLE)
+    {
+        /* Clock and tick first: whatever the kicker does next runs at full speed */
+        power_locks(true);
+        lvgl_port_resume();
+        esp_timer_stop(housekeeping_timer);
+        backlight_fade(cfg.backlight_pct, IDLE_POWER_WAKE_FADE_MS);
+
+        state = STATE_WAKING;
+        stats.wakes++;
+        stats.idle_ms += (uint64_t)(now - idle_since_us) / 1000;
+        wake_us = now;
+        if (cfg.on_change != NULL)
+        {
+            cfg.on_change(false);
+        }
+    }
+    xSemaphoreGive(state_mutex);
+}
+
+void idle_power_frame_shown(void)
+{
+    if (!__atomic_load_n(&ready, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    if (wake_us != 0)
+    {
+        uint32_t us = (uint32_t)(esp_timer_get_time() - wake_us);
+        stats.wake_frame_us_last = us;
+        if (us > stats.wake_frame_us_max)
+        {
+            stats.wake_frame_us_max = us;
+        }
+        stats.wake_frames++;
+        wake_us = 0;
+    }
+    xSemaphoreGive(state_mutex);
+}
+
+bool idle_power_is_idle(void)
+{
+    return __atomic_load_n(&state, __ATOMIC_ACQUIRE) == STATE_IDLE;
+}
+
+void idle_power_get_stats(idle_power_stats_t *out)
+{
+    if (!__atomic_load_n(&ready, __ATOMIC_ACQUIRE))
+    {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    *out = stats;
+    out->idle = state == STATE_IDLE;
+    if (out->idle)
+    {
+        out->idle_ms += (uint64_t)(esp_timer_get_time() - idle_since_us) / 1000;
+    }
+    xSemaphoreGive(state_mutex);
+}
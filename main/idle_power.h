@@ -0,0 +1,97 @@
+/*
+ * Idle Power
+ * Between sales: LVGL paused with its tick stopped, the backlight dimmed
+ * over PWM and the CPU allowed to scale down and light-sleep, all undone
+ * by the next kick
+ */
+
+#ifndef IDLE_POWER_H
+#define IDLE_POWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* LVGL timers one idle period can hold paused */
+#define IDLE_POWER_MAX_TIMERS 16
+/* While idle, the housekeeping hook runs this often */
+#define IDLE_POWER_HOUSEKEEPING_MS 60000
+/* Backlight PWM: 10-bit duty at this frequency */
+#define IDLE_POWER_BACKLIGHT_HZ 5000
+/* Backlight ramps: quick on wake, slow into idle */
+#define IDLE_POWER_WAKE_FADE_MS 80
+#define IDLE_POWER_DIM_FADE_MS 1500
+/* A wake with no first frame reported within this was not for a sale */
+#define IDLE_POWER_WAKE_FRAME_MAX_MS 2000
+
+    typedef struct
+    {
+        lv_disp_t *disp;
+        uint32_t idle_after_ms; /* Quiet time before going idle; 0 never idles */
+        uint32_t poll_ms;       /* Idle check period: the LVGL side of the wake latency, and the idle CPU wake rate */
+        bool (*busy)(void);     /* LVGL task; true keeps the display awake. May be NULL */
+        void (*housekeeping)(void); /* Under the LVGL lock while idle; marking anything dirty wakes */
+        void (*on_change)(bool idle); /* Entering or leaving idle, any task; must not kick. May be NULL */
+        int backlight_gpio;
+        uint8_t backlight_pct;      /* Awake */
+        uint8_t backlight_idle_pct; /* Idle */
+        uint32_t cpu_min_mhz;       /* Lowest DFS frequency; ignored without CONFIG_PM_ENABLE */
+        bool light_sleep;           /* Let the CPU light-sleep while idle */
+    } idle_power_config_t;
+
+    typedef struct
+    {
+        bool idle;
+        uint32_t entries;            /* Times the display went idle */
+        uint32_t wakes;              /* Kicks that ended an idle period */
+        uint64_t idle_ms;            /* Time spent idle, including the current period */
+        uint32_t wake_frame_us_last; /* Kick to first frame of the last measured wake */
+        uint32_t wake_frame_us_max;
+        uint32_t wake_frames;        /* Wakes measured */
+        uint32_t pm_errors;          /* Power locks or backlight calls that failed */
+    } idle_power_stats_t;
+
+    /**
+     * @brief Light the backlight, take the power locks and start watching for
+     * idle
+     *
+     * Call with the LVGL lock held, after the display is registered. Without
+     * CONFIG_PM_ENABLE only the LVGL pause and the backlight apply.
+     */
+    esp_err_t idle_power_init(const idle_power_config_t *config);
+
+    /**
+     * @brief Record activity and wake the display if it is idle
+     *
+     * Safe from any task (not from an ISR) and before idle_power_init. Never
+     * takes the LVGL lock: the tick, clocks and backlight come back at once,
+     * paused LVGL timers within about poll_ms.
+     */
+    void idle_power_kick(void);
+
+    /**
+     * @brief Report the first frame drawn for the activity that woke the
+     * display (LVGL task)
+     *
+     * Ignored when no wake is waiting for its frame.
+     */
+    void idle_power_frame_shown(void);
+
+    /**
+     * @brief True between going idle and the next kick
+     */
+    bool idle_power_is_idle(void);
+
+    void idle_power_get_stats(idle_power_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IDLE_POWER_H */
@@ -0,0 +1,305 @@
+/*
+ * LED Effects
+ * Timed fades, pulses and chases on the status WS2812, run by a service
+ * task fed from a small command queue so callers never block
+ */
+
+#include "led_fx.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "led_strip.h"
+#include "soc/soc_caps.h"
+#include <string.h>
+
+static const char *TAG = "led_fx";
+
+#define PULSE_FLOOR 51 /* 20% of full scale, out of 256 */
+
+typedef enum
+{
+    CMD_BASE,
+    CMD_PLAY,
+    CMD_STOP,
+} cmd_kind_t;
+
+typedef struct
+{
+    cmd_kind_t kind;
+    led_fx_t fx;
+} cmd_t;
+
+typedef struct
+{
+    bool active;
+    led_fx_t fx;
+    int64_t start_ms;
+} layer_t;
+
+static led_strip_handle_t strip = NULL;
+static QueueHandle_t cmd_queue = NULL;
+static led_fx_stats_t stats;
+
+/* Service task only */
+static layer_t base;
+static layer_t overlay;
+static led_rgb_t shown;          /* Last color sent to the LED */
+static led_rgb_t fade_from;      /* Color at the start of the running cross-fade */
+static int64_t fade_start_ms = -1; /* -1 when no cross-fade is running */
+
+static int64_t now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+static led_rgb_t scale(led_rgb_t c, uint32_t k256)
+{
+    return (led_rgb_t){
+        (uint8_t)((c.r * k256) >> 8),
+        (uint8_t)((c.g * k256) >> 8),
+        (uint8_t)((c.b * k256) >> 8),
+    };
+}
+
+static led_rgb_t blend(led_rgb_t a, led_rgb_t b, uint32_t k256)
+{
+    return (led_rgb_t){
+        (uint8_t)(a.r + (((b.r - a.r) * (int32_t)k256) >> 8)),
+        (uint8_t)(a.g + (((b.g - a.g) * (int32_t)k256) >> 8)),
+        (uint8_t)(a.b + (((b.b - a.b) * (int32_t)k256) >> 8)),
+    };
+}
+
+static bool same_fx(const led_fx_t *a, const led_fx_t *b)
+{
+    return a->type == b->type && memcmp(&a->color, &b->color, sizeof(led_rgb_t)) == 0 &&
+           memcmp(&a->color2, &b->color2, sizeof(led_rgb_t)) == 0 &&
+           a->period_ms == b->period_ms && a->duration_ms == b->duration_ms;
+}
+
+/* Color of @p fx @p t_ms after it started; integer math only */
+static led_rgb_t fx_color(const led_fx_t *fx, uint32_t t_ms)
+{
+    uint32_t period = fx->period_ms ? fx->period_ms : 1;
+    switch (fx->type)
+    {
+    case LED_FX_PULSE:
+    {
+        uint32_t phase = t_ms % period;
+        uint32_t half = period / 2 ? period / 2 : 1;
+        uint32_t tri = phase < half ? phase * 256 / half : (period - phase) * 256 / half;
+        return scale(fx->color, PULSE_FLOOR + ((tri * (256 - PULSE_FLOOR)) >> 8));
+    }
+    case LED_FX_CHASE:
+        return ((t_ms / (period / 2 ? period / 2 : 1)) & 1) ? fx->color2 : fx->color;
+    case LED_FX_SOLID:
+    default:
+        return fx->color;
+    }
+}
+
+/* The visible layer changed: cross-fade from whatever is lit now */
+static void start_fade(int64_t now)
+{
+    fade_from = shown;
+    fade_start_ms = now;
+}
+
+static void apply(const cmd_t *cmd, int64_t now)
+{
+    switch (cmd->kind)
+    {
+    case CMD_BASE:
+        if (base.active && same_fx(&base.fx, &cmd->fx))
+        {
+            return; /* Unchanged background: don't restart it */
+        }
+        base = (layer_t){.active = true, .fx = cmd->fx, .start_ms = now};
+        if (!overlay.active)
+        {
+            start_fade(now);
+        }
+        break;
+    case CMD_PLAY:
+        overlay = (layer_t){.active = true, .fx = cmd->fx, .start_ms = now};
+        start_fade(now);
+        break;
+    case CMD_STOP:
+        if (overlay.active)
+        {
+            overlay.active = false;
+            start_fade(now);
+        }
+        break;
+    }
+}
+
+/* Color for this frame; false once nothing is moving any more */
+static bool render(int64_t now, led_rgb_t *out)
+{
+    if (overlay.active && overlay.fx.duration_ms && now - overlay.start_ms >= overlay.fx.duration_ms)
+    {
+        overlay.active = false;
+        start_fade(now);
+    }
+
+    const layer_t *top = overlay.active ? &overlay : &base;
+    led_rgb_t target = top->active ? fx_color(&top->fx, (uint32_t)(now - top->start_ms)) : (led_rgb_t){0, 0, 0};
+    bool animating = top->active && top->fx.type != LED_FX_SOLID;
+
+    if (fade_start_ms >= 0)
+    {
+        int64_t t = now - fade_start_ms;
+        if (t < LED_FX_FADE_MS)
+        {
+            target = blend(fade_from, target, (uint32_t)(t * 256 / LED_FX_FADE_MS));
+            animating = true;
+        }
+        else
+        {
+            fade_start_ms = -1;
+        }
+    }
+
+    /* Timed overlays must wake up to expire */
+    animating |= overlay.active && overlay.fx.duration_ms;
+    *out = target;
+    return animating;
+}
+
+static void led_fx_task(void *arg)
+{
+    bool animating = false;
+    cmd_t cmd;
+
+    while (1)
+    {
+        TickType_t wait = animating ? pdMS_TO_TICKS(LED_FX_TICK_MS) : portMAX_DELAY;
+        if (xQueueReceive(cmd_queue, &cmd, wait) == pdTRUE)
+        {
+            int64_t now = now_ms();
+            apply(&cmd, now);
+            /* Whatever else queued up meanwhile lands in the same refresh */
+            while (xQueueReceive(cmd_queue, &cmd, 0) == pdTRUE)
+            {
+                stats.collapsed++;
+                apply(&cmd, now);
+            }
+        }
+
+        led_rgb_t c;
+        animating = render(now_ms(), &c);
+        if (memcmp(&c, &shown, sizeof(c)) != 0)
+        {
+            led_strip_set_pixel(strip, 0, c.r, c.g, c.b);
+            led_strip_refresh(strip);
+            shown = c;
+            stats.refreshes++;
+        }
+    }
+}
+
+static void post(cmd_kind_t kind, const led_fx_t *fx)
+{
+    if (cmd_queue == NULL)
+    {
+        return;
+    }
+    cmd_t cmd = {.kind = kind};
+    if (fx)
+    {
+        cmd.fx = *fx;
+    }
+    if (xQueueSend(cmd_queue, &cmd, 0) == pdTRUE)
+    {
+        __atomic_add_fetch(&stats.posted, 1, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        __atomic_add_fetch(&stats.dropped, 1, __ATOMIC_RELAXED);
+    }
+}
+
+esp_err_t led_fx_init(const led_fx_config_t *config)
+{
+    led_strip_config_t led_cfg = {
+        .strip_gpio_num = config->gpio,
+        .max_leds = 1,
+        .led_model = LED_MODEL_WS2812,
+        .flags.invert_out = false,
+    };
+    led_strip_rmt_config_t rmt_cfg = {
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = 10000000,
+        .mem_block_symbols = 64,
+#if SOC_RMT_SUPPORT_DMA
+        .flags.with_dma = true, /* Leaves the shared RMT block memory to other channels */
+#endif
+    };
+    esp_err_t err = led_strip_new_rmt_device(&led_cfg, &rmt_cfg, &strip);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "LED strip init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    led_strip_clear(strip);
+
+    cmd_queue = xQueueCreate(LED_FX_QUEUE_LEN, sizeof(cmd_t));
+    if (cmd_queue == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreatePinnedToCore(led_fx_task, "led_fx", config->stack, NULL, config->priority, NULL,
+                                config->core) != pdPASS)
+    {
+        vQueueDelete(cmd_queue);
+        cmd_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void led_fx_set_base(const led_fx_t *fx)
+{
+    post(CMD_BASE, fx);
+}
+
+void led_fx_play(const led_fx_t *fx)
+{
+    post(CMD_PLAY, fx);
+}
+
+void led_fx_stop(void)
+{
+    post(CMD_STOP, NULL);
+}
+
+void led_fx_celebrate(int64_t amount, uint16_t duration_ms)
+{
+    /* Per decade of amount: under $10, $100, $1000 and above */
+    static const uint16_t periods[] = {320, 220, 140, 90};
+    static const uint8_t levels[] = {140, 180, 220, 255};
+    int tier = 0;
+    for (int64_t a = amount; a >= 1000 && tier < 3; a /= 10)
+    {
+        tier++;
+    }
+
+    const led_rgb_t gold = {255, 180, 0};
+    const led_rgb_t white = {255, 255, 255};
+    led_fx_t fx = {
+        .type = LED_FX_CHASE,
+        .color = scale(gold, levels[tier] + 1),
+        .color2 = scale(white, levels[tier] + 1),
+        .period_ms = periods[tier],
+        .duration_ms = duration_ms,
+    };
+    led_fx_play(&fx);
+}
+
+void led_fx_get_stats(led_fx_stats_t *out)
+{
+    *out = stats;
+}
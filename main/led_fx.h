@@ -0,0 +1,102 @@
+/*
+ * LED Effects
+ * Timed fades, pulses and chases on the status WS2812, run by a service
+ * task fed from a small command queue so callers never block
+ */
+
+#ifndef LED_FX_H
+#define LED_FX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Commands waiting for the service task; it drains them all per wake */
+#define LED_FX_QUEUE_LEN 8
+/* Frame time while an effect or transition is running */
+#define LED_FX_TICK_MS 20
+/* Cross-fade whenever the visible effect changes */
+#define LED_FX_FADE_MS 150
+
+    typedef struct
+    {
+        uint8_t r, g, b;
+    } led_rgb_t;
+
+    typedef enum
+    {
+        LED_FX_SOLID, /* Hold color */
+        LED_FX_PULSE, /* Breathe between 20% and 100% of color every period_ms */
+        LED_FX_CHASE, /* Alternate color and color2, half of period_ms each */
+    } led_fx_type_t;
+
+    typedef struct
+    {
+        led_fx_type_t type;
+        led_rgb_t color;
+        led_rgb_t color2;
+        uint16_t period_ms;
+        uint16_t duration_ms; /* Overlays only: 0 runs until led_fx_stop() */
+    } led_fx_t;
+
+    typedef struct
+    {
+        int gpio;
+        int core; /* Service task core, or tskNO_AFFINITY */
+        int priority;
+        int stack;
+    } led_fx_config_t;
+
+    typedef struct
+    {
+        uint32_t posted;    /* Commands accepted */
+        uint32_t dropped;   /* Commands lost to a full queue */
+        uint32_t collapsed; /* Commands folded into a later one without their own refresh */
+        uint32_t refreshes; /* RMT transfers */
+    } led_fx_stats_t;
+
+    /**
+     * @brief Create the strip and the service task; the LED starts dark
+     */
+    esp_err_t led_fx_init(const led_fx_config_t *config);
+
+    /**
+     * @brief Set the background effect (e.g. connection state)
+     *
+     * Shown whenever no overlay is playing. Never blocks; safe from any task.
+     */
+    void led_fx_set_base(const led_fx_t *fx);
+
+    /**
+     * @brief Play an effect on top of the base, replacing any running overlay
+     *
+     * Never blocks; safe from any task.
+     */
+    void led_fx_play(const led_fx_t *fx);
+
+    /**
+     * @brief End the overlay and fade back to the base
+     */
+    void led_fx_stop(void);
+
+    /**
+     * @brief Gold/white celebration chase for @p duration_ms; bigger sales
+     * (@p amount in minor units) chase faster and brighter
+     */
+    void led_fx_celebrate(int64_t amount, uint16_t duration_ms);
+
+    /**
+     * @brief Copy the service counters
+     */
+    void led_fx_get_stats(led_fx_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LED_FX_H */
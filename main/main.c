@@ -3,14 +3,18 @@
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 /* ESP System */
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_random.h"
 #include "esp_event.h"
 #include "esp_netif.h"
 #include "nvs_flash.h"
 #include "esp_mac.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
 
 /* Wi-Fi */
 #include "esp_wifi.h"
@@ -24,15 +28,27 @@
 
 /* MQTT */
 #include "mqtt_client.h"
+#include "mqtt_tls.h"
 
-/* JSON parsing */
-#include "cJSON.h"
+/* Sale message parsing */
+#include "sale_parser.h"
+#include "sale_batch.h"
+#include "sale_trace.h"
+#include "sale_dedup.h"
+#include "sale_router.h"
+#include "topic_config.h"
+#include "sales_total.h"
+#include "ota_update.h"
+
+/* Wi-Fi credentials */
+#include "wifi_store.h"
 
 /* QR Code */
 #include "qrcode.h"
+#include "qr_bitmap.h"
 
 /* Hardware */
-#include "led_strip.h"
+#include "led_fx.h"
 
 /* LCD and LVGL */
 #include "esp_lcd_panel_io.h"
@@ -43,7 +59,17 @@
 #include "driver/gpio.h"
 #include "lvgl.h"
 #include "esp_lvgl_port.h"
-
+#include "assets.h"
+#include "anim_timeline.h"
+#include "coin_rain.h"
+#include "robot_face.h"
+#include "round_panel.h"
+#include "perf_monitor.h"
+#include "idle_power.h"
+#include "task_topology.h"
+#include "bench.h"
+
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -66,42 +92,61 @@
 #define LCD_RST 8
 #define LCD_BLK 7
 #define LCD_RES 240
+#define LCD_PCLK_HZ 40000000
 
-/* Animation */
-#define NUM_TOKENS 10
-#define TOKEN_SPACING (200 / (NUM_TOKENS - 1))
-#define RAIN_TIME_MS 1800
-
-/* Colors */
-#define COL_BG 0x1A1A2E
-#define COL_ROBOT 0x4A4A4A
-#define COL_ACCENT 0x6A6A6A
-#define COL_CYAN 0x00FFFF
-#define COL_GREEN 0x00FF00
-#define COL_GOLD 0xFFD700
-#define COL_MONEY_GREEN 0x228B22
-#define COL_RED 0xFF0000
+/* Display buffering, picked in menuconfig ("Money Bot Display") */
+#if CONFIG_MONEYBOT_DISPLAY_BUF_PSRAM_FULL
+#define LCD_BUF_ROWS LCD_RES
+#elif CONFIG_MONEYBOT_DISPLAY_BUF_STRIPES
+#define LCD_BUF_ROWS CONFIG_MONEYBOT_DISPLAY_STRIPE_ROWS
+#else
+#define LCD_BUF_ROWS 50
+#endif
+
+/* Animation (colors are in robot_face.h) */
+#define CELEBRATE_SUCCESS_MS 2200 /* Gold celebration -> green success */
+#define CELEBRATE_IDLE_MS 3700    /* Success -> back to idle */
 
 /* Device Identity */
 #define DEFAULT_DEVICE_ID "moneybot-dev-001"
 #define NVS_NAMESPACE "moneybot"
 #define NVS_KEY_DEVICE_ID "device_id"
+#define NVS_KEY_WIFI_BSSID "wifi_bssid"
+#define NVS_KEY_WIFI_CHANNEL "wifi_chan"
+#define NVS_KEY_WIFI_AUTH "wifi_auth"
+#define NVS_KEY_SAVED_TIME "saved_time"
+#define NVS_KEY_QR_CACHE "qr_cache"
 
 /* AWS IoT MQTT Configuration */
 #define AWS_IOT_ENDPOINT "a3krir0duhayc0-ats.iot.us-east-1.amazonaws.com"
 #define AWS_IOT_PORT 8883
 #define MQTT_BROKER_URI "mqtts://" AWS_IOT_ENDPOINT ":8883"
+#define MQTT_CMD_QOS 1             /* With a persistent session the broker queues sales while we are away */
+#define MQTT_REPLAY_SETTLE_MS 1000 /* Hold celebrations this long after resuming a session */
 
 /* Provisioning */
 #define PROV_SERVICE_NAME_PREFIX "PROV_MoneyBot_"
 #define PROV_POP "abcd1234" /* Proof of possession - change in production */
 
 /* Timing */
-#define ANIMATION_DEBOUNCE_MS 1000
 #define SNTP_SYNC_TIMEOUT_MS 30000 /* Increased for hotspot latency */
 #define SNTP_RETRY_COUNT 3         /* Retry SNTP if it fails */
+#define TIME_VALID_MIN_EPOCH 1451606400 /* 2016-01-01; anything earlier is an unset clock */
+#define TIME_RTC_SAVE_INTERVAL_S 60     /* RTC memory is free to write */
+#define TIME_NVS_SAVE_INTERVAL_S 3600   /* Flash writes kept rare to limit wear */
 #define WIFI_CONNECT_TIMEOUT_MS 5000
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000 /* Direct connect using cached channel/BSSID */
 #define WIFI_RETRY_MAX 2
+#define WIFI_BACKOFF_MIN_MS 2000         /* First reconnect delay, doubled per failed attempt */
+#define WIFI_BACKOFF_MAX_MS 60000        /* Also bounds how long a returning network goes unnoticed */
+#define WIFI_PORTAL_AFTER_ATTEMPTS 3     /* Failed attempts before the portal joins in */
+#define BOOT_REPORT_TIMEOUT_MS 60000
+#define LATENCY_REPORT_INTERVAL_S 300 /* Publish latency histograms when new traces exist */
+
+/* Idle power, set in menuconfig ("Money Bot Power") */
+#define IDLE_AFTER_MS (CONFIG_MONEYBOT_IDLE_AFTER_S * 1000)
+#define IDLE_WAKE_MS CONFIG_MONEYBOT_IDLE_WAKE_MS
+#define WIFI_LISTEN_INTERVAL CONFIG_MONEYBOT_WIFI_LISTEN_INTERVAL /* Beacons skipped in max modem sleep */
 
 /* ============================================================================
  * EMBEDDED CERTIFICATES (from build)
@@ -119,15 +164,10 @@ extern const uint8_t server_cert_pem_end[] asm("_binary_amazon_root_ca_pem_end")
 static const char *TAG = "MoneyBot";
 
 /* Hardware handles */
-static led_strip_handle_t led;
 static lv_disp_t *disp;
 static esp_mqtt_client_handle_t mqtt_client = NULL;
 
-/* UI elements */
-static lv_obj_t *pupils[2], *antenna_ball;
-static lv_obj_t *mouth, *mouth_text, *grille_lines[3];
-static lv_obj_t *tokens[NUM_TOKENS];
-/* status_label reserved for future use */
+/* UI elements; the face's own are in robot_face.c */
 static lv_obj_t *qr_canvas = NULL;
 static lv_obj_t *main_screen = NULL;
 static lv_obj_t *prov_screen = NULL;
@@ -135,24 +175,42 @@ static lv_obj_t *prov_screen = NULL;
 /* Device identity */
 static char device_id[32] = {0};
 static char cmd_topic[64] = {0};
+static char telemetry_topic[64] = {0};
 
 /* Event groups */
 static EventGroupHandle_t wifi_event_group;
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT BIT1
+#define WIFI_PROV_DONE_BIT BIT2 /* Captive portal saved new credentials */
+#define WIFI_RECONNECT_BIT BIT3 /* Link lost, or a known network showed up in a scan */
 #define PROV_END_BIT BIT2
 
-/* Animation queue */
-static QueueHandle_t animation_queue;
+/* Fragment reassembly for MQTT_EVENT_DATA (esp-mqtt task only) */
+static sale_reassembly_t mqtt_reassembly;
+/* Recent eventIds: QoS 1 redeliveries and publisher retries (esp-mqtt task only) */
+static sale_dedup_t mqtt_dedup;
+
+/* Subscriptions: own, group and fleet scopes, each with a JSON and a binary
+ * topic; rebuilt from topics_cfg (esp-mqtt task only once MQTT runs) */
+#define MQTT_SUBS_MAX (2 * TOPIC_SCOPE_COUNT)
 typedef struct
 {
-    int32_t amount;
-    char currency[8];
-    char event_id[64];
-} sale_event_t;
-
-/* Debounce */
-static int64_t last_animation_time = 0;
+    char filter[TOPIC_MAX_LEN];
+    topic_scope_t scope;
+    bool binary; /* Carries sale_parse_binary() records */
+} mqtt_sub_t;
+
+static topic_config_t topics_cfg;
+static mqtt_sub_t mqtt_subs[MQTT_SUBS_MAX];
+static int mqtt_sub_count = 0;
+static const mqtt_sub_t *mqtt_msg_sub = NULL; /* Topic of the message being reassembled */
+static uint32_t mqtt_filtered = 0;            /* Sales dropped by a scope filter */
+/* The benchmark sets dry_run, so nothing it sends celebrates */
+static sale_router_t mqtt_router = {.topics = &topics_cfg, .dedup = &mqtt_dedup};
+
+#if CONFIG_MONEYBOT_BENCH_AT_BOOT
+static bool bench_boot_done = false;
+#endif
 
 /* Connection state */
 typedef enum
@@ -165,18 +223,117 @@ typedef enum
     CONN_STATE_MQTT_CONNECTED
 } conn_state_t;
 
+/* Written by network event handlers, shown by the LVGL task; access atomically */
 static conn_state_t connection_state = CONN_STATE_DISCONNECTED;
 
+static conn_state_t conn_state_get(void)
+{
+    return __atomic_load_n(&connection_state, __ATOMIC_ACQUIRE);
+}
+
+/* Boot orchestration: each phase runs in its own task and signals completion
+ * through boot_event_group so dependents can start as soon as possible. */
+typedef enum
+{
+    BOOT_PHASE_DISPLAY,
+    BOOT_PHASE_WIFI,
+    BOOT_PHASE_TIME,
+    BOOT_PHASE_MQTT_PREP,
+    BOOT_PHASE_MQTT_CONNECT,
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+static EventGroupHandle_t boot_event_group;
+#define BOOT_DISPLAY_READY_BIT BIT0
+#define BOOT_WIFI_READY_BIT BIT1
+#define BOOT_TIME_READY_BIT BIT2
+#define BOOT_MQTT_PREPARED_BIT BIT3
+#define BOOT_MQTT_CONNECTED_BIT BIT4
+#define BOOT_TIME_SYNCED_BIT BIT5 /* First SNTP answer; not needed to finish boot */
+#define BOOT_ALL_BITS (BOOT_DISPLAY_READY_BIT | BOOT_WIFI_READY_BIT | BOOT_TIME_READY_BIT | \
+                       BOOT_MQTT_PREPARED_BIT | BOOT_MQTT_CONNECTED_BIT)
+
+static struct
+{
+    const char *name;
+    int64_t start_us;
+    int64_t end_us;
+} boot_phases[BOOT_PHASE_COUNT] = {
+    [BOOT_PHASE_DISPLAY] = {.name = "display"},
+    [BOOT_PHASE_WIFI] = {.name = "wifi"},
+    [BOOT_PHASE_TIME] = {.name = "time_sync"},
+    [BOOT_PHASE_MQTT_PREP] = {.name = "mqtt_prep"},
+    [BOOT_PHASE_MQTT_CONNECT] = {.name = "mqtt_connect"},
+};
+
 /* ============================================================================
  * FORWARD DECLARATIONS
  * ============================================================================ */
 static void init_display(void);
-static void create_robot_face(lv_obj_t *scr);
-static void create_tokens(lv_obj_t *scr);
-static void trigger_sale_animation(const sale_event_t *event);
+static void trigger_sale_animation(const sale_batch_t *batch);
 static void show_provisioning_screen(void);
 static void show_main_screen(void);
 static void update_connection_indicator(conn_state_t state);
+static void conn_indicator_apply(void);
+static void portal_scan_done(void);
+static void power_start(void);
+static void save_time_to_nvs(void);
+static void publish_latency_if_new(void);
+#if CONFIG_MONEYBOT_BENCH
+static void bench_start(void);
+#endif
+
+/* ============================================================================
+ * BOOT PHASE TRACKING
+ * ============================================================================ */
+static void boot_phase_begin(boot_phase_t phase)
+{
+    boot_phases[phase].start_us = esp_timer_get_time();
+}
+
+static void boot_phase_end(boot_phase_t phase, EventBits_t bit)
+{
+    if (boot_phases[phase].end_us == 0)
+    {
+        boot_phases[phase].end_us = esp_timer_get_time();
+    }
+    xEventGroupSetBits(boot_event_group, bit);
+}
+
+static void boot_report(void)
+{
+    ESP_LOGI(TAG, "=== Boot timeline (ms since power-on) ===");
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+    {
+        if (boot_phases[i].start_us == 0)
+        {
+            ESP_LOGI(TAG, "  %-12s | not started", boot_phases[i].name);
+        }
+        else if (boot_phases[i].end_us == 0)
+        {
+            ESP_LOGW(TAG, "  %-12s | start %6lld | incomplete", boot_phases[i].name,
+                     boot_phases[i].start_us / 1000);
+        }
+        else
+        {
+            ESP_LOGI(TAG, "  %-12s | start %6lld | end %6lld | %6lld ms", boot_phases[i].name,
+                     boot_phases[i].start_us / 1000, boot_phases[i].end_us / 1000,
+                     (boot_phases[i].end_us - boot_phases[i].start_us) / 1000);
+        }
+    }
+    ESP_LOGI(TAG, "=== End of boot timeline ===");
+}
+
+/* Free and largest-free-block figures at a state transition */
+static void heap_report(const char *stage)
+{
+    ESP_LOGI(TAG, "Heap [%s]: internal %u free, %u largest, %u min | PSRAM %u free",
+             stage,
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+             (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+             (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+}
 
 /* ============================================================================
  * NVS & DEVICE IDENTITY
@@ -192,6 +349,24 @@ static void init_nvs(void)
     ESP_ERROR_CHECK(ret);
 }
 
+static void build_subscriptions(void)
+{
+    mqtt_sub_count = 0;
+    for (int scope = 0; scope < TOPIC_SCOPE_COUNT; scope++)
+    {
+        for (int binary = 0; binary < 2; binary++)
+        {
+            mqtt_sub_t *sub = &mqtt_subs[mqtt_sub_count];
+            if (topic_config_topic(&topics_cfg, scope, device_id, binary, sub->filter, sizeof(sub->filter)))
+            {
+                sub->scope = scope;
+                sub->binary = binary;
+                mqtt_sub_count++;
+            }
+        }
+    }
+}
+
 static void load_device_id(void)
 {
     nvs_handle_t nvs;
@@ -213,9 +388,11 @@ static void load_device_id(void)
         ESP_LOGI(TAG, "Loaded device ID from NVS: %s", device_id);
     }
 
-    /* Build topic */
+    /* Build topics */
     snprintf(cmd_topic, sizeof(cmd_topic), "moneybot/%s/cmd", device_id);
-    ESP_LOGI(TAG, "Subscribe topic: %s", cmd_topic);
+    snprintf(telemetry_topic, sizeof(telemetry_topic), "moneybot/%s/telemetry", device_id);
+    topic_config_load(NVS_NAMESPACE, &topics_cfg);
+    build_subscriptions(); /* Logged topic by topic when subscribed */
 }
 
 static const char *get_device_id(void)
@@ -224,23 +401,93 @@ static const char *get_device_id(void)
 }
 
 /* ============================================================================
- * LED CONTROL
+ * RENDER MONITOR
  * ============================================================================ */
-static void set_led(uint8_t r, uint8_t g, uint8_t b)
+/* Per-frame render cost while the money rain is on screen (LVGL task only) */
+static coin_rain_stats_t rain_last; /* Counters at the end of the previous rain */
+
+static void rain_render_begin(void)
+{
+    perf_monitor_burst_begin();
+}
+
+static void rain_render_end(void)
+{
+    perf_burst_t burst;
+    coin_rain_stats_t rain;
+    bool measured = perf_monitor_burst_end(&burst);
+    coin_rain_get_stats(&rain);
+
+    if (measured)
+    {
+        ESP_LOGI(TAG, "Rain render (%d-row buffers): %lu frames, %lu fps, avg %lu ms, max %lu ms, %lu px/frame",
+                 LCD_BUF_ROWS, (unsigned long)burst.frames, (unsigned long)burst.fps,
+                 (unsigned long)burst.avg_ms, (unsigned long)burst.max_ms, (unsigned long)burst.px_per_frame);
+    }
+    ESP_LOGI(TAG, "Rain coins: %lu spawned, %lu trimmed, peak %lu on screen, %lu px invalidated",
+             (unsigned long)(rain.spawned - rain_last.spawned), (unsigned long)(rain.trimmed - rain_last.trimmed),
+             (unsigned long)rain.peak_live, (unsigned long)(rain.dirty_px - rain_last.dirty_px));
+    rain_last = rain;
+}
+
+/* LVGL scheduling lateness while MQTT connects, i.e. during the TLS
+ * handshake; the figure to compare across task layouts. The MQTT task
+ * only flags the probe; the connection indicator's LVGL timer starts and
+ * stops it, so the handler never waits on the LVGL lock. */
+static bool jitter_wanted = false;          /* Set from the MQTT task (atomic) */
+static const char *jitter_outcome = NULL;   /* Why it was cleared (atomic) */
+static bool jitter_running = false;         /* LVGL task only */
+
+static void connect_jitter_begin(void)
+{
+    __atomic_store_n(&jitter_wanted, true, __ATOMIC_RELEASE);
+    idle_power_kick(); /* Both timers are paused while idle */
+}
+
+static void connect_jitter_end(const char *outcome)
+{
+    __atomic_store_n(&jitter_outcome, outcome, __ATOMIC_RELAXED);
+    __atomic_store_n(&jitter_wanted, false, __ATOMIC_RELEASE);
+}
+
+/* LVGL task; a connect that came and went between two polls is not seen */
+static void connect_jitter_poll(void)
 {
-    led_strip_set_pixel(led, 0, r, g, b);
-    led_strip_refresh(led);
+    bool wanted = __atomic_load_n(&jitter_wanted, __ATOMIC_ACQUIRE);
+    if (wanted == jitter_running)
+    {
+        return;
+    }
+    jitter_running = wanted;
+    if (wanted)
+    {
+        perf_monitor_probe_begin();
+        return;
+    }
+
+    perf_summary_t late;
+    uint32_t samples = perf_monitor_probe_end(&late);
+    if (samples > 0)
+    {
+        ESP_LOGI(TAG, "Frame jitter during MQTT connect (%s, %s): %lu samples, late avg %lu us, p99 %lu us, max %lu us",
+                 __atomic_load_n(&jitter_outcome, __ATOMIC_RELAXED), TASK_LAYOUT_NAME, (unsigned long)samples,
+                 (unsigned long)late.avg, (unsigned long)late.p99, (unsigned long)late.max);
+    }
 }
 
 /* ============================================================================
  * DISPLAY INITIALIZATION
  * ============================================================================ */
-static void init_display(void)
+/* Subsetted font from the assets partition; LVGL's built-in default keeps
+ * the UI readable when the partition was never flashed */
+static const lv_font_t *ui_font(const char *name)
 {
-    gpio_config_t bk_cfg = {.mode = GPIO_MODE_OUTPUT, .pin_bit_mask = 1ULL << LCD_BLK};
-    gpio_config(&bk_cfg);
-    gpio_set_level(LCD_BLK, 1);
+    const lv_font_t *font = assets_font(name);
+    return font != NULL ? font : LV_FONT_DEFAULT;
+}
 
+static void init_display(void)
+{
     spi_bus_config_t bus = {
         .sclk_io_num = LCD_SCLK,
         .mosi_io_num = LCD_MOSI,
@@ -255,7 +502,7 @@ static void init_display(void)
     esp_lcd_panel_io_spi_config_t io_cfg = {
         .dc_gpio_num = LCD_DC,
         .cs_gpio_num = LCD_CS,
-        .pclk_hz = 40000000,
+        .pclk_hz = LCD_PCLK_HZ,
         .lcd_cmd_bits = 8,
         .lcd_param_bits = 8,
         .spi_mode = 0,
@@ -277,350 +524,423 @@ static void init_display(void)
     ESP_ERROR_CHECK(esp_lcd_panel_disp_on_off(panel, true));
 
     lvgl_port_cfg_t lvgl_cfg = ESP_LVGL_PORT_INIT_CONFIG();
+    lvgl_cfg.task_priority = TASK_LVGL_PRIORITY;
+    lvgl_cfg.task_stack = TASK_LVGL_STACK;
+    lvgl_cfg.task_affinity = TASK_CORE_UI;
+    /* With the tick stopped while idle, this bounds the wake. The port has no
+     * early wake, so it is also the rate the CPU leaves light sleep at */
+    lvgl_cfg.task_max_sleep_ms = IDLE_WAKE_MS;
     ESP_ERROR_CHECK(lvgl_port_init(&lvgl_cfg));
 
     lvgl_port_display_cfg_t disp_cfg = {
         .io_handle = io,
         .panel_handle = panel,
-        .buffer_size = LCD_RES * 50,
+        .buffer_size = LCD_RES * LCD_BUF_ROWS,
         .double_buffer = true,
         .hres = LCD_RES,
         .vres = LCD_RES,
+#if CONFIG_MONEYBOT_DISPLAY_BUF_PSRAM_FULL
+        .flags.buff_spiram = true,
+#else
+        .flags.buff_dma = true,
+#endif
     };
+
+    size_t internal_before = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t spiram_before = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
     disp = lvgl_port_add_disp(&disp_cfg);
+    ESP_ERROR_CHECK(disp ? ESP_OK : ESP_ERR_NO_MEM);
+
+    /* Our flush path is always installed so the perf monitor sees flush
+     * time and SPI bytes. PSRAM frames cannot be DMA'd by the SPI master
+     * without a full-size internal copy, so that mode needs the bounce. */
+    round_panel_config_t flush_cfg = {
+        .diameter = LCD_RES,
+#if CONFIG_MONEYBOT_DISPLAY_ROUND_FLUSH
+        .trim_to_disc = true,
+#endif
+#if CONFIG_MONEYBOT_DISPLAY_BUF_PSRAM_FULL
+        .bounce = true,
+        .worker_priority = TASK_FLUSH_PRIORITY,
+        .worker_core = TASK_CORE_UI,
+#endif
+    };
+
+    lvgl_port_lock(0);
+    esp_err_t err = round_panel_attach(disp, io, panel, &flush_cfg);
+    if (flush_cfg.bounce)
+    {
+        ESP_ERROR_CHECK(err);
+    }
+    else if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Flush path unavailable, using the port's flush without stats");
+    }
+    perf_monitor_attach(disp);
+    power_start(); /* Lights the backlight */
+    lvgl_port_unlock();
+
+    ESP_LOGI(TAG, "Display buffers: 2 x %d rows in %s, %u bytes internal, %u bytes PSRAM",
+             LCD_BUF_ROWS, disp_cfg.flags.buff_spiram ? "PSRAM" : "internal DMA RAM",
+             (unsigned)(internal_before - heap_caps_get_free_size(MALLOC_CAP_INTERNAL)),
+             (unsigned)(spiram_before - heap_caps_get_free_size(MALLOC_CAP_SPIRAM)));
 }
 
 /* ============================================================================
- * ROBOT FACE UI
+ * ANIMATION HELPERS
  * ============================================================================ */
-static void create_robot_face(lv_obj_t *scr)
-{
-    lv_obj_t *head = lv_obj_create(scr);
-    lv_obj_remove_style_all(head);
-    lv_obj_set_size(head, 200, 180);
-    lv_obj_align(head, LV_ALIGN_CENTER, 0, 15);
-    lv_obj_set_style_radius(head, 30, 0);
-    lv_obj_set_style_bg_color(head, lv_color_hex(COL_ROBOT), 0);
-    lv_obj_set_style_bg_opa(head, LV_OPA_COVER, 0);
-    lv_obj_set_style_border_width(head, 4, 0);
-    lv_obj_set_style_border_color(head, lv_color_hex(COL_ACCENT), 0);
-    lv_obj_clear_flag(head, LV_OBJ_FLAG_SCROLLABLE);
-
-    lv_obj_t *ant = lv_obj_create(scr);
-    lv_obj_remove_style_all(ant);
-    lv_obj_set_size(ant, 8, 30);
-    lv_obj_align(ant, LV_ALIGN_TOP_MID, 0, 15);
-    lv_obj_set_style_radius(ant, 4, 0);
-    lv_obj_set_style_bg_color(ant, lv_color_hex(COL_ACCENT), 0);
-    lv_obj_set_style_bg_opa(ant, LV_OPA_COVER, 0);
-
-    antenna_ball = lv_obj_create(scr);
-    lv_obj_remove_style_all(antenna_ball);
-    lv_obj_set_size(antenna_ball, 16, 16);
-    lv_obj_align(antenna_ball, LV_ALIGN_TOP_MID, 0, 5);
-    lv_obj_set_style_radius(antenna_ball, LV_RADIUS_CIRCLE, 0);
-    lv_obj_set_style_bg_color(antenna_ball, lv_color_hex(COL_CYAN), 0);
-    lv_obj_set_style_bg_opa(antenna_ball, LV_OPA_COVER, 0);
-
-    for (int i = 0; i < 2; i++)
-    {
-        lv_obj_t *eye = lv_obj_create(head);
-        lv_obj_remove_style_all(eye);
-        lv_obj_set_size(eye, 55, 40);
-        lv_obj_align(eye, i == 0 ? LV_ALIGN_TOP_LEFT : LV_ALIGN_TOP_RIGHT, i == 0 ? 20 : -20, 25);
-        lv_obj_set_style_radius(eye, 8, 0);
-        lv_obj_set_style_bg_color(eye, lv_color_hex(0x001515), 0);
-        lv_obj_set_style_bg_opa(eye, LV_OPA_COVER, 0);
-        lv_obj_set_style_border_width(eye, 3, 0);
-        lv_obj_set_style_border_color(eye, lv_color_hex(0x333333), 0);
-        lv_obj_clear_flag(eye, LV_OBJ_FLAG_SCROLLABLE);
-
-        pupils[i] = lv_obj_create(eye);
-        lv_obj_remove_style_all(pupils[i]);
-        lv_obj_set_size(pupils[i], 40, 26);
-        lv_obj_center(pupils[i]);
-        lv_obj_set_style_radius(pupils[i], 5, 0);
-        lv_obj_set_style_bg_color(pupils[i], lv_color_hex(COL_CYAN), 0);
-        lv_obj_set_style_bg_opa(pupils[i], LV_OPA_COVER, 0);
-        lv_obj_set_style_shadow_width(pupils[i], 15, 0);
-        lv_obj_set_style_shadow_color(pupils[i], lv_color_hex(COL_CYAN), 0);
-    }
-
-    mouth = lv_obj_create(head);
-    lv_obj_remove_style_all(mouth);
-    lv_obj_set_size(mouth, 80, 35);
-    lv_obj_align(mouth, LV_ALIGN_BOTTOM_MID, 0, -25);
-    lv_obj_set_style_radius(mouth, 8, 0);
-    lv_obj_set_style_bg_color(mouth, lv_color_hex(0x222222), 0);
-    lv_obj_set_style_bg_opa(mouth, LV_OPA_COVER, 0);
-    lv_obj_set_style_border_width(mouth, 2, 0);
-    lv_obj_set_style_border_color(mouth, lv_color_hex(0x444444), 0);
-    lv_obj_clear_flag(mouth, LV_OBJ_FLAG_SCROLLABLE);
-
-    for (int i = 0; i < 3; i++)
-    {
-        grille_lines[i] = lv_obj_create(mouth);
-        lv_obj_remove_style_all(grille_lines[i]);
-        lv_obj_set_size(grille_lines[i], 60, 3);
-        lv_obj_align(grille_lines[i], LV_ALIGN_TOP_MID, 0, 8 + i * 10);
-        lv_obj_set_style_bg_color(grille_lines[i], lv_color_hex(0x111111), 0);
-        lv_obj_set_style_bg_opa(grille_lines[i], LV_OPA_COVER, 0);
-    }
-
-    mouth_text = lv_label_create(mouth);
-    lv_label_set_text(mouth_text, "CHA-CHING!");
-    lv_obj_set_style_text_font(mouth_text, &lv_font_montserrat_16, 0);
-    lv_obj_set_style_text_color(mouth_text, lv_color_hex(COL_GOLD), 0);
-    lv_obj_center(mouth_text);
-    lv_obj_add_flag(mouth_text, LV_OBJ_FLAG_HIDDEN);
-}
-
-static void create_tokens(lv_obj_t *scr)
-{
-    for (int i = 0; i < NUM_TOKENS; i++)
-    {
-        tokens[i] = lv_obj_create(scr);
-        lv_obj_remove_style_all(tokens[i]);
-        lv_obj_set_size(tokens[i], 28, 28);
-        lv_obj_set_style_radius(tokens[i], LV_RADIUS_CIRCLE, 0);
-        lv_obj_set_style_bg_color(tokens[i], lv_color_hex(COL_GOLD), 0);
-        lv_obj_set_style_bg_opa(tokens[i], LV_OPA_COVER, 0);
-        lv_obj_set_style_border_width(tokens[i], 3, 0);
-        lv_obj_set_style_border_color(tokens[i], lv_color_hex(0xDAA520), 0);
-        lv_obj_set_style_shadow_width(tokens[i], 8, 0);
-        lv_obj_set_style_shadow_color(tokens[i], lv_color_hex(COL_GOLD), 0);
-        lv_obj_clear_flag(tokens[i], LV_OBJ_FLAG_SCROLLABLE);
-
-        lv_obj_t *dollar = lv_label_create(tokens[i]);
-        lv_label_set_text(dollar, "$");
-        lv_obj_set_style_text_font(dollar, &lv_font_montserrat_20, 0);
-        lv_obj_set_style_text_color(dollar, lv_color_hex(COL_MONEY_GREEN), 0);
-        lv_obj_center(dollar);
-
-        lv_obj_set_pos(tokens[i], 20 + (i * TOKEN_SPACING), -35);
-        lv_obj_add_flag(tokens[i], LV_OBJ_FLAG_HIDDEN);
-    }
+/* More coins, falling faster, for bigger sales; adds to any rain in flight */
+static void start_rain(int64_t amount)
+{
+    rain_render_begin();
+    coin_rain_burst(amount);
+}
+
+static void hide_tokens(void)
+{
+    rain_render_end();
+    coin_rain_clear();
 }
 
 /* ============================================================================
- * ANIMATION HELPERS
+ * DAILY TOTAL
  * ============================================================================ */
-static void anim_y_cb(void *var, int32_t v) { lv_obj_set_y((lv_obj_t *)var, v); }
-static void anim_opa_cb(void *var, int32_t v) { lv_obj_set_style_opa((lv_obj_t *)var, v, 0); }
+/* Slow poll: only catches the day rolling over, sales refresh it directly */
+#define TOTAL_LABEL_POLL_MS 60000
 
-static void set_eye_color(uint32_t color)
+/* LVGL task or lock held; the label is only redrawn when its text changes */
+static void update_total_label(void)
 {
-    lv_color_t c = lv_color_hex(color);
-    for (int i = 0; i < 2; i++)
+    static char shown[48];
+    char text[sizeof(shown)];
+    sales_total_day_t day;
+
+    if (main_screen == NULL)
+    {
+        return;
+    }
+    sales_total_get(&day);
+    sales_total_format(&day, text, sizeof(text));
+    if (strcmp(text, shown) != 0)
     {
-        lv_obj_set_style_bg_color(pupils[i], c, 0);
-        lv_obj_set_style_shadow_color(pupils[i], c, 0);
+        strcpy(shown, text);
+        robot_face_set_total(shown);
     }
-    lv_obj_set_style_bg_color(antenna_ball, c, 0);
 }
 
-static void open_mouth(void)
+static void total_label_timer_cb(lv_timer_t *timer)
 {
-    lv_obj_set_size(mouth, 130, 45);
-    lv_obj_set_style_bg_color(mouth, lv_color_hex(0x1A1A1A), 0);
-    lv_obj_set_style_border_width(mouth, 3, 0);
-    lv_obj_set_style_border_color(mouth, lv_color_hex(COL_GOLD), 0);
-    for (int i = 0; i < 3; i++)
-        lv_obj_add_flag(grille_lines[i], LV_OBJ_FLAG_HIDDEN);
-    lv_obj_clear_flag(mouth_text, LV_OBJ_FLAG_HIDDEN);
+    update_total_label();
 }
 
-static void close_mouth(void)
+/* LVGL task, once */
+static void total_label_start(void)
 {
-    lv_obj_set_size(mouth, 80, 35);
-    lv_obj_set_style_bg_color(mouth, lv_color_hex(0x222222), 0);
-    lv_obj_set_style_border_width(mouth, 2, 0);
-    lv_obj_set_style_border_color(mouth, lv_color_hex(0x444444), 0);
-    for (int i = 0; i < 3; i++)
-        lv_obj_clear_flag(grille_lines[i], LV_OBJ_FLAG_HIDDEN);
-    lv_obj_add_flag(mouth_text, LV_OBJ_FLAG_HIDDEN);
+    update_total_label();
+    lv_timer_create(total_label_timer_cb, TOTAL_LABEL_POLL_MS, NULL);
 }
 
-static void start_rain(void)
+/* ============================================================================
+ * SALE CELEBRATION TIMELINE
+ * ============================================================================ */
+/* Owned by the LVGL task; only touched from phase callbacks or under the lock */
+static anim_timeline_t celebration;
+static uint32_t celebration_sales = 0; /* Sales shown by the running celebration */
+static int64_t celebration_amount = 0;  /* Largest single-currency total among them */
+static sale_trace_t celebration_trace;   /* Oldest sale still waiting for its first frame */
+static bool celebration_trace_pending = false;
+
+static void celebration_first_frame(void *arg)
 {
-    for (int i = 0; i < NUM_TOKENS; i++)
+    if (celebration_trace_pending)
     {
-        lv_obj_clear_flag(tokens[i], LV_OBJ_FLAG_HIDDEN);
-        lv_obj_set_style_opa(tokens[i], LV_OPA_COVER, 0);
-        int x = 20 + (i * TOKEN_SPACING) + (rand() % 10) - 5;
-        int y_start = -30 - (rand() % 20);
-        lv_obj_set_pos(tokens[i], x, y_start);
-
-        lv_anim_t a;
-        lv_anim_init(&a);
-        lv_anim_set_var(&a, tokens[i]);
-        lv_anim_set_values(&a, y_start, 260);
-        lv_anim_set_time(&a, RAIN_TIME_MS + (rand() % 300));
-        lv_anim_set_delay(&a, (i % 3) * 100);
-        lv_anim_set_exec_cb(&a, anim_y_cb);
-        lv_anim_set_path_cb(&a, lv_anim_path_ease_in);
-        lv_anim_start(&a);
+        celebration_trace.frame_us = sale_trace_now();
+        celebration_trace_pending = false;
+        sale_trace_record_complete(&celebration_trace);
+        idle_power_frame_shown();
+    }
+}
 
-        lv_anim_t f;
-        lv_anim_init(&f);
-        lv_anim_set_var(&f, tokens[i]);
-        lv_anim_set_values(&f, LV_OPA_COVER, LV_OPA_TRANSP);
-        lv_anim_set_time(&f, 400);
-        lv_anim_set_delay(&f, ((i % 3) * 100) + RAIN_TIME_MS - 300);
-        lv_anim_set_exec_cb(&f, anim_opa_cb);
-        lv_anim_start(&f);
+/* The next refresh is the first one showing the sale */
+static void arm_first_frame_trace(void)
+{
+    if (celebration_trace_pending)
+    {
+        perf_monitor_on_next_frame(celebration_first_frame, NULL);
     }
 }
 
-static void hide_tokens(void)
+/* Phase 1: Celebrate - Gold eyes, open mouth, rain tokens */
+static void phase_celebrate(void *user_data)
+{
+    led_fx_celebrate(celebration_amount, CELEBRATE_SUCCESS_MS);
+    robot_face_set_eye_color(COL_GOLD);
+    robot_face_set_sales(celebration_sales);
+    robot_face_open_mouth();
+    start_rain(celebration_amount);
+    arm_first_frame_trace();
+}
+
+/* Phase 2: Success - Green eyes, close mouth */
+static void phase_success(void *user_data)
+{
+    static const led_fx_t success = {.type = LED_FX_SOLID, .color = {0, 255, 0}};
+    led_fx_play(&success);
+    robot_face_set_eye_color(COL_GREEN);
+    robot_face_close_mouth();
+}
+
+/* Phase 3: Return to idle */
+static void phase_idle(void *user_data)
 {
-    for (int i = 0; i < NUM_TOKENS; i++)
-        lv_obj_add_flag(tokens[i], LV_OBJ_FLAG_HIDDEN);
+    hide_tokens();
+    robot_face_set_eye_color(COL_CYAN);
+    celebration_sales = 0;
+    celebration_amount = 0;
+
+    conn_indicator_apply(); /* The eyes borrowed the antenna ball */
+    led_fx_stop();          /* Fade back to the connection color */
 }
 
+static const anim_timeline_phase_t celebration_phases[] = {
+    {.name = "celebrate", .at_ms = 0, .cb = phase_celebrate},
+    {.name = "success", .at_ms = CELEBRATE_SUCCESS_MS, .cb = phase_success},
+    {.name = "idle", .at_ms = CELEBRATE_IDLE_MS, .cb = phase_idle},
+};
+
 /* ============================================================================
  * SALE ANIMATION TRIGGER
  * ============================================================================ */
-static void trigger_sale_animation(const sale_event_t *event)
+/* Hands a batch to the LVGL task; returns immediately */
+static void trigger_sale_animation(const sale_batch_t *batch)
 {
-    if (event)
-    {
-        ESP_LOGI(TAG, "💰 SALE! Amount: %ld %s, Event: %s",
-                 (long)event->amount, event->currency, event->event_id);
-    }
-    else
+    ESP_LOGI(TAG, "💰 SALE! x%lu, Last event: %s",
+             (unsigned long)batch->count, batch->last_event_id);
+    for (int i = 0; i < batch->num_currencies; i++)
     {
-        ESP_LOGI(TAG, "💰 SALE! (unknown amount)");
+        ESP_LOGI(TAG, "   %lld %s (%lu sales)", (long long)batch->totals[i].amount,
+                 batch->totals[i].currency[0] ? batch->totals[i].currency : "?",
+                 (unsigned long)batch->totals[i].count);
     }
 
-    /* Phase 1: Celebrate - Gold eyes, open mouth, rain tokens */
-    set_led(255, 180, 0);
-    lvgl_port_lock(0);
-    set_eye_color(COL_GOLD);
-    open_mouth();
-    start_rain();
-    lvgl_port_unlock();
-
-    vTaskDelay(pdMS_TO_TICKS(2200));
-
-    /* Phase 2: Success - Green eyes, close mouth */
-    set_led(0, 255, 0);
-    lvgl_port_lock(0);
-    set_eye_color(COL_GREEN);
-    close_mouth();
-    lvgl_port_unlock();
-
-    vTaskDelay(pdMS_TO_TICKS(1500));
-
-    /* Phase 3: Return to idle */
+    idle_power_kick();
     lvgl_port_lock(0);
-    hide_tokens();
-    set_eye_color(COL_CYAN);
-    lvgl_port_unlock();
+    update_total_label();
+    celebration_sales += batch->count;
+    int64_t amount = 0; /* Largest single-currency total in this batch */
+    for (int i = 0; i < batch->num_currencies; i++)
+    {
+        if (batch->totals[i].amount > amount)
+        {
+            amount = batch->totals[i].amount;
+        }
+    }
+    if (amount > celebration_amount)
+    {
+        celebration_amount = amount;
+    }
+    if (!celebration_trace_pending)
+    {
+        celebration_trace = batch->trace;
+        celebration_trace_pending = true;
+    }
 
-    /* Restore connection-appropriate LED color */
-    if (connection_state == CONN_STATE_MQTT_CONNECTED)
+    if (!celebration.running)
     {
-        set_led(0, 50, 0); /* Dim green = fully connected */
+        anim_timeline_start(&celebration);
+    }
+    else if (anim_timeline_current_phase(&celebration) == 0)
+    {
+        /* Still raining: add coins and push the success phase out */
+        robot_face_set_sales(celebration_sales);
+        start_rain(amount);
+        led_fx_celebrate(celebration_amount, CELEBRATE_SUCCESS_MS);
+        arm_first_frame_trace();
+        anim_timeline_seek(&celebration, 1);
     }
     else
     {
-        set_led(0, 50, 50); /* Cyan = idle/partial */
+        /* Already winding down: jump back into the celebration */
+        anim_timeline_seek(&celebration, 0);
     }
+    lvgl_port_unlock();
 }
 
 /* ============================================================================
  * CONNECTION STATUS INDICATOR
  * ============================================================================ */
+/* Network handlers only publish the state; an LVGL timer repaints the
+ * antenna ball on its next run, so they never wait on the LVGL lock */
+#define CONN_INDICATOR_POLL_MS 50
+
+#define LED_SOLID(r, g, b) {.type = LED_FX_SOLID, .color = {r, g, b}}
+#define LED_PULSE(r, g, b, ms) {.type = LED_FX_PULSE, .color = {r, g, b}, .period_ms = ms}
+
+static const struct
+{
+    uint32_t color; /* Antenna ball */
+    led_fx_t led;   /* Status LED base effect */
+} conn_state_look[] = {
+    [CONN_STATE_DISCONNECTED] = {COL_RED, LED_SOLID(50, 0, 0)},
+    [CONN_STATE_WIFI_CONNECTING] = {COL_RED, LED_PULSE(50, 0, 0, 1200)},
+    [CONN_STATE_WIFI_PROVISIONING] = {COL_GOLD, LED_PULSE(50, 40, 0, 2000)},
+    [CONN_STATE_WIFI_CONNECTED] = {COL_CYAN, LED_SOLID(0, 50, 50)},
+    [CONN_STATE_MQTT_CONNECTING] = {COL_CYAN, LED_PULSE(0, 50, 50, 1200)},
+    [CONN_STATE_MQTT_CONNECTED] = {COL_GREEN, LED_SOLID(0, 50, 0)},
+};
+
+static uint32_t conn_state_published = 0; /* Updates published (any task, atomic) */
+static uint32_t conn_state_applied = 0;   /* Updates the LVGL timer has caught up with */
+static uint32_t conn_state_coalesced = 0; /* Updates superseded before they were drawn */
+
+/* Safe from any task: never touches LVGL */
 static void update_connection_indicator(conn_state_t state)
 {
-    connection_state = state;
-    uint32_t color;
+    __atomic_store_n(&connection_state, state, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&conn_state_published, 1, __ATOMIC_RELEASE);
+    led_fx_set_base(&conn_state_look[state].led);
+    idle_power_kick(); /* The poll timer is paused while idle */
+}
 
-    switch (state)
-    {
-    case CONN_STATE_MQTT_CONNECTED:
-        color = COL_GREEN;
-        set_led(0, 50, 0);
-        break;
-    case CONN_STATE_WIFI_CONNECTED:
-    case CONN_STATE_MQTT_CONNECTING:
-        color = COL_CYAN;
-        set_led(0, 50, 50);
-        break;
-    case CONN_STATE_WIFI_PROVISIONING:
-        color = COL_GOLD;
-        set_led(50, 40, 0);
-        break;
-    case CONN_STATE_DISCONNECTED:
-    case CONN_STATE_WIFI_CONNECTING:
-    default:
-        color = COL_RED;
-        set_led(50, 0, 0);
-        break;
-    }
+/* LVGL task only */
+static void conn_indicator_apply(void)
+{
+    robot_face_set_antenna_color(conn_state_look[conn_state_get()].color);
+}
 
-    if (antenna_ball)
+static void conn_indicator_timer_cb(lv_timer_t *timer)
+{
+    connect_jitter_poll();
+
+    uint32_t published = __atomic_load_n(&conn_state_published, __ATOMIC_ACQUIRE);
+    if (published == conn_state_applied)
     {
-        lvgl_port_lock(0);
-        lv_obj_set_style_bg_color(antenna_ball, lv_color_hex(color), 0);
-        lvgl_port_unlock();
+        return;
     }
+    conn_state_coalesced += published - conn_state_applied - 1;
+    conn_state_applied = published;
+    conn_indicator_apply();
+}
+
+/* Paint the current state and start following it (LVGL task, once) */
+static void conn_indicator_start(void)
+{
+    conn_state_applied = __atomic_load_n(&conn_state_published, __ATOMIC_ACQUIRE);
+    conn_indicator_apply();
+    lv_timer_create(conn_indicator_timer_cb, CONN_INDICATOR_POLL_MS, NULL);
 }
 
 /* ============================================================================
  * QR CODE / PROVISIONING SCREEN
  * ============================================================================ */
 
+#define QR_CANVAS_SIZE 120
+
 /* Captive portal HTTP server handle */
 static httpd_handle_t captive_httpd = NULL;
+static lv_color_t *qr_canvas_buf = NULL; /* Allocated with prov_screen, freed with it */
 static char captive_ssid[32] = {0}; /* SoftAP SSID for QR code */
 
-/* QR code rendering context for callback */
-static struct
+/* Generated QR modules, cached in NVS so re-entering provisioning skips
+ * the Reed-Solomon encoding. Keyed by the payload, which embeds the SSID. */
+typedef struct
 {
-    lv_obj_t *canvas;
-    lv_obj_t *screen;
-} qr_render_ctx;
+    char payload[100];
+    qr_bitmap_t bitmap;
+} qr_cache_t;
+
+static qr_bitmap_t *qr_capture = NULL; /* Target of qr_capture_modules() */
 
-/* Custom display function for QR code rendering to LVGL canvas */
-static void qr_display_to_canvas(esp_qrcode_handle_t qrcode)
+/* esp_qrcode display_func: keep the modules instead of drawing them */
+static void qr_capture_modules(esp_qrcode_handle_t qrcode)
 {
-    int qr_size = esp_qrcode_get_size(qrcode);
-    int module_px = 3; /* pixels per QR module */
-    int canvas_size = 120;
-    int margin = (canvas_size - (qr_size * module_px)) / 2;
+    if (qr_capture && !qr_bitmap_from_qrcode(qr_capture, qrcode))
+    {
+        ESP_LOGE(TAG, "QR code larger than %d modules", QR_BITMAP_MAX_SIZE);
+    }
+}
 
-    if (margin < 2)
+static bool load_qr_cache(qr_cache_t *cache, const char *payload)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
     {
-        module_px = 2;
-        margin = (canvas_size - (qr_size * module_px)) / 2;
+        return false;
     }
+    size_t len = sizeof(*cache);
+    esp_err_t err = nvs_get_blob(nvs, NVS_KEY_QR_CACHE, cache, &len);
+    nvs_close(nvs);
+
+    return err == ESP_OK && len == sizeof(*cache) && cache->bitmap.size > 0 &&
+           cache->bitmap.size <= QR_BITMAP_MAX_SIZE &&
+           strncmp(cache->payload, payload, sizeof(cache->payload)) == 0;
+}
 
-    /* Draw QR modules */
-    for (int y = 0; y < qr_size; y++)
+static void save_qr_cache(const qr_cache_t *cache)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK)
     {
-        for (int x = 0; x < qr_size; x++)
+        if (nvs_set_blob(nvs, NVS_KEY_QR_CACHE, cache, sizeof(*cache)) == ESP_OK)
         {
-            lv_color_t color = esp_qrcode_get_module(qrcode, x, y) ? lv_color_black() : lv_color_white();
-            for (int dy = 0; dy < module_px; dy++)
-            {
-                for (int dx = 0; dx < module_px; dx++)
-                {
-                    int px = margin + x * module_px + dx;
-                    int py = margin + y * module_px + dy;
-                    if (px < canvas_size && py < canvas_size)
-                    {
-                        lv_canvas_set_px_color(qr_render_ctx.canvas, px, py, color);
-                    }
-                }
-            }
+            nvs_commit(nvs);
         }
+        nvs_close(nvs);
+    }
+}
+
+/* Modules for the payload, from NVS when the SSID has not changed */
+static esp_err_t get_qr_modules(qr_cache_t *cache, const char *payload)
+{
+    int64_t start = esp_timer_get_time();
+    if (load_qr_cache(cache, payload))
+    {
+        ESP_LOGI(TAG, "QR loaded from cache in %lld us", esp_timer_get_time() - start);
+        return ESP_OK;
+    }
+
+    memset(cache, 0, sizeof(*cache));
+    strncpy(cache->payload, payload, sizeof(cache->payload) - 1);
+
+    esp_qrcode_config_t qr_cfg = {
+        .display_func = qr_capture_modules,
+        .max_qrcode_version = 10,
+        .qrcode_ecc_level = ESP_QRCODE_ECC_LOW,
+    };
+    qr_capture = &cache->bitmap;
+    esp_err_t ret = esp_qrcode_generate(&qr_cfg, payload);
+    qr_capture = NULL;
+    if (ret == ESP_OK && cache->bitmap.size == 0)
+    {
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    if (ret == ESP_OK)
+    {
+        save_qr_cache(cache);
+        ESP_LOGI(TAG, "QR generated in %lld us", esp_timer_get_time() - start);
     }
+    return ret;
 }
 
 static void show_provisioning_screen(void)
 {
+    /*
+     * QR code uses standard WiFi format that phones natively support.
+     * When scanned, phone will auto-connect to the device's SoftAP.
+     * Format: WIFI:T:nopass;S:<SSID>;P:;;
+     */
+    char qr_payload[100];
+    snprintf(qr_payload, sizeof(qr_payload), "WIFI:T:nopass;S:%s;P:;;", captive_ssid);
+
+    /* Resolve the modules before taking the LVGL lock (generation may take time) */
+    qr_cache_t *qr = NULL;
+    esp_err_t ret = ESP_OK;
+    if (prov_screen == NULL)
+    {
+        qr = malloc(sizeof(*qr));
+        ret = qr ? get_qr_modules(qr, qr_payload) : ESP_ERR_NO_MEM;
+    }
+
     lvgl_port_lock(0);
 
     if (prov_screen == NULL)
@@ -633,47 +953,36 @@ static void show_provisioning_screen(void)
         /* Title */
         lv_obj_t *title = lv_label_create(prov_screen);
         lv_label_set_text(title, "Setup WiFi");
-        lv_obj_set_style_text_font(title, &lv_font_montserrat_14, 0);
+        lv_obj_set_style_text_font(title, ui_font("montserrat_14"), 0);
         lv_obj_set_style_text_color(title, lv_color_hex(COL_CYAN), 0);
         lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 8);
 
-        /*
-         * QR code uses standard WiFi format that phones natively support.
-         * When scanned, phone will auto-connect to the device's SoftAP.
-         * Format: WIFI:T:nopass;S:<SSID>;P:;;
-         */
-        char qr_payload[100];
-        snprintf(qr_payload, sizeof(qr_payload), "WIFI:T:nopass;S:%s;P:;;", captive_ssid);
-
-        /* Create canvas for QR code */
-        static lv_color_t cbuf[120 * 120];
+        /* Create canvas for QR code; its buffer only lives as long as the screen */
+        size_t buf_bytes = LV_CANVAS_BUF_SIZE_TRUE_COLOR(QR_CANVAS_SIZE, QR_CANVAS_SIZE);
+        qr_canvas_buf = heap_caps_malloc(buf_bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (qr_canvas_buf == NULL)
+        {
+            qr_canvas_buf = heap_caps_malloc(buf_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        }
+        ESP_ERROR_CHECK(qr_canvas_buf ? ESP_OK : ESP_ERR_NO_MEM);
         qr_canvas = lv_canvas_create(prov_screen);
-        lv_canvas_set_buffer(qr_canvas, cbuf, 120, 120, LV_IMG_CF_TRUE_COLOR);
-        lv_canvas_fill_bg(qr_canvas, lv_color_white(), LV_OPA_COVER);
+        lv_canvas_set_buffer(qr_canvas, qr_canvas_buf, QR_CANVAS_SIZE, QR_CANVAS_SIZE, LV_IMG_CF_TRUE_COLOR);
         lv_obj_align(qr_canvas, LV_ALIGN_CENTER, 0, -8);
 
-        /* Store canvas in render context for callback */
-        qr_render_ctx.canvas = qr_canvas;
-        qr_render_ctx.screen = prov_screen;
-
-        /* Generate QR code using ESP-IDF API */
-        esp_qrcode_config_t qr_cfg = {
-            .display_func = qr_display_to_canvas,
-            .max_qrcode_version = 10,
-            .qrcode_ecc_level = ESP_QRCODE_ECC_LOW,
-        };
-
-        /* Unlock before QR generation (it may take time) */
-        lvgl_port_unlock();
-        esp_err_t ret = esp_qrcode_generate(&qr_cfg, qr_payload);
-        lvgl_port_lock(0);
-
-        if (ret != ESP_OK)
+        if (ret == ESP_OK)
+        {
+            /* Module runs straight into the canvas buffer */
+            qr_bitmap_blit(&qr->bitmap, qr_canvas_buf, QR_CANVAS_SIZE);
+            lv_obj_invalidate(qr_canvas);
+        }
+        else
         {
+            lv_canvas_fill_bg(qr_canvas, lv_color_white(), LV_OPA_COVER);
             ESP_LOGE(TAG, "Failed to generate QR code: %s", esp_err_to_name(ret));
             /* Show error text instead */
             lv_obj_t *err_label = lv_label_create(prov_screen);
             lv_label_set_text(err_label, "QR Error");
+            lv_obj_set_style_text_font(err_label, ui_font("montserrat_14"), 0);
             lv_obj_set_style_text_color(err_label, lv_color_hex(COL_RED), 0);
             lv_obj_align(err_label, LV_ALIGN_CENTER, 0, 0);
         }
@@ -681,7 +990,7 @@ static void show_provisioning_screen(void)
         /* Instructions with URL */
         lv_obj_t *instr = lv_label_create(prov_screen);
         lv_label_set_text(instr, "Scan, then visit:\n192.168.4.1");
-        lv_obj_set_style_text_font(instr, &lv_font_montserrat_14, 0);
+        lv_obj_set_style_text_font(instr, ui_font("montserrat_14"), 0);
         lv_obj_set_style_text_color(instr, lv_color_hex(0xAAAAAA), 0);
         lv_obj_set_style_text_align(instr, LV_TEXT_ALIGN_CENTER, 0);
         lv_obj_align(instr, LV_ALIGN_BOTTOM_MID, 0, -10);
@@ -693,6 +1002,22 @@ static void show_provisioning_screen(void)
 
     lv_disp_load_scr(prov_screen);
     lvgl_port_unlock();
+    free(qr);
+}
+
+/* Drop the QR screen and its canvas buffer once it is no longer shown */
+static void destroy_provisioning_screen(void)
+{
+    lvgl_port_lock(0);
+    if (prov_screen != NULL && lv_scr_act() != prov_screen)
+    {
+        lv_obj_del(prov_screen);
+        prov_screen = NULL;
+        qr_canvas = NULL;
+        free(qr_canvas_buf);
+        qr_canvas_buf = NULL;
+    }
+    lvgl_port_unlock();
 }
 
 static void show_main_screen(void)
@@ -705,53 +1030,154 @@ static void show_main_screen(void)
         lv_obj_set_style_bg_color(main_screen, lv_color_hex(COL_BG), 0);
         lv_obj_set_style_bg_opa(main_screen, LV_OPA_COVER, 0);
         lv_obj_clear_flag(main_screen, LV_OBJ_FLAG_SCROLLABLE);
-        create_robot_face(main_screen);
-        create_tokens(main_screen);
+        const robot_face_fonts_t fonts = {
+            .mouth = ui_font("montserrat_16"),
+            .total = ui_font("montserrat_14"),
+            .coin = ui_font("montserrat_20"),
+        };
+        robot_face_create(main_screen, &fonts);
+        anim_timeline_init(&celebration, celebration_phases,
+                           sizeof(celebration_phases) / sizeof(celebration_phases[0]), NULL);
+
+        /* Network tasks may already have moved the state on */
+        conn_indicator_start();
+        total_label_start();
     }
 
     lv_disp_load_scr(main_screen);
     lvgl_port_unlock();
+
+    if (prov_screen != NULL)
+    {
+        destroy_provisioning_screen();
+        heap_report("provisioning screen freed");
+    }
 }
 
 /* ============================================================================
  * WI-FI EVENT HANDLERS
  * ============================================================================ */
 static int wifi_retry_count = 0;
-static bool provisioning_mode = false; /* When true, don't attempt STA connections */
-static bool scanning_mode = false;     /* When true, don't auto-connect on STA_START */
+static bool provisioning_mode = false;   /* Captive portal up (AP+STA) */
+static bool wifi_started = false;        /* esp_wifi_start() done; the radio stays up from then on */
+static bool wifi_attempt_active = false; /* Supervisor is associating; disconnects are its business */
+static bool fast_connect_mode = false;   /* When true, a failure falls back to scan instead of retrying */
 
-static void wifi_event_handler(void *arg, esp_event_base_t event_base,
-                               int32_t event_id, void *event_data)
+/* Last associated AP, cached in NVS so warm boots can skip the scan */
+typedef struct
 {
-    if (event_base == WIFI_EVENT)
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t authmode;
+} wifi_ap_cache_t;
+
+static wifi_ap_cache_t ap_cache;
+static bool ap_cache_valid = false;
+
+static bool load_ap_cache(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
     {
-        switch (event_id)
-        {
-        case WIFI_EVENT_STA_START:
-            if (!provisioning_mode && !scanning_mode)
-            {
-                ESP_LOGI(TAG, "WiFi STA started, connecting...");
-                esp_wifi_connect();
-            }
-            break;
-        case WIFI_EVENT_STA_DISCONNECTED:
-        {
-            wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *)event_data;
-            ESP_LOGW(TAG, "WiFi disconnected (reason: %d)", event->reason);
-            update_connection_indicator(CONN_STATE_DISCONNECTED);
-            xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT);
+        return false;
+    }
 
-            if (!provisioning_mode)
-            {
-                wifi_retry_count++;
-                if (wifi_retry_count < WIFI_RETRY_MAX)
-                {
-                    ESP_LOGI(TAG, "Retry %d/%d...", wifi_retry_count, WIFI_RETRY_MAX);
-                    esp_wifi_connect();
-                }
-                else
-                {
-                    ESP_LOGW(TAG, "Max retries reached, signaling failure");
+    size_t len = sizeof(ap_cache.bssid);
+    esp_err_t err = nvs_get_blob(nvs, NVS_KEY_WIFI_BSSID, ap_cache.bssid, &len);
+    if (err == ESP_OK && len == sizeof(ap_cache.bssid))
+    {
+        err = nvs_get_u8(nvs, NVS_KEY_WIFI_CHANNEL, &ap_cache.channel);
+    }
+    if (err == ESP_OK)
+    {
+        err = nvs_get_u8(nvs, NVS_KEY_WIFI_AUTH, &ap_cache.authmode);
+    }
+    nvs_close(nvs);
+
+    ap_cache_valid = (err == ESP_OK && ap_cache.channel > 0);
+    return ap_cache_valid;
+}
+
+/* Store the current AP's channel/BSSID/auth mode; skips the write if unchanged */
+static void save_ap_cache(void)
+{
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK)
+    {
+        return;
+    }
+    wifi_store_mark_connected((const char *)ap.ssid); /* The cache belongs to this network */
+
+    if (ap_cache_valid && ap_cache.channel == ap.primary && ap_cache.authmode == (uint8_t)ap.authmode &&
+        memcmp(ap_cache.bssid, ap.bssid, sizeof(ap_cache.bssid)) == 0)
+    {
+        return;
+    }
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to open NVS for AP cache: %s", esp_err_to_name(err));
+        return;
+    }
+
+    memcpy(ap_cache.bssid, ap.bssid, sizeof(ap_cache.bssid));
+    ap_cache.channel = ap.primary;
+    ap_cache.authmode = (uint8_t)ap.authmode;
+
+    nvs_set_blob(nvs, NVS_KEY_WIFI_BSSID, ap_cache.bssid, sizeof(ap_cache.bssid));
+    nvs_set_u8(nvs, NVS_KEY_WIFI_CHANNEL, ap_cache.channel);
+    nvs_set_u8(nvs, NVS_KEY_WIFI_AUTH, ap_cache.authmode);
+    err = nvs_commit(nvs);
+    nvs_close(nvs);
+
+    ap_cache_valid = (err == ESP_OK);
+    ESP_LOGI(TAG, "Cached AP " MACSTR " (ch %d, auth %d)",
+             MAC2STR(ap_cache.bssid), ap_cache.channel, ap_cache.authmode);
+}
+
+static void wifi_event_handler(void *arg, esp_event_base_t event_base,
+                               int32_t event_id, void *event_data)
+{
+    if (event_base == WIFI_EVENT)
+    {
+        switch (event_id)
+        {
+        case WIFI_EVENT_STA_START:
+            ESP_LOGI(TAG, "WiFi STA started");
+            break;
+        case WIFI_EVENT_STA_DISCONNECTED:
+        {
+            wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *)event_data;
+            ESP_LOGW(TAG, "WiFi disconnected (reason: %d)", event->reason);
+            if (!provisioning_mode)
+            {
+                update_connection_indicator(CONN_STATE_DISCONNECTED);
+            }
+            xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT);
+
+            if (!wifi_attempt_active)
+            {
+                /* Link dropped while up: wake the supervisor */
+                xEventGroupSetBits(wifi_event_group, WIFI_RECONNECT_BIT);
+            }
+            else if (fast_connect_mode)
+            {
+                /* Cached AP is gone or moved; let the supervisor fall back to a scan */
+                xEventGroupSetBits(wifi_event_group, WIFI_FAIL_BIT);
+            }
+            else
+            {
+                wifi_retry_count++;
+                if (wifi_retry_count < WIFI_RETRY_MAX)
+                {
+                    ESP_LOGI(TAG, "Retry %d/%d...", wifi_retry_count, WIFI_RETRY_MAX);
+                    esp_wifi_connect();
+                }
+                else
+                {
+                    ESP_LOGW(TAG, "Max retries reached, signaling failure");
                     xEventGroupSetBits(wifi_event_group, WIFI_FAIL_BIT);
                 }
             }
@@ -766,6 +1192,9 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
         case WIFI_EVENT_AP_STADISCONNECTED:
             ESP_LOGI(TAG, "Station disconnected from SoftAP");
             break;
+        case WIFI_EVENT_SCAN_DONE:
+            portal_scan_done();
+            break;
         default:
             break;
         }
@@ -777,63 +1206,296 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
         wifi_retry_count = 0;
         xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
         update_connection_indicator(CONN_STATE_WIFI_CONNECTED);
+        save_ap_cache();
     }
 }
 
 /* ============================================================================
- * CAPTIVE PORTAL HTML
+ * CAPTIVE PORTAL ASSETS
  * ============================================================================ */
-static const char captive_html[] =
-    "<!DOCTYPE html><html><head>"
-    "<meta name='viewport' content='width=device-width,initial-scale=1'>"
-    "<title>MoneyBot WiFi Setup</title>"
-    "<style>"
-    "body{font-family:system-ui,sans-serif;background:#1a1a2e;color:#fff;"
-    "display:flex;justify-content:center;align-items:center;min-height:100vh;margin:0;}"
-    ".card{background:#252545;padding:2rem;border-radius:1rem;width:90%;max-width:320px;box-shadow:0 4px 20px rgba(0,0,0,0.3);}"
-    "h1{color:#00ffff;font-size:1.4rem;margin:0 0 1.5rem;text-align:center;}"
-    "label{display:block;margin:0.5rem 0 0.25rem;color:#aaa;font-size:0.9rem;}"
-    "input{width:100%;padding:0.75rem;border:1px solid #444;border-radius:0.5rem;"
-    "background:#1a1a2e;color:#fff;font-size:1rem;box-sizing:border-box;}"
-    "input:focus{outline:none;border-color:#00ffff;}"
-    "button{width:100%;padding:0.875rem;margin-top:1.5rem;border:none;border-radius:0.5rem;"
-    "background:linear-gradient(135deg,#00ffff,#00cc99);color:#1a1a2e;font-size:1rem;"
-    "font-weight:600;cursor:pointer;}"
-    "button:active{transform:scale(0.98);}"
-    ".info{text-align:center;color:#666;font-size:0.8rem;margin-top:1rem;}"
-    "</style></head><body>"
-    "<div class='card'>"
-    "<h1>🤖 MoneyBot WiFi</h1>"
-    "<form action='/save' method='POST'>"
-    "<label>WiFi Network</label><input name='ssid' required autocomplete='off' placeholder='Enter SSID'>"
-    "<label>Password</label><input name='pass' type='password' placeholder='Enter password'>"
-    "<button type='submit'>Connect</button>"
-    "</form>"
-    "<p class='info'>Device will restart after saving</p>"
-    "</div></body></html>";
-
-static const char success_html[] =
-    "<!DOCTYPE html><html><head>"
-    "<meta name='viewport' content='width=device-width,initial-scale=1'>"
-    "<title>Success</title>"
-    "<style>"
-    "body{font-family:system-ui,sans-serif;background:#1a1a2e;color:#fff;"
-    "display:flex;justify-content:center;align-items:center;min-height:100vh;margin:0;text-align:center;}"
-    ".card{background:#252545;padding:2rem;border-radius:1rem;}"
-    "h1{color:#00ff00;font-size:2rem;margin:0 0 1rem;}"
-    "p{color:#aaa;}"
-    "</style></head><body>"
-    "<div class='card'><h1>✓ Saved!</h1><p>MoneyBot is restarting...</p></div>"
-    "</body></html>";
+/* Pages live in main/portal/; the build packs each one plain and gzipped
+ * into the assets partition */
+#define PORTAL_FORM_MAX 1024
+#define PORTAL_CACHE_CONTROL "public, max-age=3600" /* Revalidated by ETag after that */
+
+typedef struct
+{
+    const char *name; /* Asset entry; the gzipped copy is <name>.gz */
+    asset_t plain;
+    asset_t gz;
+    /* Quoted CRC32 of each representation's bytes, filled on first use:
+     * strong validators must differ between encodings */
+    char etag_plain[12];
+    char etag_gz[12];
+} portal_asset_t;
+
+static portal_asset_t portal_index = {.name = "index.html"};
+static portal_asset_t portal_success = {.name = "success.html"};
+
+/* Serve a page gzipped when the client accepts it; 304 when its copy is current */
+static esp_err_t portal_send_asset(httpd_req_t *req, portal_asset_t *asset)
+{
+    if (asset->etag_plain[0] == '\0')
+    {
+        char gz_name[32];
+        snprintf(gz_name, sizeof(gz_name), "%s.gz", asset->name);
+        if (assets_get(asset->name, &asset->plain) != ESP_OK || assets_get(gz_name, &asset->gz) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Portal page %s missing from the assets partition", asset->name);
+            httpd_resp_set_status(req, "503 Service Unavailable");
+            return httpd_resp_sendstr(req, "Setup page unavailable");
+        }
+        /* The packer already computed them */
+        snprintf(asset->etag_gz, sizeof(asset->etag_gz), "\"%08" PRIx32 "\"", asset->gz.crc);
+        snprintf(asset->etag_plain, sizeof(asset->etag_plain), "\"%08" PRIx32 "\"", asset->plain.crc);
+    }
+
+    char hdr[64];
+    bool gzip = httpd_req_get_hdr_value_str(req, "Accept-Encoding", hdr, sizeof(hdr)) == ESP_OK &&
+                strstr(hdr, "gzip") != NULL;
+    const char *etag = gzip ? asset->etag_gz : asset->etag_plain;
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", PORTAL_CACHE_CONTROL);
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+    /* Compared against the representation this request would get; a list
+     * or a W/ prefix still matches */
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", hdr, sizeof(hdr)) == ESP_OK &&
+        strstr(hdr, etag) != NULL)
+    {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, "text/html");
+    if (gzip)
+    {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        return httpd_resp_send(req, (const char *)asset->gz.data, asset->gz.size);
+    }
+    return httpd_resp_send(req, (const char *)asset->plain.data, asset->plain.size);
+}
+
+/* ============================================================================
+ * WIFI SCAN
+ * ============================================================================ */
+/* Shared by the boot-time debug scan and the portal's background scan */
+static const wifi_scan_config_t wifi_scan_config = {
+    .ssid = NULL,
+    .bssid = NULL,
+    .channel = 0,
+    .show_hidden = true,
+    .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+    .scan_time.active.min = 100,
+    .scan_time.active.max = 300,
+};
+
+/* Collect the finished scan's records; caller frees. NULL when nothing was found */
+static wifi_ap_record_t *wifi_scan_fetch(uint16_t *count)
+{
+    *count = 0;
+    esp_wifi_scan_get_ap_num(count);
+    if (*count == 0)
+    {
+        return NULL;
+    }
+
+    wifi_ap_record_t *ap_list = malloc(sizeof(wifi_ap_record_t) * *count);
+    if (ap_list == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate memory for scan results");
+        esp_wifi_clear_ap_list();
+        *count = 0;
+        return NULL;
+    }
+    esp_wifi_scan_get_ap_records(count, ap_list);
+    return ap_list;
+}
+
+/* ============================================================================
+ * CAPTIVE PORTAL NETWORK LIST
+ * ============================================================================ */
+#define PORTAL_SCAN_MAX 16
+#define PORTAL_SCAN_MAX_AGE_MS 15000 /* Older results trigger a background rescan */
+
+typedef struct
+{
+    char ssid[33];
+    int8_t rssi;
+    bool secure;
+} portal_network_t;
+
+/* Filled from WIFI_EVENT_SCAN_DONE, read by the /networks handler */
+static struct
+{
+    portal_network_t networks[PORTAL_SCAN_MAX];
+    int count;
+    int64_t updated_us;
+    bool scanning;
+} portal_scan;
+static portMUX_TYPE portal_scan_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Kick off a non-blocking scan unless one is already running */
+static void portal_scan_start(void)
+{
+    bool start = false;
+    taskENTER_CRITICAL(&portal_scan_lock);
+    if (!portal_scan.scanning)
+    {
+        portal_scan.scanning = true;
+        start = true;
+    }
+    taskEXIT_CRITICAL(&portal_scan_lock);
+
+    if (start && esp_wifi_scan_start(&wifi_scan_config, false) != ESP_OK)
+    {
+        taskENTER_CRITICAL(&portal_scan_lock);
+        portal_scan.scanning = false;
+        taskEXIT_CRITICAL(&portal_scan_lock);
+    }
+}
+
+/* Publish scan records to the portal: strongest entry per SSID, strongest first */
+static void portal_scan_store(const wifi_ap_record_t *ap_list, uint16_t ap_count)
+{
+    portal_network_t found[PORTAL_SCAN_MAX];
+    int count = 0;
+
+    for (int i = 0; i < ap_count; i++)
+    {
+        const char *ssid = (const char *)ap_list[i].ssid;
+        if (ssid[0] == '\0')
+        {
+            continue; /* Hidden */
+        }
+        int j = 0;
+        while (j < count && strcmp(found[j].ssid, ssid) != 0)
+        {
+            j++;
+        }
+        if (j == count)
+        {
+            if (count == PORTAL_SCAN_MAX)
+            {
+                continue;
+            }
+            count++;
+        }
+        else if (found[j].rssi >= ap_list[i].rssi)
+        {
+            continue;
+        }
+        strlcpy(found[j].ssid, ssid, sizeof(found[j].ssid));
+        found[j].rssi = ap_list[i].rssi;
+        found[j].secure = ap_list[i].authmode != WIFI_AUTH_OPEN;
+    }
+
+    /* Small insertion sort by RSSI */
+    for (int i = 1; i < count; i++)
+    {
+        portal_network_t n = found[i];
+        int j = i;
+        while (j > 0 && found[j - 1].rssi < n.rssi)
+        {
+            found[j] = found[j - 1];
+            j--;
+        }
+        found[j] = n;
+    }
+
+    taskENTER_CRITICAL(&portal_scan_lock);
+    memcpy(portal_scan.networks, found, sizeof(found[0]) * count);
+    portal_scan.count = count;
+    portal_scan.updated_us = esp_timer_get_time();
+    portal_scan.scanning = false;
+    taskEXIT_CRITICAL(&portal_scan_lock);
+
+    ESP_LOGI(TAG, "Portal scan: %d networks", count);
+}
+
+static void portal_scan_done(void)
+{
+    if (!portal_scan.scanning)
+    {
+        return; /* A blocking scan from wifi_scan_networks() owns the results */
+    }
+
+    uint16_t ap_count = 0;
+    wifi_ap_record_t *ap_list = wifi_scan_fetch(&ap_count);
+    if (wifi_store_rank(ap_list, ap_count) > 0)
+    {
+        /* A known network is back; don't wait out the reconnect backoff */
+        xEventGroupSetBits(wifi_event_group, WIFI_RECONNECT_BIT);
+    }
+    portal_scan_store(ap_list, ap_count);
+    free(ap_list);
+}
+
+/* JSON string body with quotes, backslashes and control characters escaped */
+static void json_escape(char *dst, size_t dst_size, const char *src)
+{
+    size_t d = 0;
+    for (; *src && d + 7 < dst_size; src++)
+    {
+        unsigned char c = (unsigned char)*src;
+        if (c == '"' || c == '\\')
+        {
+            dst[d++] = '\\';
+            dst[d++] = (char)c;
+        }
+        else if (c < 0x20)
+        {
+            d += snprintf(dst + d, dst_size - d, "\\u%04x", c);
+        }
+        else
+        {
+            dst[d++] = (char)c;
+        }
+    }
+    dst[d] = '\0';
+}
 
 /* ============================================================================
  * CAPTIVE PORTAL HTTP HANDLERS
  * ============================================================================ */
 static esp_err_t captive_root_handler(httpd_req_t *req)
 {
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, captive_html, strlen(captive_html));
-    return ESP_OK;
+    return portal_send_asset(req, &portal_index);
+}
+
+/* Cached scan results; never waits for the radio */
+static esp_err_t captive_networks_handler(httpd_req_t *req)
+{
+    portal_network_t networks[PORTAL_SCAN_MAX];
+    taskENTER_CRITICAL(&portal_scan_lock);
+    int count = portal_scan.count;
+    bool stale = portal_scan.updated_us == 0 ||
+                 esp_timer_get_time() - portal_scan.updated_us > PORTAL_SCAN_MAX_AGE_MS * 1000LL;
+    memcpy(networks, portal_scan.networks, sizeof(networks[0]) * count);
+    taskEXIT_CRITICAL(&portal_scan_lock);
+
+    if (stale)
+    {
+        portal_scan_start();
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    char chunk[160];
+    snprintf(chunk, sizeof(chunk), "{\"scanning\":%s,\"networks\":[",
+             portal_scan.scanning ? "true" : "false");
+    httpd_resp_sendstr_chunk(req, chunk);
+    for (int i = 0; i < count; i++)
+    {
+        char ssid[100];
+        json_escape(ssid, sizeof(ssid), networks[i].ssid);
+        snprintf(chunk, sizeof(chunk), "%s{\"ssid\":\"%s\",\"rssi\":%d,\"secure\":%s}",
+                 i ? "," : "", ssid, networks[i].rssi, networks[i].secure ? "true" : "false");
+        httpd_resp_sendstr_chunk(req, chunk);
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    return httpd_resp_sendstr_chunk(req, NULL);
 }
 
 /* Handler for captive portal detection endpoints */
@@ -990,61 +1652,73 @@ static void url_decode(char *dst, const char *src, size_t dst_size)
     html_entity_decode(dst, temp, dst_size);
 }
 
-static esp_err_t captive_save_handler(httpd_req_t *req)
+/* Copy the raw (still encoded) value of form field @p name; false if absent */
+static bool form_field(const char *body, const char *name, char *out, size_t out_size)
 {
-    char buf[256];
-    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
-    if (ret <= 0)
-    {
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No data");
-        return ESP_FAIL;
-    }
-    buf[ret] = '\0';
-
-    ESP_LOGI(TAG, "Received form data: %s", buf);
-
-    /* Parse form data: ssid=xxx&pass=xxx */
-    char ssid_raw[64] = {0};
-    char pass_raw[64] = {0};
-    char ssid[64] = {0};
-    char pass[64] = {0};
-
-    char *ssid_start = strstr(buf, "ssid=");
-    char *pass_start = strstr(buf, "pass=");
-
-    if (ssid_start)
+    size_t name_len = strlen(name);
+    const char *p = body;
+    while (*p)
     {
-        ssid_start += 5;
-        char *ssid_end = strchr(ssid_start, '&');
-        if (ssid_end)
+        const char *end = strchr(p, '&');
+        if (end == NULL)
         {
-            size_t len = ssid_end - ssid_start;
-            if (len >= sizeof(ssid_raw))
-                len = sizeof(ssid_raw) - 1;
-            memcpy(ssid_raw, ssid_start, len);
+            end = p + strlen(p);
         }
-        else
+        if ((size_t)(end - p) > name_len && strncmp(p, name, name_len) == 0 && p[name_len] == '=')
         {
-            strncpy(ssid_raw, ssid_start, sizeof(ssid_raw) - 1);
+            const char *value = p + name_len + 1;
+            size_t len = end - value;
+            if (len >= out_size)
+            {
+                len = out_size - 1;
+            }
+            memcpy(out, value, len);
+            out[len] = '\0';
+            return true;
         }
+        p = *end ? end + 1 : end;
+    }
+    return false;
+}
+
+static esp_err_t captive_save_handler(httpd_req_t *req)
+{
+    /* Read the whole body, however the client splits it across packets */
+    char buf[PORTAL_FORM_MAX];
+    if (req->content_len == 0 || req->content_len >= sizeof(buf))
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, req->content_len ? "Form too large" : "No data");
+        return ESP_FAIL;
     }
 
-    if (pass_start)
+    size_t received = 0;
+    int timeouts = 0;
+    while (received < req->content_len)
     {
-        pass_start += 5;
-        char *pass_end = strchr(pass_start, '&');
-        if (pass_end)
+        int ret = httpd_req_recv(req, buf + received, req->content_len - received);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < 3)
         {
-            size_t len = pass_end - pass_start;
-            if (len >= sizeof(pass_raw))
-                len = sizeof(pass_raw) - 1;
-            memcpy(pass_raw, pass_start, len);
+            continue;
         }
-        else
+        if (ret <= 0)
         {
-            strncpy(pass_raw, pass_start, sizeof(pass_raw) - 1);
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Incomplete form");
+            return ESP_FAIL;
         }
+        received += ret;
     }
+    buf[received] = '\0';
+
+    ESP_LOGI(TAG, "Received form data (%u bytes)", (unsigned)received);
+
+    /* Parse form data: ssid=xxx&pass=xxx (values arrive percent-encoded) */
+    char ssid_raw[256] = {0};
+    char pass_raw[256] = {0};
+    char ssid[64] = {0};
+    char pass[64] = {0};
+
+    form_field(buf, "ssid", ssid_raw, sizeof(ssid_raw));
+    form_field(buf, "pass", pass_raw, sizeof(pass_raw));
 
     /* URL decode */
     url_decode(ssid, ssid_raw, sizeof(ssid));
@@ -1052,29 +1726,22 @@ static esp_err_t captive_save_handler(httpd_req_t *req)
 
     ESP_LOGI(TAG, "Received WiFi credentials - SSID: %s, Pass length: %d", ssid, (int)strlen(pass));
 
-    /* Save to NVS */
-    nvs_handle_t nvs;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
-    if (err == ESP_OK)
-    {
-        nvs_set_str(nvs, "wifi_ssid", ssid);
-        nvs_set_str(nvs, "wifi_pass", pass);
-        nvs_commit(nvs);
-        nvs_close(nvs);
-        ESP_LOGI(TAG, "WiFi credentials saved to NVS");
-    }
-    else
+    /* Save alongside the networks already known */
+    esp_err_t err = wifi_store_add(ssid, pass);
+    if (err != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to open NVS for writing: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to save WiFi credentials: %s", esp_err_to_name(err));
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid network name or password");
+        return ESP_FAIL;
     }
+    ESP_LOGI(TAG, "WiFi credentials saved to NVS");
 
     /* Send success page */
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, success_html, strlen(success_html));
+    portal_send_asset(req, &portal_success);
 
-    /* Restart after a short delay to let response be sent */
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    esp_restart();
+    /* The Wi-Fi supervisor connects with the new credentials and tears the
+     * portal down (not possible from inside its own handler) */
+    xEventGroupSetBits(wifi_event_group, WIFI_PROV_DONE_BIT);
 
     return ESP_OK;
 }
@@ -1083,8 +1750,10 @@ static esp_err_t captive_save_handler(httpd_req_t *req)
 static void start_captive_portal(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.max_uri_handlers = 10;
-    config.stack_size = 8192;
+    config.max_uri_handlers = 12;
+    config.stack_size = TASK_HTTPD_STACK;
+    config.task_priority = TASK_PORTAL_PRIORITY;
+    config.core_id = TASK_CORE_NET;
 
     if (httpd_start(&captive_httpd, &config) == ESP_OK)
     {
@@ -1104,6 +1773,14 @@ static void start_captive_portal(void)
         };
         httpd_register_uri_handler(captive_httpd, &save);
 
+        /* Background scan results for the SSID picker */
+        httpd_uri_t networks = {
+            .uri = "/networks",
+            .method = HTTP_GET,
+            .handler = captive_networks_handler,
+        };
+        httpd_register_uri_handler(captive_httpd, &networks);
+
         /* Captive portal detection endpoints - redirect to config */
         const char *detect_uris[] = {
             "/generate_204",              /* Android */
@@ -1159,6 +1836,7 @@ static void wifi_init(void)
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    ESP_ERROR_CHECK(esp_wifi_set_ps(idle_power_is_idle() ? WIFI_PS_MAX_MODEM : WIFI_PS_MIN_MODEM));
 
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
                                                &wifi_event_handler, NULL));
@@ -1169,10 +1847,9 @@ static void wifi_init(void)
 static void start_provisioning(void)
 {
     ESP_LOGI(TAG, "Starting WiFi provisioning (captive portal)...");
+    heap_report("before provisioning");
 
-    /* Set provisioning mode to prevent STA connection attempts */
     provisioning_mode = true;
-    wifi_retry_count = 0;
 
     update_connection_indicator(CONN_STATE_WIFI_PROVISIONING);
 
@@ -1193,10 +1870,15 @@ static void start_provisioning(void)
     };
     memcpy(ap_config.ap.ssid, captive_ssid, strlen(captive_ssid));
 
-    /* Use pure AP mode for provisioning - no STA connection attempts */
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
+    /* AP+STA: the STA side keeps scanning and reconnecting underneath the portal */
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
+    if (!wifi_started)
+    {
+        ESP_ERROR_CHECK(esp_wifi_start());
+        wifi_started = true;
+    }
+    portal_scan_start();
 
     /* Start DNS server for captive portal detection */
     dns_server_start();
@@ -1204,299 +1886,726 @@ static void start_provisioning(void)
     /* Start HTTP server for configuration page */
     start_captive_portal();
 
-    /* Show QR code screen */
+    /* Show QR code screen (display bring-up runs concurrently at boot) */
+    xEventGroupWaitBits(boot_event_group, BOOT_DISPLAY_READY_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
     show_provisioning_screen();
 
     ESP_LOGI(TAG, "Captive portal active - SSID: %s", captive_ssid);
     ESP_LOGI(TAG, "Connect and visit http://192.168.4.1 to configure WiFi");
+    heap_report("provisioning active");
 }
 
-/* Check if we have stored WiFi credentials */
-static bool has_stored_credentials(char *ssid_out, size_t ssid_len, char *pass_out, size_t pass_len)
+/* Tear down everything provisioning allocated and go back to the face;
+ * the STA link stays up */
+static void stop_provisioning(void)
 {
-    nvs_handle_t nvs;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs);
-    if (err != ESP_OK)
-    {
-        ESP_LOGI(TAG, "No NVS namespace found");
-        return false;
-    }
-
-    size_t len = ssid_len;
-    err = nvs_get_str(nvs, "wifi_ssid", ssid_out, &len);
-    if (err != ESP_OK || len == 0)
-    {
-        ESP_LOGI(TAG, "No stored SSID found");
-        nvs_close(nvs);
-        return false;
-    }
+    /* Let the success page reach the phone before the AP goes away */
+    vTaskDelay(pdMS_TO_TICKS(1000));
 
-    len = pass_len;
-    err = nvs_get_str(nvs, "wifi_pass", pass_out, &len);
-    if (err != ESP_OK)
-    {
-        /* Password might be empty for open networks */
-        ESP_LOGI(TAG, "No stored password found (open network?)");
-        pass_out[0] = '\0';
-    }
+    stop_captive_portal();
+    dns_server_stop();
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    provisioning_mode = false;
+    portal_scan.scanning = false; /* Nobody wants an unfinished portal scan now */
 
-    ESP_LOGI(TAG, "Loaded credentials - SSID: %s, Pass length: %d", ssid_out, (int)strlen(pass_out));
-    nvs_close(nvs);
-    return strlen(ssid_out) > 0;
+    show_main_screen(); /* Frees the provisioning screen */
+    heap_report("provisioning stopped");
 }
 
-/* Scan and print all visible WiFi networks for debugging */
-static void wifi_scan_networks(const char *target_ssid)
+/* Scan, re-rank the known networks by what is visible, and optionally print
+ * every network for debugging. False if the scan could not run. */
+static bool wifi_scan_networks(bool verbose)
 {
-    ESP_LOGI(TAG, "=== Scanning for WiFi networks ===");
-
-    wifi_scan_config_t scan_config = {
-        .ssid = NULL,
-        .bssid = NULL,
-        .channel = 0,
-        .show_hidden = true,
-        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
-        .scan_time.active.min = 100,
-        .scan_time.active.max = 300,
-    };
-
-    esp_err_t err = esp_wifi_scan_start(&scan_config, true);
-    if (err != ESP_OK)
+    if (verbose)
     {
-        ESP_LOGE(TAG, "WiFi scan failed: %s", esp_err_to_name(err));
-        return;
+        ESP_LOGI(TAG, "=== Scanning for WiFi networks ===");
     }
 
     uint16_t ap_count = 0;
-    esp_wifi_scan_get_ap_num(&ap_count);
-    ESP_LOGI(TAG, "Found %d networks:", ap_count);
-
-    if (ap_count == 0)
+    esp_err_t err = esp_wifi_scan_start(&wifi_scan_config, true);
+    if (err != ESP_OK)
     {
-        ESP_LOGW(TAG, "No networks found! Check antenna/location.");
-        return;
+        ESP_LOGE(TAG, "WiFi scan failed: %s", esp_err_to_name(err));
+        return false;
     }
 
-    wifi_ap_record_t *ap_list = malloc(sizeof(wifi_ap_record_t) * ap_count);
+    wifi_ap_record_t *ap_list = wifi_scan_fetch(&ap_count);
+    int known = wifi_store_rank(ap_list, ap_count);
+    ESP_LOGI(TAG, "Found %d networks, %d known", ap_count, known);
+
     if (ap_list == NULL)
     {
-        ESP_LOGE(TAG, "Failed to allocate memory for scan results");
-        return;
+        ESP_LOGW(TAG, "No networks found! Check antenna/location.");
+        return true;
     }
 
-    esp_wifi_scan_get_ap_records(&ap_count, ap_list);
-
-    bool target_found = false;
-    for (int i = 0; i < ap_count; i++)
+    if (verbose)
     {
-        const char *band = (ap_list[i].primary <= 14) ? "2.4GHz" : "5GHz";
-        ESP_LOGI(TAG, "  [%d] SSID: %-32s | Ch: %2d (%s) | RSSI: %d dBm",
-                 i + 1, ap_list[i].ssid, ap_list[i].primary, band, ap_list[i].rssi);
-
-        if (target_ssid && strcmp((char *)ap_list[i].ssid, target_ssid) == 0)
+        for (int i = 0; i < ap_count; i++)
         {
-            target_found = true;
-            ESP_LOGI(TAG, "  >>> TARGET NETWORK FOUND! <<<");
+            const char *band = (ap_list[i].primary <= 14) ? "2.4GHz" : "5GHz";
+            ESP_LOGI(TAG, "  [%d] SSID: %-32s | Ch: %2d (%s) | RSSI: %d dBm",
+                     i + 1, ap_list[i].ssid, ap_list[i].primary, band, ap_list[i].rssi);
         }
+        ESP_LOGI(TAG, "=== End of WiFi scan ===");
     }
 
-    if (target_ssid && !target_found)
+    if (known == 0)
     {
-        ESP_LOGW(TAG, "Target network '%s' NOT FOUND in scan!", target_ssid);
+        ESP_LOGW(TAG, "No known network in range");
         ESP_LOGW(TAG, "Possible reasons: 5GHz only, out of range, or hidden SSID");
     }
 
+    if (provisioning_mode)
+    {
+        portal_scan_store(ap_list, ap_count); /* Fresh list for the portal for free */
+    }
     free(ap_list);
-    ESP_LOGI(TAG, "=== End of WiFi scan ===");
+    return true;
 }
 
-static bool wifi_connect(void)
+/* Associate with one network. Pinned uses the cached BSSID/channel and
+ * gives up on the first failure so the caller can fall back to a scan. */
+static bool wifi_try_network(const wifi_store_entry_t *net, bool pinned)
 {
-    char stored_ssid[64] = {0};
-    char stored_pass[64] = {0};
-
-    wifi_init();
+    wifi_config_t sta_config = {0};
+    strlcpy((char *)sta_config.sta.ssid, net->ssid, sizeof(sta_config.sta.ssid));
+    strlcpy((char *)sta_config.sta.password, net->pass, sizeof(sta_config.sta.password));
+    sta_config.sta.listen_interval = WIFI_LISTEN_INTERVAL;
 
-    /* Check if we have stored credentials */
-    if (has_stored_credentials(stored_ssid, sizeof(stored_ssid), stored_pass, sizeof(stored_pass)))
+    if (pinned)
     {
-        ESP_LOGI(TAG, "Found stored credentials, connecting to: %s", stored_ssid);
-        update_connection_indicator(CONN_STATE_WIFI_CONNECTING);
-        show_main_screen();
-
-        /* Start WiFi in STA mode first to do a scan */
-        scanning_mode = true; /* Prevent auto-connect on STA_START */
-        ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-        ESP_ERROR_CHECK(esp_wifi_start());
+        /* Warm boot: connect straight to the cached AP, no scan */
+        ESP_LOGI(TAG, "Fast connect to '%s' at " MACSTR " on channel %d",
+                 net->ssid, MAC2STR(ap_cache.bssid), ap_cache.channel);
+        sta_config.sta.bssid_set = 1;
+        memcpy(sta_config.sta.bssid, ap_cache.bssid, sizeof(sta_config.sta.bssid));
+        sta_config.sta.channel = ap_cache.channel;
+        sta_config.sta.threshold.authmode = (wifi_auth_mode_t)ap_cache.authmode;
+    }
+    else if (net->rssi == WIFI_STORE_RSSI_UNSEEN)
+    {
+        ESP_LOGI(TAG, "Connecting to '%s' (not seen in a scan, may be hidden)", net->ssid);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Connecting to '%s' (RSSI %d dBm)", net->ssid, net->rssi);
+    }
 
-        /* Scan to see what networks are available */
-        wifi_scan_networks(stored_ssid);
-        scanning_mode = false; /* Allow connections now */
+    int64_t connect_start = esp_timer_get_time();
+    xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+    wifi_retry_count = 0;
+    fast_connect_mode = pinned;
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &sta_config));
+    esp_wifi_connect();
+
+    EventBits_t bits = xEventGroupWaitBits(wifi_event_group,
+                                           WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(pinned ? WIFI_FAST_CONNECT_TIMEOUT_MS : WIFI_CONNECT_TIMEOUT_MS));
+    if (bits & WIFI_CONNECTED_BIT)
+    {
+        fast_connect_mode = false;
+        ESP_LOGI(TAG, "WiFi connected in %lld ms (%s)",
+                 (esp_timer_get_time() - connect_start) / 1000, pinned ? "fast path" : "scan path");
+        return true;
+    }
 
-        wifi_config_t sta_config = {0};
-        strncpy((char *)sta_config.sta.ssid, stored_ssid, sizeof(sta_config.sta.ssid) - 1);
-        strncpy((char *)sta_config.sta.password, stored_pass, sizeof(sta_config.sta.password) - 1);
+    if (!(bits & WIFI_FAIL_BIT))
+    {
+        /* Timed out mid-association; make the disconnect final and wait for it to land */
+        wifi_retry_count = WIFI_RETRY_MAX;
+        esp_wifi_disconnect();
+        xEventGroupWaitBits(wifi_event_group, WIFI_FAIL_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(500));
+    }
+    fast_connect_mode = false;
+    xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+    return false;
+}
 
-        wifi_retry_count = 0;
-        ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &sta_config));
-        esp_wifi_connect();
+/* One pass over the known networks: the cached AP first (when @p fast),
+ * then every known network the scan found, strongest first, then those it
+ * did not (hidden SSIDs never show up by name) */
+static bool wifi_connect_known(bool fast)
+{
+    if (wifi_store_count() == 0)
+    {
+        return false;
+    }
 
-        /* Wait for connection with shorter timeout */
-        EventBits_t bits = xEventGroupWaitBits(wifi_event_group,
-                                               WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                                               pdFALSE, pdFALSE, pdMS_TO_TICKS(WIFI_CONNECT_TIMEOUT_MS));
+    if (!provisioning_mode)
+    {
+        update_connection_indicator(CONN_STATE_WIFI_CONNECTING);
+    }
+    if (!wifi_started)
+    {
+        ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+        ESP_ERROR_CHECK(esp_wifi_start());
+        wifi_started = true;
+    }
+
+    wifi_attempt_active = true;
+    bool connected = false;
+    wifi_store_entry_t net;
 
-        if (bits & WIFI_CONNECTED_BIT)
+    if (fast && wifi_store_last(&net) && load_ap_cache())
+    {
+        connected = wifi_try_network(&net, true);
+        if (!connected)
         {
-            return true;
+            ESP_LOGW(TAG, "Fast connect failed, falling back to full scan");
         }
+    }
 
-        /* Connection failed, stop WiFi and fall through to provisioning */
-        ESP_LOGW(TAG, "Stored WiFi connection failed, starting provisioning...");
-        esp_wifi_stop();
+    if (!connected)
+    {
+        /* Ranked with the unseen ones last; without a scan, all of them in
+         * the last known order */
+        wifi_scan_networks(fast);
+        for (int i = 0; !connected && wifi_store_get(i, &net); i++)
+        {
+            connected = wifi_try_network(&net, false);
+        }
     }
-    else
+
+    wifi_attempt_active = false;
+    return connected;
+}
+
+/* ============================================================================
+ * WI-FI RECONNECT SUPERVISOR
+ * ============================================================================ */
+/* Delay before retry @p attempt (1-based): exponential with jitter, so devices
+ * behind a rebooted router don't all come back in lockstep */
+static uint32_t wifi_backoff_ms(int attempt)
+{
+    uint32_t ms = WIFI_BACKOFF_MIN_MS;
+    for (int i = 1; i < attempt && ms < WIFI_BACKOFF_MAX_MS; i++)
+    {
+        ms *= 2;
+    }
+    if (ms > WIFI_BACKOFF_MAX_MS)
+    {
+        ms = WIFI_BACKOFF_MAX_MS;
+    }
+    return ms / 2 + esp_random() % (ms / 2 + 1);
+}
+
+/* Owns the STA link for the life of the device: connects, sleeps while the
+ * link is up, and backs off while it is down. The captive portal runs
+ * alongside once a few attempts have failed and goes away as soon as any
+ * known network is back. */
+static void wifi_supervisor_task(void *pvParameters)
+{
+    int attempt = 0;
+
+    if (wifi_store_count() == 0)
     {
         ESP_LOGI(TAG, "No stored credentials, starting provisioning immediately...");
+        start_provisioning();
     }
 
-    /* Start captive portal provisioning */
-    start_provisioning();
+    while (1)
+    {
+        if (wifi_connect_known(attempt == 0))
+        {
+            attempt = 0;
+            if (provisioning_mode)
+            {
+                stop_provisioning();
+            }
+
+            /* A disconnect before this point has already cleared CONNECTED */
+            xEventGroupClearBits(wifi_event_group, WIFI_RECONNECT_BIT);
+            while (xEventGroupGetBits(wifi_event_group) & WIFI_CONNECTED_BIT)
+            {
+                xEventGroupWaitBits(wifi_event_group, WIFI_RECONNECT_BIT, pdTRUE, pdFALSE, portMAX_DELAY);
+            }
+            ESP_LOGW(TAG, "WiFi lost, reconnecting...");
+            continue;
+        }
 
-    /* Wait forever for user to configure WiFi (device will restart after config) */
+        attempt++;
+        if (attempt >= WIFI_PORTAL_AFTER_ATTEMPTS && !provisioning_mode)
+        {
+            ESP_LOGW(TAG, "Still offline after %d attempts, starting captive portal alongside", attempt);
+            start_provisioning();
+        }
+
+        /* New credentials, or a known network seen by a portal scan, end the wait early */
+        TickType_t wait = portMAX_DELAY;
+        if (wifi_store_count() > 0)
+        {
+            uint32_t delay_ms = wifi_backoff_ms(attempt);
+            ESP_LOGI(TAG, "Reconnect attempt %d failed, next in %lu ms", attempt, (unsigned long)delay_ms);
+            wait = pdMS_TO_TICKS(delay_ms);
+        }
+        xEventGroupWaitBits(wifi_event_group, WIFI_RECONNECT_BIT | WIFI_PROV_DONE_BIT, pdTRUE, pdFALSE, wait);
+    }
+}
+
+/* Start the supervisor and block until the first connection */
+static bool wifi_connect(void)
+{
+    wifi_init();
+    ESP_ERROR_CHECK(wifi_store_init(NVS_NAMESPACE));
+
+    if (xTaskCreatePinnedToCore(wifi_supervisor_task, "wifi_sup", TASK_WIFI_STACK, NULL,
+                                TASK_WIFI_PRIORITY, NULL, TASK_CORE_NET) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create WiFi supervisor task");
+        return false;
+    }
+    xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    return true;
+}
+
+/* ============================================================================
+ * SERVICE TASK
+ * ============================================================================ */
+/* Slow work handed off by esp_timer callbacks and network handlers, so a
+ * flash write or the MQTT client lock never holds up the esp_timer task and
+ * the LVGL tick with it */
+#define SERVICE_SAVE_TIME BIT0      /* Wall clock to NVS */
+#define SERVICE_LATENCY_REPORT BIT1 /* Latency histograms, when there are new traces */
+
+static TaskHandle_t service_task_handle = NULL;
+
+/* Any task; work posted before the service starts is dropped */
+static void service_notify(uint32_t work)
+{
+    if (service_task_handle != NULL)
+    {
+        xTaskNotify(service_task_handle, work, eSetBits);
+    }
+}
+
+static void service_task(void *pvParameters)
+{
     while (1)
     {
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        uint32_t work = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &work, portMAX_DELAY);
+        if (work & SERVICE_SAVE_TIME)
+        {
+            save_time_to_nvs();
+        }
+        if (work & SERVICE_LATENCY_REPORT)
+        {
+            publish_latency_if_new();
+        }
     }
+}
 
-    return false;
+static void service_start(void)
+{
+    if (xTaskCreatePinnedToCore(service_task, "service", TASK_SERVICE_STACK, NULL, TASK_SERVICE_PRIORITY,
+                                &service_task_handle, TASK_CORE_NET) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create service task");
+    }
 }
 
 /* ============================================================================
  * SNTP TIME SYNCHRONIZATION
  * ============================================================================ */
-static void time_sync_notification_cb(struct timeval *tv)
+
+/* Wall clock persisted across resets. RTC memory survives soft resets and
+ * deep sleep; NVS covers power loss. Either gives a lower bound on the real
+ * time, which is enough for certificate validity checks. */
+#define TIME_RTC_MAGIC 0x54494D45 /* "TIME" */
+static RTC_NOINIT_ATTR uint32_t rtc_time_magic;
+static RTC_NOINIT_ATTR int64_t rtc_saved_time;
+
+static esp_timer_handle_t time_persist_timer = NULL;
+static int64_t time_restored_epoch = 0; /* 0 when the clock was not restored */
+static int64_t time_restored_at_us = 0;
+
+static bool time_is_valid(int64_t epoch)
 {
-    ESP_LOGI(TAG, "Time synchronized!");
+    return epoch >= TIME_VALID_MIN_EPOCH;
 }
 
-static bool obtain_time(void)
+/* Service task */
+static void save_time_to_nvs(void)
 {
-    ESP_LOGI(TAG, "Initializing SNTP...");
+    time_t now;
+    time(&now);
+    if (!time_is_valid(now))
+    {
+        return;
+    }
 
-    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    esp_sntp_setservername(0, "pool.ntp.org");
-    esp_sntp_setservername(1, "time.google.com");
-    esp_sntp_setservername(2, "time.cloudflare.com");
-    esp_sntp_set_time_sync_notification_cb(time_sync_notification_cb);
-    esp_sntp_init();
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK)
+    {
+        nvs_set_i64(nvs, NVS_KEY_SAVED_TIME, now);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+}
+
+/* esp_timer task: RTC memory here, the NVS write on the service task */
+static void time_persist_cb(void *arg)
+{
+    static int ticks = 0;
+    time_t now;
+    time(&now);
+    if (!time_is_valid(now))
+    {
+        return;
+    }
+
+    rtc_saved_time = now;
+    rtc_time_magic = TIME_RTC_MAGIC;
+
+    ticks++;
+    if (ticks >= TIME_NVS_SAVE_INTERVAL_S / TIME_RTC_SAVE_INTERVAL_S)
+    {
+        ticks = 0;
+        service_notify(SERVICE_SAVE_TIME);
+    }
+}
+
+static void time_persist_start(void)
+{
+    const esp_timer_create_args_t args = {
+        .callback = time_persist_cb,
+        .name = "time_persist",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &time_persist_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(time_persist_timer, TIME_RTC_SAVE_INTERVAL_S * 1000000ULL));
+}
+
+/* Seed the system clock from RTC/NVS if it is unset. Returns true if the
+ * clock is usable for TLS without waiting for SNTP. */
+static bool restore_saved_time(void)
+{
+    time_t now;
+    time(&now);
+    if (time_is_valid(now))
+    {
+        /* System time survived a soft reset */
+        ESP_LOGI(TAG, "System clock already valid");
+        return true;
+    }
 
-    /* Wait for time to be set with extended timeout */
-    time_t now = 0;
-    struct tm timeinfo = {0};
-    int retry = 0;
-    const int max_retries = SNTP_SYNC_TIMEOUT_MS / 500;
+    int64_t saved = 0;
+    if (rtc_time_magic == TIME_RTC_MAGIC)
+    {
+        saved = rtc_saved_time;
+    }
 
-    while (timeinfo.tm_year < (2016 - 1900) && ++retry < max_retries)
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK)
     {
-        if (retry % 10 == 0)
+        int64_t nvs_saved = 0;
+        if (nvs_get_i64(nvs, NVS_KEY_SAVED_TIME, &nvs_saved) == ESP_OK && nvs_saved > saved)
         {
-            ESP_LOGI(TAG, "Waiting for SNTP sync... (%d/%d)", retry, max_retries);
+            saved = nvs_saved;
         }
-        vTaskDelay(pdMS_TO_TICKS(500));
-        time(&now);
-        localtime_r(&now, &timeinfo);
+        nvs_close(nvs);
     }
 
-    if (timeinfo.tm_year < (2016 - 1900))
+    if (!time_is_valid(saved))
     {
-        ESP_LOGE(TAG, "SNTP sync timeout!");
+        ESP_LOGI(TAG, "No saved time, TLS must wait for SNTP");
         return false;
     }
 
+    struct timeval tv = {.tv_sec = (time_t)saved, .tv_usec = 0};
+    settimeofday(&tv, NULL);
+    time_restored_epoch = saved;
+    time_restored_at_us = esp_timer_get_time();
+
+    struct tm timeinfo;
     char strftime_buf[64];
+    localtime_r(&tv.tv_sec, &timeinfo);
     strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
-    ESP_LOGI(TAG, "Current time: %s", strftime_buf);
-
+    ESP_LOGI(TAG, "Restored saved time (lower bound): %s", strftime_buf);
     return true;
 }
 
+/* Runs on the lwIP thread; keep it short and leave flash writes to the service task */
+static void time_sync_notification_cb(struct timeval *tv)
+{
+    if (time_restored_epoch != 0)
+    {
+        int64_t estimate = time_restored_epoch + (esp_timer_get_time() - time_restored_at_us) / 1000000;
+        ESP_LOGI(TAG, "Time synchronized! Restored clock was %lld s behind",
+                 (long long)(tv->tv_sec - estimate));
+        time_restored_epoch = 0;
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Time synchronized!");
+    }
+
+    rtc_saved_time = tv->tv_sec;
+    rtc_time_magic = TIME_RTC_MAGIC;
+    service_notify(SERVICE_SAVE_TIME);
+    xEventGroupSetBits(boot_event_group, BOOT_TIME_SYNCED_BIT);
+}
+
+/* Start SNTP in the background; it keeps polling until a server answers */
+static void sntp_start(void)
+{
+    ESP_LOGI(TAG, "Initializing SNTP...");
+
+    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, "pool.ntp.org");
+    esp_sntp_setservername(1, "time.google.com");
+    esp_sntp_setservername(2, "time.cloudflare.com");
+    esp_sntp_set_time_sync_notification_cb(time_sync_notification_cb);
+    esp_sntp_init();
+}
+
+static bool wait_for_time_sync(void)
+{
+    for (int attempt = 1; attempt <= SNTP_RETRY_COUNT; attempt++)
+    {
+        EventBits_t bits = xEventGroupWaitBits(boot_event_group, BOOT_TIME_SYNCED_BIT, pdFALSE, pdTRUE,
+                                               pdMS_TO_TICKS(SNTP_SYNC_TIMEOUT_MS));
+        if (bits & BOOT_TIME_SYNCED_BIT)
+        {
+            return true;
+        }
+        ESP_LOGW(TAG, "Still waiting for SNTP sync... (%d/%d)", attempt, SNTP_RETRY_COUNT);
+    }
+    return false;
+}
+
 /* ============================================================================
- * MQTT MESSAGE HANDLING
+ * DIAGNOSTICS
  * ============================================================================ */
-static void handle_mqtt_message(const char *data, int data_len)
+/* Compact snapshot for {"type":"diag"}; summaries are [min,avg,p99,max] */
+static void publish_diag(void)
 {
-    /* Debounce check */
-    int64_t now = esp_timer_get_time() / 1000; /* Convert to ms */
-    if (now - last_animation_time < ANIMATION_DEBOUNCE_MS)
+    perf_snapshot_t perf;
+    round_panel_stats_t flush;
+    mqtt_tls_stats_t tls;
+    sale_batch_stats_t sales;
+    led_fx_stats_t led;
+    sales_total_stats_t totals;
+    idle_power_stats_t power;
+    char json[1280];
+
+    perf_monitor_snapshot(&perf);
+    round_panel_get_stats(&flush);
+    mqtt_tls_get_stats(&tls);
+    sale_batch_get_stats(&sales);
+    led_fx_get_stats(&led);
+    sales_total_get_stats(&totals);
+    idle_power_get_stats(&power);
+
+#define SUMMARY(s) (unsigned long)(s).min, (unsigned long)(s).avg, (unsigned long)(s).p99, (unsigned long)(s).max
+    int len = snprintf(json, sizeof(json),
+                       "{\"type\":\"diag\",\"uptime_s\":%lu,\"heap\":%lu,\"heap_min\":%lu,"
+                       "\"frames\":%lu,\"window\":%lu,\"fps\":%lu,"
+                       "\"render_ms\":[%lu,%lu,%lu,%lu],\"flush_us\":[%lu,%lu,%lu,%lu],"
+                       "\"spi_bytes\":[%lu,%lu,%lu,%lu],"
+                       "\"spi\":{\"sent\":%llu,\"skipped\":%llu,\"flushes\":%lu,\"bounce_waits\":%lu},"
+                       "\"tls\":{\"handshakes\":%lu,\"resumes\":%lu,\"failures\":%lu,\"last_ms\":%lu},"
+                       "\"sales\":{\"received\":%lu,\"merged\":%lu,\"batches\":%lu,\"held\":%lu,\"dups\":%lu,\"filtered\":%lu},"
+                       "\"conn_updates\":{\"published\":%lu,\"coalesced\":%lu},"
+                       "\"led\":{\"posted\":%lu,\"collapsed\":%lu,\"dropped\":%lu,\"refreshes\":%lu},"
+                       "\"totals\":{\"sales\":%lu,\"pending\":%lu,\"commits\":%lu,\"errors\":%lu,"
+                       "\"bytes\":%lu,\"commit_us\":[%lu,%lu],\"rtc_restored\":%s},"
+                       "\"idle\":{\"entries\":%lu,\"wakes\":%lu,\"idle_s\":%lu,"
+                       "\"wake_frame_us\":[%lu,%lu],\"measured\":%lu,\"errors\":%lu}}",
+                       (unsigned long)(esp_timer_get_time() / 1000000),
+                       (unsigned long)esp_get_free_heap_size(), (unsigned long)esp_get_minimum_free_heap_size(),
+                       (unsigned long)perf.frames, (unsigned long)perf.samples, (unsigned long)perf.fps,
+                       SUMMARY(perf.render_ms), SUMMARY(perf.flush_us), SUMMARY(perf.spi_bytes),
+                       (unsigned long long)flush.bytes_sent, (unsigned long long)flush.bytes_skipped,
+                       (unsigned long)flush.flushes, (unsigned long)flush.bounce_waits,
+                       (unsigned long)tls.handshakes, (unsigned long)tls.resume_attempts,
+                       (unsigned long)tls.failures, (unsigned long)tls.last_ms,
+                       (unsigned long)sales.received, (unsigned long)sales.merged, (unsigned long)sales.batches,
+                       (unsigned long)sales.held, (unsigned long)mqtt_dedup.duplicates, (unsigned long)mqtt_filtered,
+                       (unsigned long)conn_state_published, (unsigned long)conn_state_coalesced,
+                       (unsigned long)led.posted, (unsigned long)led.collapsed, (unsigned long)led.dropped,
+                       (unsigned long)led.refreshes,
+                       (unsigned long)totals.sales, (unsigned long)totals.pending, (unsigned long)totals.commits,
+                       (unsigned long)totals.commit_errors, (unsigned long)totals.bytes_written,
+                       (unsigned long)totals.last_commit_us, (unsigned long)totals.max_commit_us,
+                       totals.rtc_restored ? "true" : "false",
+                       (unsigned long)power.entries, (unsigned long)power.wakes,
+                       (unsigned long)(power.idle_ms / 1000), (unsigned long)power.wake_frame_us_last,
+                       (unsigned long)power.wake_frame_us_max, (unsigned long)power.wake_frames,
+                       (unsigned long)power.pm_errors);
+#undef SUMMARY
+
+    if (len < 0 || len >= (int)sizeof(json))
     {
-        ESP_LOGW(TAG, "Debouncing: ignoring message within %d ms", ANIMATION_DEBOUNCE_MS);
+        ESP_LOGW(TAG, "Diag snapshot truncated");
         return;
     }
+    int msg_id = esp_mqtt_client_publish(mqtt_client, telemetry_topic, json, len, 0, 0);
+    ESP_LOGI(TAG, "Published diag to %s (%d bytes), msg_id=%d", telemetry_topic, len, msg_id);
+}
+
+static uint32_t latency_reported = 0; /* Traces covered by the last latency report */
 
-    /* Copy to null-terminated buffer */
-    char *json_str = malloc(data_len + 1);
-    if (!json_str)
+/* MQTT or service task. Queued rather than published: the network send is
+ * left to the MQTT task, though the enqueue still waits for its lock */
+static void publish_latency(void)
+{
+    char json[1024];
+    size_t len = sale_trace_format_json(json, sizeof(json));
+    if (len == 0)
     {
-        ESP_LOGE(TAG, "Failed to allocate memory for JSON");
+        ESP_LOGW(TAG, "Latency report truncated");
         return;
     }
-    memcpy(json_str, data, data_len);
-    json_str[data_len] = '\0';
+    latency_reported = sale_trace_completed();
+    int msg_id = esp_mqtt_client_enqueue(mqtt_client, telemetry_topic, json, len, 0, 0, true);
+    ESP_LOGI(TAG, "Queued latency report (%u bytes, %lu traces), msg_id=%d",
+             (unsigned)len, (unsigned long)latency_reported, msg_id);
+}
 
-    ESP_LOGI(TAG, "Received message: %s", json_str);
+/* Service task */
+static void publish_latency_if_new(void)
+{
+    if (conn_state_get() == CONN_STATE_MQTT_CONNECTED && sale_trace_completed() != latency_reported)
+    {
+        publish_latency();
+    }
+}
 
-    sale_event_t event = {0};
-    bool trigger = false;
+/* esp_timer task: never waits on the MQTT client */
+static void latency_report_cb(void *arg)
+{
+    service_notify(SERVICE_LATENCY_REPORT);
+}
 
-    /* Parse JSON */
-    cJSON *root = cJSON_Parse(json_str);
-    if (root)
+/* ============================================================================
+ * MQTT SUBSCRIPTIONS
+ * ============================================================================ */
+static void mqtt_subscribe_all(void)
+{
+    esp_mqtt_topic_t topics[MQTT_SUBS_MAX];
+    for (int i = 0; i < mqtt_sub_count; i++)
     {
-        cJSON *type = cJSON_GetObjectItem(root, "type");
-        cJSON *status = cJSON_GetObjectItem(root, "status");
-        cJSON *amount = cJSON_GetObjectItem(root, "amount");
-        cJSON *currency = cJSON_GetObjectItem(root, "currency");
-        cJSON *event_id = cJSON_GetObjectItem(root, "eventId");
+        topics[i] = (esp_mqtt_topic_t){.filter = mqtt_subs[i].filter, .qos = MQTT_CMD_QOS};
+        ESP_LOGI(TAG, "Subscribe %s (%s, %s)", mqtt_subs[i].filter, topic_scope_name(mqtt_subs[i].scope),
+                 mqtt_subs[i].binary ? "binary" : "JSON");
+    }
+    int msg_id = esp_mqtt_client_subscribe_multiple(mqtt_client, topics, mqtt_sub_count);
+    ESP_LOGI(TAG, "Subscribing to %d topics, msg_id=%d", mqtt_sub_count, msg_id);
+}
 
-        /* Check for sale with succeeded status */
-        if (cJSON_IsString(type) && strcmp(type->valuestring, "sale") == 0)
+static const mqtt_sub_t *mqtt_find_sub(const char *topic, int len)
+{
+    for (int i = 0; i < mqtt_sub_count; i++)
+    {
+        if ((size_t)len == strlen(mqtt_subs[i].filter) && memcmp(topic, mqtt_subs[i].filter, len) == 0)
         {
-            if (!status || !cJSON_IsString(status) ||
-                strcmp(status->valuestring, "succeeded") == 0)
-            {
-                trigger = true;
+            return &mqtt_subs[i];
+        }
+    }
+    return NULL;
+}
 
-                if (cJSON_IsNumber(amount))
-                {
-                    event.amount = (int32_t)amount->valuedouble;
-                }
-                if (cJSON_IsString(currency))
-                {
-                    strncpy(event.currency, currency->valuestring, sizeof(event.currency) - 1);
-                }
-                if (cJSON_IsString(event_id))
-                {
-                    strncpy(event.event_id, event_id->valuestring, sizeof(event.event_id) - 1);
-                }
+/* {"type":"topics", ...}: apply, persist, resubscribe, and report the result */
+static void handle_topics_command(const char *data, int data_len)
+{
+    topic_config_t next = topics_cfg;
+    bool valid = topic_config_apply_json(&next, data, data_len);
+
+    if (valid && memcmp(&next, &topics_cfg, sizeof(next)) != 0)
+    {
+        /* Leave group/fleet topics the new set no longer has */
+        for (int i = 0; i < mqtt_sub_count; i++)
+        {
+            char topic[TOPIC_MAX_LEN];
+            const mqtt_sub_t *sub = &mqtt_subs[i];
+            if (!topic_config_topic(&next, sub->scope, device_id, sub->binary, topic, sizeof(topic)) ||
+                strcmp(topic, sub->filter) != 0)
+            {
+                esp_mqtt_client_unsubscribe(mqtt_client, sub->filter);
+                ESP_LOGI(TAG, "Unsubscribing from %s", sub->filter);
             }
         }
 
-        cJSON_Delete(root);
+        topics_cfg = next;
+        topic_config_save(NVS_NAMESPACE, &topics_cfg);
+        build_subscriptions();
+        mqtt_msg_sub = NULL;
+        mqtt_subscribe_all();
     }
-    else
+
+    char json[320];
+    int len = valid ? topic_config_format(&topics_cfg, json, sizeof(json))
+                    : snprintf(json, sizeof(json), "{\"type\":\"topics\",\"error\":\"invalid\"}");
+    if (len > 0)
+    {
+        esp_mqtt_client_publish(mqtt_client, telemetry_topic, json, len, 0, 0);
+    }
+}
+
+/* Runs on the OTA task; queued so it never waits on the MQTT task */
+static void publish_ota_status(const ota_status_t *status)
+{
+    char json[256];
+    int len = ota_update_format(status, json, sizeof(json));
+    if (len > 0 && mqtt_client)
     {
-        ESP_LOGW(TAG, "JSON parse failed, triggering animation anyway (MVP tolerance)");
-        trigger = true; /* MVP: trigger even on parse failure */
+        esp_mqtt_client_enqueue(mqtt_client, telemetry_topic, json, len, 0, 0, true);
     }
+}
 
-    free(json_str);
+/* {"type":"ota","url":...}: start a background update; without a url, report progress */
+static void handle_ota_command(const char *data, int data_len)
+{
+    esp_err_t err = ota_update_start_json(data, data_len);
+    if (err == ESP_OK)
+    {
+        return; /* The OTA task reports from here on */
+    }
 
-    if (trigger)
+    ota_status_t status;
+    ota_update_get_status(&status);
+    if (err != ESP_ERR_NOT_FOUND)
     {
-        last_animation_time = now;
-        /* Queue animation event */
-        xQueueSend(animation_queue, &event, 0);
+        status.error = err; /* Why this request was refused */
+    }
+    publish_ota_status(&status);
+}
+
+/* ============================================================================
+ * MQTT MESSAGE HANDLING
+ * ============================================================================ */
+static void handle_mqtt_message(const char *data, int data_len, const mqtt_sub_t *sub)
+{
+    sale_event_t event;
+    switch (sale_router_handle(&mqtt_router, data, data_len, sub->scope, sub->binary, &event))
+    {
+    case SALE_ROUTE_FILTERED:
+        mqtt_filtered++;
+        break;
+    case SALE_ROUTE_COMMAND:
+        if (strcmp(event.type, "diag") == 0)
+        {
+            publish_diag();
+            publish_latency();
+        }
+        else if (strcmp(event.type, "topics") == 0 && !sub->binary)
+        {
+            handle_topics_command(data, data_len);
+        }
+        else if (strcmp(event.type, "ota") == 0 && !sub->binary)
+        {
+            handle_ota_command(data, data_len);
+        }
+#if CONFIG_MONEYBOT_BENCH
+        else if (strcmp(event.type, "bench") == 0 && !sub->binary)
+        {
+            bench_start();
+        }
+#endif
+        break;
+    default:
+        break; /* Queued, or logged and dropped */
     }
 }
 
@@ -1507,13 +2616,36 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
 
     switch ((esp_mqtt_event_id_t)event_id)
     {
+    case MQTT_EVENT_BEFORE_CONNECT:
+        connect_jitter_begin();
+        break;
+
     case MQTT_EVENT_CONNECTED:
-        ESP_LOGI(TAG, "MQTT connected to AWS IoT Core");
+        ESP_LOGI(TAG, "MQTT connected to AWS IoT Core (session %s)",
+                 event->session_present ? "resumed" : "new");
+        connect_jitter_end("connected");
         update_connection_indicator(CONN_STATE_MQTT_CONNECTED);
+        boot_phase_end(BOOT_PHASE_MQTT_CONNECT, BOOT_MQTT_CONNECTED_BIT);
+        ota_update_confirm(); /* A freshly updated image has proven itself */
+
+        if (event->session_present)
+        {
+            /* Sales queued while we were away arrive back to back; let them
+             * merge into one celebration instead of one each */
+            sale_batch_hold(MQTT_REPLAY_SETTLE_MS);
+        }
 
-        /* Subscribe to command topic */
-        int msg_id = esp_mqtt_client_subscribe(mqtt_client, cmd_topic, 0);
-        ESP_LOGI(TAG, "Subscribing to %s, msg_id=%d", cmd_topic, msg_id);
+        /* A resumed session already has the subscriptions, but
+         * re-subscribing is harmless and covers an expired one */
+        mqtt_subscribe_all();
+
+#if CONFIG_MONEYBOT_BENCH_AT_BOOT
+        if (!bench_boot_done)
+        {
+            bench_boot_done = true;
+            bench_start();
+        }
+#endif
         break;
 
     case MQTT_EVENT_DISCONNECTED:
@@ -1535,12 +2667,45 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
         break;
 
     case MQTT_EVENT_DATA:
-        ESP_LOGI(TAG, "MQTT data received on topic: %.*s", event->topic_len, event->topic);
-        handle_mqtt_message(event->data, event->data_len);
+    {
+        /* Tick, clocks and backlight come back before the message is parsed */
+        idle_power_kick();
+
+        /* Only the first fragment of a message carries the topic */
+        if (event->topic_len > 0)
+        {
+            ESP_LOGI(TAG, "MQTT data received on topic: %.*s", event->topic_len, event->topic);
+            mqtt_msg_sub = mqtt_find_sub(event->topic, event->topic_len);
+        }
+
+        const char *msg;
+        size_t msg_len;
+        switch (sale_reassembly_feed(&mqtt_reassembly, event->data, event->data_len,
+                                     event->current_data_offset, event->total_data_len,
+                                     &msg, &msg_len))
+        {
+        case SALE_FRAG_COMPLETE:
+            if (mqtt_msg_sub)
+            {
+                handle_mqtt_message(msg, (int)msg_len, mqtt_msg_sub);
+            }
+            break;
+        case SALE_FRAG_OVERSIZE:
+            ESP_LOGW(TAG, "Dropping %d byte message (max %d)", event->total_data_len, SALE_MSG_MAX_LEN);
+            break;
+        case SALE_FRAG_DROPPED:
+            ESP_LOGD(TAG, "Dropped fragment at offset %d", event->current_data_offset);
+            break;
+        case SALE_FRAG_PENDING:
+        default:
+            break;
+        }
         break;
+    }
 
     case MQTT_EVENT_ERROR:
         ESP_LOGE(TAG, "MQTT error type: %d", event->error_handle->error_type);
+        connect_jitter_end("failed");
         if (event->error_handle->error_type == MQTT_ERROR_TYPE_TCP_TRANSPORT)
         {
             ESP_LOGE(TAG, "TCP transport error - errno: %d (%s)",
@@ -1568,9 +2733,10 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
     }
 }
 
-static void mqtt_start(void)
+/* Validate certificates and build the client; needs no network */
+static bool mqtt_prepare(void)
 {
-    ESP_LOGI(TAG, "Starting MQTT client...");
+    ESP_LOGI(TAG, "Preparing MQTT client...");
     ESP_LOGI(TAG, "  Endpoint: %s", AWS_IOT_ENDPOINT);
     ESP_LOGI(TAG, "  Client ID: %s", device_id);
 
@@ -1586,32 +2752,43 @@ static void mqtt_start(void)
     {
         ESP_LOGE(TAG, "Certificate files appear to be missing or too small!");
         ESP_LOGE(TAG, "Check that certs/ folder contains valid PEM files.");
-        return;
+        return false;
     }
 
-    update_connection_indicator(CONN_STATE_MQTT_CONNECTING);
+    /* mTLS is handled by our own transport so the TLS session can be
+     * resumed on reconnect instead of repeating the full handshake */
+    mqtt_tls_config_t tls_cfg = {
+        .ca_cert = (const char *)server_cert_pem_start,
+        .client_cert = (const char *)client_cert_pem_start,
+        .client_key = (const char *)client_key_pem_start,
+    };
+    esp_transport_handle_t transport = mqtt_tls_transport_create(&tls_cfg);
+    if (!transport)
+    {
+        ESP_LOGE(TAG, "Failed to create MQTT TLS transport");
+        return false;
+    }
 
     esp_mqtt_client_config_t mqtt_cfg = {
         .broker = {
             .address = {
                 .uri = MQTT_BROKER_URI,
             },
-            .verification = {
-                .certificate = (const char *)server_cert_pem_start,
-            },
         },
         .credentials = {
             .client_id = device_id,
-            .authentication = {
-                .certificate = (const char *)client_cert_pem_start,
-                .key = (const char *)client_key_pem_start,
-            },
         },
         .session = {
             .keepalive = 60,
+            .disable_clean_session = true, /* Keep subscriptions and queued QoS 1 sales across reconnects */
         },
         .network = {
             .reconnect_timeout_ms = 5000,
+            .transport = transport,
+        },
+        .task = {
+            .priority = TASK_MQTT_PRIORITY,
+            .stack_size = TASK_MQTT_STACK,
         },
     };
 
@@ -1619,12 +2796,436 @@ static void mqtt_start(void)
     if (!mqtt_client)
     {
         ESP_LOGE(TAG, "Failed to initialize MQTT client");
-        return;
+        esp_transport_destroy(transport);
+        return false;
     }
 
     ESP_ERROR_CHECK(esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID,
                                                    mqtt_event_handler, NULL));
+    return true;
+}
+
+static void mqtt_start(void)
+{
+    ESP_LOGI(TAG, "Starting MQTT client...");
+    update_connection_indicator(CONN_STATE_MQTT_CONNECTING);
     ESP_ERROR_CHECK(esp_mqtt_client_start(mqtt_client));
+
+    const esp_timer_create_args_t report_args = {
+        .callback = latency_report_cb,
+        .name = "latency_report",
+    };
+    esp_timer_handle_t report_timer;
+    ESP_ERROR_CHECK(esp_timer_create(&report_args, &report_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(report_timer, (uint64_t)LATENCY_REPORT_INTERVAL_S * 1000000));
+}
+
+#if CONFIG_MONEYBOT_BENCH
+/* ============================================================================
+ * BENCHMARKS
+ * ============================================================================ */
+#define BENCH_RUNS CONFIG_MONEYBOT_BENCH_RUNS
+#define BENCH_QR_GEN_RUNS 4       /* Reed-Solomon encoding takes milliseconds */
+#define BENCH_LED_RUNS 32
+#define BENCH_LED_TIMEOUT_MS 50   /* A refresh that takes longer is not counted */
+#define BENCH_RAIN_AMOUNT 5000    /* A typical $50 sale */
+#define BENCH_RAIN_MAX_MS 8000    /* Longest rain the frame case waits out */
+#define BENCH_JSON_MAX 2048
+
+typedef struct
+{
+    bench_report_t report;
+    sale_dedup_t dedup; /* mqtt_dedup before the message cases */
+    char payload[SALE_MSG_MAX_LEN];
+    char json[BENCH_JSON_MAX];
+} bench_ctx_t;
+
+static TaskHandle_t bench_task_handle = NULL;
+static SemaphoreHandle_t bench_messages_done = NULL;
+static volatile bool bench_frame_seen = false;
+
+/* handle_mqtt_message() end to end, without the batch hand-off. The MQTT
+ * task waits in bench_start() meanwhile, so no real message interleaves,
+ * and the dedup ring and counters are put back afterwards. */
+static void bench_messages(bench_ctx_t *ctx)
+{
+    static const mqtt_sub_t own = {.filter = "bench", .scope = TOPIC_SCOPE_DEVICE};
+    static const mqtt_sub_t own_bin = {.filter = "bench", .scope = TOPIC_SCOPE_DEVICE, .binary = true};
+    static const mqtt_sub_t fleet = {.filter = "bench", .scope = TOPIC_SCOPE_FLEET};
+    static const char dup[] = "{\"type\":\"sale\",\"status\":\"succeeded\",\"amount\":5000,\"currency\":\"usd\","
+                              "\"eventId\":\"evt_bench_dup\"}";
+    static const char pending[] = "{\"type\":\"sale\",\"status\":\"pending\",\"amount\":5000,\"currency\":\"usd\","
+                                  "\"eventId\":\"evt_bench_pending\"}";
+    static const char malformed[] = "sale: 50.00 USD";
+
+    ctx->dedup = mqtt_dedup;
+    uint32_t filtered = mqtt_filtered;
+    esp_log_level_t log_level = esp_log_level_get(TAG);
+    esp_log_level_t router_log_level = esp_log_level_get(SALE_ROUTER_TAG);
+    esp_log_level_set(TAG, ESP_LOG_ERROR); /* UART logging would dominate every run */
+    esp_log_level_set(SALE_ROUTER_TAG, ESP_LOG_ERROR);
+    mqtt_router.dry_run = true;
+
+    /* A new sale each run: parse, filter, dedup miss */
+    bench_case_t *c = bench_case_begin(&ctx->report, "msg_sale");
+    for (uint32_t i = 0; i < BENCH_RUNS; i++)
+    {
+        int len = snprintf(ctx->payload, sizeof(ctx->payload),
+                           "{\"type\":\"sale\",\"status\":\"succeeded\",\"amount\":5000,\"currency\":\"usd\","
+                           "\"eventId\":\"evt_bench_%08lx\",\"ts\":1760000000000}",
+                           (unsigned long)i);
+        uint32_t start = bench_cycles();
+        handle_mqtt_message(ctx->payload, len, &own);
+        bench_case_sample(c, start);
+    }
+    bench_case_end(c);
+
+    /* The same record as a binary sale, a new eventId hash each run */
+    uint8_t record[SALE_BIN_LEN] = {SALE_BIN_VERSION, SALE_BIN_TYPE_SALE, SALE_BIN_STATUS_SUCCEEDED, 0,
+                                    0x88, 0x13, 0, 0, 'u', 's', 'd'};
+    c = bench_case_begin(&ctx->report, "msg_binary");
+    for (uint32_t i = 0; i < BENCH_RUNS; i++)
+    {
+        uint64_t hash = 0xbe4c000000000000ULL | i;
+        memcpy(record + 12, &hash, sizeof(hash)); /* Little-endian, like the wire format */
+        uint32_t start = bench_cycles();
+        handle_mqtt_message((const char *)record, sizeof(record), &own_bin);
+        bench_case_sample(c, start);
+    }
+    bench_case_end(c);
+
+    /* Redeliveries: parse, then a dedup hit */
+    handle_mqtt_message(dup, sizeof(dup) - 1, &own);
+    c = bench_case_begin(&ctx->report, "msg_duplicate");
+    for (uint32_t i = 0; i < BENCH_RUNS; i++)
+    {
+        uint32_t start = bench_cycles();
+        handle_mqtt_message(dup, sizeof(dup) - 1, &own);
+        bench_case_sample(c, start);
+    }
+    bench_case_end(c);
+
+    c = bench_case_begin(&ctx->report, "msg_ignored");
+    for (uint32_t i = 0; i < BENCH_RUNS; i++)
+    {
+        uint32_t start = bench_cycles();
+        handle_mqtt_message(pending, sizeof(pending) - 1, &own);
+        bench_case_sample(c, start);
+    }
+    bench_case_end(c);
+
+    /* Garbage on a shared topic is dropped, not celebrated */
+    c = bench_case_begin(&ctx->report, "msg_malformed");
+    for (uint32_t i = 0; i < BENCH_RUNS; i++)
+    {
+        uint32_t start = bench_cycles();
+        handle_mqtt_message(malformed, sizeof(malformed) - 1, &fleet);
+        bench_case_sample(c, start);
+    }
+    bench_case_end(c);
+
+    mqtt_router.dry_run = false;
+    esp_log_level_set(SALE_ROUTER_TAG, router_log_level);
+    esp_log_level_set(TAG, log_level);
+    mqtt_filtered = filtered;
+    mqtt_dedup = ctx->dedup;
+}
+
+/* Captive-portal form decoding, on an SSID as browsers post it */
+static void bench_decoders(bench_ctx_t *ctx)
+{
+    static const char form[] = "Caf%C3%A9+%26+Bar+%F0%9F%92%B0+%26%2336%3B5+coffee+%28guest%29";
+    static const char entities[] = "Caf&#233; &amp; Bar &#x1F4B0; &#36;5 coffee (guest)";
+    char out[128];
+
+    bench_case_t *c = bench_case_begin(&ctx->report, "url_decode");
+    for (uint32_t i = 0; i < BENCH_RUNS; i++)
+    {
+        uint32_t start = bench_cycles();
+        url_decode(out, form, sizeof(out));
+        bench_case_sample(c, start);
+        bench_keep(out);
+    }
+    bench_case_end(c);
+
+    c = bench_case_begin(&ctx->report, "html_entity_decode");
+    for (uint32_t i = 0; i < BENCH_RUNS; i++)
+    {
+        uint32_t start = bench_cycles();
+        html_entity_decode(out, entities, sizeof(out));
+        bench_case_sample(c, start);
+        bench_keep(out);
+    }
+    bench_case_end(c);
+}
+
+/* QR encoding and the module blit into a canvas buffer placed as the
+ * provisioning screen places it; the NVS cache is left alone */
+static void bench_qr(bench_ctx_t *ctx)
+{
+    if (provisioning_mode)
+    {
+        ESP_LOGW(TAG, "Bench: provisioning screen up, QR cases skipped");
+        return;
+    }
+
+    size_t buf_bytes = LV_CANVAS_BUF_SIZE_TRUE_COLOR(QR_CANVAS_SIZE, QR_CANVAS_SIZE);
+    lv_color_t *buf = heap_caps_malloc(buf_bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (buf == NULL)
+    {
+        buf = heap_caps_malloc(buf_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    qr_bitmap_t *bmp = calloc(1, sizeof(*bmp));
+    if (buf == NULL || bmp == NULL)
+    {
+        ESP_LOGW(TAG, "Bench: no memory for the QR cases");
+        free(buf);
+        free(bmp);
+        return;
+    }
+
+    esp_qrcode_config_t qr_cfg = {
+        .display_func = qr_capture_modules,
+        .max_qrcode_version = 10,
+        .qrcode_ecc_level = ESP_QRCODE_ECC_LOW,
+    };
+    bench_case_t *c = bench_case_begin(&ctx->report, "qr_generate");
+    qr_capture = bmp;
+    for (uint32_t i = 0; i < BENCH_QR_GEN_RUNS; i++)
+    {
+        uint32_t start = bench_cycles();
+        esp_qrcode_generate(&qr_cfg, "WIFI:T:nopass;S:" PROV_SERVICE_NAME_PREFIX "A1B2;P:;;");
+        bench_case_sample(c, start);
+    }
+    qr_capture = NULL;
+    bench_case_end(c);
+
+    if (bmp->size > 0)
+    {
+        c = bench_case_begin(&ctx->report, "qr_blit");
+        for (uint32_t i = 0; i < BENCH_RUNS; i++)
+        {
+            uint32_t start = bench_cycles();
+            qr_bitmap_blit(bmp, buf, QR_CANVAS_SIZE);
+            bench_case_sample(c, start);
+            bench_keep(buf);
+        }
+        bench_case_end(c);
+    }
+
+    free(bmp);
+    free(buf);
+}
+
+static void bench_frame_cb(void *arg)
+{
+    bench_frame_seen = true;
+}
+
+/* One money rain from start_rain() until the last coin lands. Each
+ * lv_timer_handler() run takes the port lock on its own and only the call
+ * is timed, so the LVGL task and other lock users carry on in between;
+ * frames they render are simply not sampled. Frame cycles include waiting
+ * for the previous flush. */
+static void bench_rain(bench_ctx_t *ctx)
+{
+    lvgl_port_lock(0);
+    if (main_screen == NULL || lv_scr_act() != main_screen || celebration.running)
+    {
+        lvgl_port_unlock();
+        ESP_LOGW(TAG, "Bench: face busy or not shown, rain cases skipped");
+        return;
+    }
+
+    bench_case_t *c = bench_case_begin(&ctx->report, "rain_start");
+    uint32_t start = bench_cycles();
+    start_rain(BENCH_RAIN_AMOUNT);
+    bench_case_sample(c, start);
+    bench_case_end(c); /* The heap delta is the coins in flight */
+    lvgl_port_unlock();
+
+    c = bench_case_begin(&ctx->report, "rain_frame");
+    int64_t deadline = esp_timer_get_time() + (int64_t)BENCH_RAIN_MAX_MS * 1000;
+    while (esp_timer_get_time() < deadline)
+    {
+        lvgl_port_lock(0);
+        if (coin_rain_active() == 0)
+        {
+            lvgl_port_unlock();
+            break;
+        }
+        bench_frame_seen = false;
+        perf_monitor_on_next_frame(bench_frame_cb, NULL);
+        start = bench_cycles();
+        uint32_t wait_ms = lv_timer_handler();
+        if (bench_frame_seen)
+        {
+            bench_case_sample(c, start);
+        }
+        perf_monitor_on_next_frame(NULL, NULL); /* Not for a frame the LVGL task renders */
+        lvgl_port_unlock();
+        vTaskDelay(pdMS_TO_TICKS(wait_ms < LV_DISP_DEF_REFR_PERIOD ? wait_ms : LV_DISP_DEF_REFR_PERIOD) + 1);
+    }
+    bench_case_end(c);
+
+    lvgl_port_lock(0);
+    if (!celebration.running)
+    {
+        hide_tokens(); /* A sale that came in meanwhile keeps its rain */
+    }
+    lvgl_port_unlock();
+}
+
+/* Cost of posting an LED command, and the time until the LED task has
+ * pushed it out over RMT */
+static void bench_led(bench_ctx_t *ctx)
+{
+    bench_case_t *post = bench_case_begin(&ctx->report, "led_post");
+    bench_case_t *refresh = bench_case_begin(&ctx->report, "led_refresh");
+    for (uint32_t i = 0; i < BENCH_LED_RUNS; i++)
+    {
+        /* Alternate colors: an unchanged color is not refreshed */
+        const led_fx_t fx = {.type = LED_FX_SOLID, .color = {(i & 1) ? 255 : 0, 0, (i & 1) ? 0 : 255}};
+        led_fx_stats_t before, now;
+        led_fx_get_stats(&before);
+
+        uint32_t start = bench_cycles();
+        led_fx_play(&fx);
+        bench_case_sample(post, start);
+
+        int64_t deadline = esp_timer_get_time() + BENCH_LED_TIMEOUT_MS * 1000;
+        do
+        {
+            led_fx_get_stats(&now);
+        } while (now.refreshes == before.refreshes && esp_timer_get_time() < deadline);
+        if (now.refreshes != before.refreshes)
+        {
+            bench_case_sample(refresh, start);
+        }
+    }
+    bench_case_end(post);
+    bench_case_end(refresh);
+    led_fx_stop(); /* Back to the connection color */
+}
+
+static void bench_task(void *pvParameters)
+{
+    bench_ctx_t *ctx = pvParameters;
+
+    bench_report_init(&ctx->report, LCD_PCLK_HZ);
+    bench_messages(ctx);
+    xSemaphoreGive(bench_messages_done); /* The MQTT task carries on */
+    bench_decoders(ctx);
+    bench_qr(ctx);
+    bench_rain(ctx);
+    bench_led(ctx);
+
+    size_t len = bench_format_json(&ctx->report, ctx->json, sizeof(ctx->json));
+    if (len == 0)
+    {
+        ESP_LOGW(TAG, "Bench report truncated");
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Bench: %s", ctx->json);
+        if (conn_state_get() == CONN_STATE_MQTT_CONNECTED)
+        {
+            esp_mqtt_client_enqueue(mqtt_client, telemetry_topic, ctx->json, len, 0, 0, true);
+        }
+    }
+
+    free(ctx);
+    bench_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+/* Called on the MQTT task; returns once the message cases are done, the
+ * rest runs in the background */
+static void bench_start(void)
+{
+    idle_power_kick(); /* The rain case needs LVGL running */
+    if (bench_task_handle != NULL)
+    {
+        ESP_LOGW(TAG, "Benchmarks already running");
+        return;
+    }
+    if (bench_messages_done == NULL)
+    {
+        bench_messages_done = xSemaphoreCreateBinary();
+    }
+    bench_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    if (ctx == NULL || bench_messages_done == NULL)
+    {
+        ESP_LOGE(TAG, "No memory for benchmarks");
+        free(ctx);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Starting benchmarks on core %d (%d runs per case)", TASK_BENCH_CORE, BENCH_RUNS);
+    if (xTaskCreatePinnedToCore(bench_task, "bench", TASK_BENCH_STACK, ctx, TASK_BENCH_PRIORITY,
+                                &bench_task_handle, TASK_BENCH_CORE) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to start the benchmark task");
+        bench_task_handle = NULL;
+        free(ctx);
+        return;
+    }
+    xSemaphoreTake(bench_messages_done, portMAX_DELAY);
+}
+#endif /* CONFIG_MONEYBOT_BENCH */
+
+/* ============================================================================
+ * IDLE POWER
+ * ============================================================================ */
+/* LVGL task: whatever must keep the face lit and the CPU at full clock */
+static bool power_busy(void)
+{
+    ota_status_t ota;
+    ota_update_get_status(&ota);
+    return celebration.running || coin_rain_active() > 0 || lv_scr_act() != main_screen || provisioning_mode ||
+           ota.state == OTA_STATE_DOWNLOADING || ota.state == OTA_STATE_VERIFYING
+#if CONFIG_MONEYBOT_BENCH
+           || bench_task_handle != NULL
+#endif
+        ;
+}
+
+/* Idle, the modem sleeps through WIFI_LISTEN_INTERVAL beacons, far inside
+ * the MQTT keepalive; awake it wakes every DTIM so sales and OTA traffic
+ * are not held back. Fails harmlessly before Wi-Fi is up. */
+static void power_mode_changed(bool idle)
+{
+    esp_wifi_set_ps(idle ? WIFI_PS_MAX_MODEM : WIFI_PS_MIN_MODEM);
+}
+
+/* LVGL lock held, once the display is registered */
+static void power_start(void)
+{
+    const idle_power_config_t power_cfg = {
+        .disp = disp,
+        .idle_after_ms = IDLE_AFTER_MS,
+        .poll_ms = IDLE_WAKE_MS,
+        .busy = power_busy,
+        .housekeeping = update_total_label, /* The day rolling over */
+        .on_change = power_mode_changed,
+        .backlight_gpio = LCD_BLK,
+        .backlight_pct = CONFIG_MONEYBOT_BACKLIGHT_PCT,
+        .backlight_idle_pct = CONFIG_MONEYBOT_BACKLIGHT_IDLE_PCT,
+#if CONFIG_PM_ENABLE
+        .cpu_min_mhz = CONFIG_MONEYBOT_PM_MIN_FREQ_MHZ,
+#if CONFIG_MONEYBOT_PM_LIGHT_SLEEP
+        .light_sleep = true,
+#endif
+#endif
+    };
+    esp_err_t err = idle_power_init(&power_cfg);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Idle power mode unavailable (%s), backlight stays on", esp_err_to_name(err));
+        gpio_config_t bk_cfg = {.mode = GPIO_MODE_OUTPUT, .pin_bit_mask = 1ULL << LCD_BLK};
+        gpio_config(&bk_cfg);
+        gpio_set_level(LCD_BLK, 1);
+    }
 }
 
 /* ============================================================================
@@ -1632,15 +3233,93 @@ static void mqtt_start(void)
  * ============================================================================ */
 static void animation_task(void *pvParameters)
 {
-    sale_event_t event;
+    sale_batch_t batch;
 
     while (1)
     {
-        if (xQueueReceive(animation_queue, &event, portMAX_DELAY) == pdTRUE)
+        /* Sales arriving between takes pile up in the next batch; a running
+         * celebration is extended rather than replayed */
+        if (sale_batch_take(&batch, portMAX_DELAY))
+        {
+            sales_total_add(&batch);
+            trigger_sale_animation(&batch);
+
+            sale_batch_stats_t stats;
+            sale_batch_get_stats(&stats);
+            ESP_LOGI(TAG, "Sales: %lu received, %lu merged, %lu batches (%lu held), %lu without amount",
+                     (unsigned long)stats.received, (unsigned long)stats.merged, (unsigned long)stats.batches,
+                     (unsigned long)stats.held, (unsigned long)stats.currency_overflow);
+        }
+    }
+}
+
+/* ============================================================================
+ * BOOT TASKS
+ * ============================================================================ */
+static void boot_display_task(void *pvParameters)
+{
+    boot_phase_begin(BOOT_PHASE_DISPLAY);
+    init_display();
+    show_main_screen();
+    boot_phase_end(BOOT_PHASE_DISPLAY, BOOT_DISPLAY_READY_BIT);
+    vTaskDelete(NULL);
+}
+
+static void boot_wifi_task(void *pvParameters)
+{
+    boot_phase_begin(BOOT_PHASE_WIFI);
+    /* Connect to WiFi (with provisioning if needed) */
+    if (!wifi_connect())
+    {
+        ESP_LOGE(TAG, "Failed to connect to WiFi!");
+    }
+    boot_phase_end(BOOT_PHASE_WIFI, BOOT_WIFI_READY_BIT);
+    vTaskDelete(NULL);
+}
+
+static void boot_time_task(void *pvParameters)
+{
+    boot_phase_begin(BOOT_PHASE_TIME);
+    time_persist_start();
+
+    /* A restored clock lets TLS start now; SNTP refines it in the background */
+    bool have_time = restore_saved_time();
+    if (have_time)
+    {
+        boot_phase_end(BOOT_PHASE_TIME, BOOT_TIME_READY_BIT);
+    }
+
+    xEventGroupWaitBits(boot_event_group, BOOT_WIFI_READY_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    sntp_start();
+
+    if (!have_time)
+    {
+        /* First boot: SNTP is required for TLS */
+        if (!wait_for_time_sync())
         {
-            trigger_sale_animation(&event);
+            ESP_LOGE(TAG, "Time sync failed after %d attempts - TLS may not work!", SNTP_RETRY_COUNT);
         }
+        boot_phase_end(BOOT_PHASE_TIME, BOOT_TIME_READY_BIT);
+    }
+
+    vTaskDelete(NULL);
+}
+
+static void boot_mqtt_task(void *pvParameters)
+{
+    boot_phase_begin(BOOT_PHASE_MQTT_PREP);
+    bool prepared = mqtt_prepare();
+    boot_phase_end(BOOT_PHASE_MQTT_PREP, BOOT_MQTT_PREPARED_BIT);
+
+    if (prepared)
+    {
+        /* TLS needs both a network and a sane wall clock */
+        xEventGroupWaitBits(boot_event_group, BOOT_WIFI_READY_BIT | BOOT_TIME_READY_BIT,
+                            pdFALSE, pdTRUE, portMAX_DELAY);
+        boot_phase_begin(BOOT_PHASE_MQTT_CONNECT);
+        mqtt_start();
     }
+    vTaskDelete(NULL);
 }
 
 /* ============================================================================
@@ -1659,68 +3338,73 @@ void app_main(void)
     /* Load device identity */
     load_device_id();
 
-    /* Create animation queue */
-    animation_queue = xQueueCreate(5, sizeof(sale_event_t));
+    /* Fonts and portal pages, mapped from flash */
+    assets_init();
 
-    /* Initialize LED */
-    led_strip_config_t led_cfg = {
-        .strip_gpio_num = LED_GPIO,
-        .max_leds = 1,
-        .led_model = LED_MODEL_WS2812,
-        .flags.invert_out = false,
+    /* Report the running slot; a new image stays on trial until MQTT connects */
+    const ota_update_config_t ota_cfg = {
+        .cert_pem = (const char *)server_cert_pem_start,
+        .on_status = publish_ota_status,
+        .core = TASK_CORE_NET,
+        .priority = TASK_OTA_PRIORITY,
+        .stack = TASK_OTA_STACK,
     };
-    led_strip_rmt_config_t rmt_cfg = {
-        .clk_src = RMT_CLK_SRC_DEFAULT,
-        .resolution_hz = 10000000,
-        .mem_block_symbols = 64,
-        .flags.with_dma = false,
-    };
-    ESP_ERROR_CHECK(led_strip_new_rmt_device(&led_cfg, &rmt_cfg, &led));
-    led_strip_clear(led);
-    set_led(50, 0, 0); /* Red = starting up */
+    ESP_ERROR_CHECK(ota_update_init(&ota_cfg));
 
-    /* Initialize display */
-    init_display();
+    /* Pending-sale batch between MQTT and the animation task */
+    sale_batch_init();
 
-    /* Show main screen initially (will switch to provisioning if needed) */
-    show_main_screen();
-    update_connection_indicator(CONN_STATE_DISCONNECTED);
+    /* Today's sales, restored from RTC memory or NVS */
+    const sales_total_config_t totals_cfg = {
+        .nvs_namespace = NVS_NAMESPACE,
+        .core = TASK_CORE_NET,
+        .priority = TASK_TOTALS_PRIORITY,
+        .stack = TASK_TOTALS_STACK,
+    };
+    ESP_ERROR_CHECK(sales_total_init(&totals_cfg));
 
-    /* Connect to WiFi (with provisioning if needed) */
-    if (!wifi_connect())
-    {
-        ESP_LOGE(TAG, "Failed to connect to WiFi!");
-        /* Continue anyway - will keep trying to reconnect */
-    }
+    /* Flash writes and reports the timers hand off */
+    service_start();
 
-    /* Sync time via SNTP (required for TLS) - retry until success */
-    int sntp_attempts = 0;
-    while (!obtain_time() && sntp_attempts < SNTP_RETRY_COUNT)
-    {
-        sntp_attempts++;
-        ESP_LOGW(TAG, "Time sync failed, retrying... (%d/%d)", sntp_attempts, SNTP_RETRY_COUNT);
-        esp_sntp_stop();
-        vTaskDelay(pdMS_TO_TICKS(2000));
-    }
+    /* Status LED service */
+    const led_fx_config_t led_cfg = {
+        .gpio = LED_GPIO,
+        .core = TASK_CORE_UI,
+        .priority = TASK_LED_PRIORITY,
+        .stack = TASK_LED_STACK,
+    };
+    ESP_ERROR_CHECK(led_fx_init(&led_cfg));
+    led_fx_set_base(&conn_state_look[CONN_STATE_DISCONNECTED].led); /* Red = starting up */
+
+    /* Bring up display, Wi-Fi, time and MQTT concurrently; each task waits
+     * only on the phases it actually depends on. */
+    boot_event_group = xEventGroupCreate();
+    xTaskCreatePinnedToCore(boot_display_task, "boot_display", TASK_BOOT_STACK, NULL, TASK_BOOT_PRIORITY, NULL, TASK_CORE_UI);
+    xTaskCreatePinnedToCore(boot_wifi_task, "boot_wifi", TASK_BOOT_STACK, NULL, TASK_BOOT_PRIORITY, NULL, TASK_CORE_NET);
+    xTaskCreatePinnedToCore(boot_time_task, "boot_time", TASK_BOOT_STACK, NULL, TASK_BOOT_PRIORITY, NULL, TASK_CORE_NET);
+    xTaskCreatePinnedToCore(boot_mqtt_task, "boot_mqtt", TASK_BOOT_STACK, NULL, TASK_BOOT_PRIORITY, NULL, TASK_CORE_NET);
+
+    /* Animations only need the display */
+    xEventGroupWaitBits(boot_event_group, BOOT_DISPLAY_READY_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    xTaskCreatePinnedToCore(animation_task, "animation", TASK_ANIM_STACK, NULL, TASK_ANIM_PRIORITY, NULL, TASK_CORE_UI);
+
+    ESP_LOGI(TAG, "Display ready, waiting for network bring-up...");
+    ESP_LOGI(TAG, "Device ID: %s", get_device_id());
 
-    if (sntp_attempts >= SNTP_RETRY_COUNT)
+    EventBits_t bits = xEventGroupWaitBits(boot_event_group, BOOT_ALL_BITS, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(BOOT_REPORT_TIMEOUT_MS));
+    if ((bits & BOOT_ALL_BITS) == BOOT_ALL_BITS)
     {
-        ESP_LOGE(TAG, "Time sync failed after %d attempts - TLS may not work!", SNTP_RETRY_COUNT);
+        ESP_LOGI(TAG, "Setup complete! Waiting for MQTT messages...");
     }
-
-    /* Start MQTT client */
-    mqtt_start();
-
-    /* Create animation task (runs independently from LVGL) */
-    xTaskCreate(animation_task, "animation", 4096, NULL, 5, NULL);
-
-    ESP_LOGI(TAG, "Setup complete! Waiting for MQTT messages...");
-    ESP_LOGI(TAG, "Device ID: %s", get_device_id());
-    ESP_LOGI(TAG, "Subscribed topic: %s", cmd_topic);
-
-    /* Main loop - just handle idle state */
-    while (1)
+    else
     {
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        ESP_LOGW(TAG, "Boot not complete after %d ms (bits 0x%02x)",
+                 BOOT_REPORT_TIMEOUT_MS, (unsigned)bits);
     }
+    boot_report();
+    heap_report("boot complete");
+
+    /* Everything runs in its own task from here; returning deletes only the
+     * main task, which would otherwise wake the CPU every second */
 }
@@ -0,0 +1,296 @@
+/*
+ * MQTT TLS Transport with Session Resumption
+ * esp-tls based transport for esp-mqtt that caches the TLS session so
+ * reconnects can skip the full mTLS handshake
+ */
+
+#include "mqtt_tls.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "lwip/sockets.h"
+#include "sdkconfig.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+
+static const char *TAG = "mqtt_tls";
+
+typedef struct
+{
+    mqtt_tls_config_t cfg;
+    esp_tls_t *tls;
+} mqtt_tls_ctx_t;
+
+/* Only touched from the esp-mqtt task; mqtt_tls_forget_session() just
+ * raises a flag that the next connect honours. */
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+static esp_tls_client_session_t *cached_session = NULL;
+#endif
+static volatile bool forget_pending = false;
+
+static mqtt_tls_stats_t stats;
+static uint64_t full_total_ms, resumed_total_ms;
+static uint32_t full_count, resumed_count;
+
+static int tls_sockfd(mqtt_tls_ctx_t *ctx)
+{
+    int fd = -1;
+    if (ctx->tls == NULL || esp_tls_get_conn_sockfd(ctx->tls, &fd) != ESP_OK)
+    {
+        return -1;
+    }
+    return fd;
+}
+
+static int tls_poll(mqtt_tls_ctx_t *ctx, int timeout_ms, bool for_write)
+{
+    int fd = tls_sockfd(ctx);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    fd_set fds, errfds;
+    FD_ZERO(&fds);
+    FD_ZERO(&errfds);
+    FD_SET(fd, &fds);
+    FD_SET(fd, &errfds);
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+
+    int ret = select(fd + 1, for_write ? NULL : &fds, for_write ? &fds : NULL, &errfds,
+                     timeout_ms < 0 ? NULL : &tv);
+    if (ret > 0 && FD_ISSET(fd, &errfds))
+    {
+        int sock_errno = 0;
+        socklen_t len = sizeof(sock_errno);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &sock_errno, &len);
+        ESP_LOGE(TAG, "Socket error on poll: errno %d", sock_errno);
+        return -1;
+    }
+    return ret;
+}
+
+static int tls_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    mqtt_tls_ctx_t *ctx = esp_transport_get_context_data(t);
+
+    ctx->tls = esp_tls_init();
+    if (ctx->tls == NULL)
+    {
+        return -1;
+    }
+
+    esp_tls_cfg_t cfg = {
+        .cacert_buf = (const unsigned char *)ctx->cfg.ca_cert,
+        .cacert_bytes = strlen(ctx->cfg.ca_cert) + 1,
+        .clientcert_buf = (const unsigned char *)ctx->cfg.client_cert,
+        .clientcert_bytes = strlen(ctx->cfg.client_cert) + 1,
+        .clientkey_buf = (const unsigned char *)ctx->cfg.client_key,
+        .clientkey_bytes = strlen(ctx->cfg.client_key) + 1,
+        .timeout_ms = ctx->cfg.timeout_ms > 0 ? ctx->cfg.timeout_ms : timeout_ms,
+    };
+
+    bool resuming = false;
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    if (forget_pending && cached_session)
+    {
+        esp_tls_free_client_session(cached_session);
+        cached_session = NULL;
+    }
+    forget_pending = false;
+    cfg.client_session = cached_session;
+    resuming = (cached_session != NULL);
+#endif
+
+    int64_t start = esp_timer_get_time();
+    int ret = esp_tls_conn_new_sync(host, strlen(host), port, &cfg, ctx->tls);
+    uint32_t elapsed_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+
+    if (ret != 1)
+    {
+        stats.failures++;
+        ESP_LOGE(TAG, "TLS connect to %s:%d failed after %lu ms%s", host, port,
+                 (unsigned long)elapsed_ms, resuming ? " (dropping cached session)" : "");
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        if (cached_session)
+        {
+            /* A stale ticket should never cost more than one attempt */
+            esp_tls_free_client_session(cached_session);
+            cached_session = NULL;
+        }
+#endif
+        esp_tls_conn_destroy(ctx->tls);
+        ctx->tls = NULL;
+        return -1;
+    }
+
+    stats.handshakes++;
+    stats.last_ms = elapsed_ms;
+    if (resuming)
+    {
+        stats.resume_attempts++;
+        resumed_total_ms += elapsed_ms;
+        resumed_count++;
+        stats.resumed_avg_ms = (uint32_t)(resumed_total_ms / resumed_count);
+    }
+    else
+    {
+        full_total_ms += elapsed_ms;
+        full_count++;
+        stats.full_avg_ms = (uint32_t)(full_total_ms / full_count);
+    }
+    ESP_LOGI(TAG, "TLS handshake %lu ms (%s; full avg %lu ms, resumed avg %lu ms)",
+             (unsigned long)elapsed_ms, resuming ? "cached session offered" : "full handshake",
+             (unsigned long)stats.full_avg_ms, (unsigned long)stats.resumed_avg_ms);
+
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    /* Keep the newest session/ticket for the next reconnect */
+    esp_tls_client_session_t *session = esp_tls_get_client_session(ctx->tls);
+    if (session)
+    {
+        if (cached_session)
+        {
+            esp_tls_free_client_session(cached_session);
+        }
+        cached_session = session;
+    }
+#endif
+    return 0;
+}
+
+static int tls_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    mqtt_tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->tls == NULL)
+    {
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+
+    /* Decrypted bytes may already be buffered inside mbedTLS */
+    if (esp_tls_get_bytes_avail(ctx->tls) <= 0)
+    {
+        int poll = tls_poll(ctx, timeout_ms, false);
+        if (poll <= 0)
+        {
+            return poll == 0 ? ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT : ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+        }
+    }
+
+    ssize_t ret = esp_tls_conn_read(ctx->tls, buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE)
+    {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (ret == 0)
+    {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+    if (ret < 0)
+    {
+        ESP_LOGE(TAG, "TLS read error: -0x%x", (unsigned)-ret);
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+    return (int)ret;
+}
+
+static int tls_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    mqtt_tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->tls == NULL)
+    {
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+
+    int poll = tls_poll(ctx, timeout_ms, true);
+    if (poll <= 0)
+    {
+        return poll == 0 ? ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT : ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+
+    ssize_t ret = esp_tls_conn_write(ctx->tls, buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE)
+    {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (ret < 0)
+    {
+        ESP_LOGE(TAG, "TLS write error: -0x%x", (unsigned)-ret);
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+    return (int)ret;
+}
+
+static int tls_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    mqtt_tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->tls && esp_tls_get_bytes_avail(ctx->tls) > 0)
+    {
+        return 1;
+    }
+    return tls_poll(ctx, timeout_ms, false);
+}
+
+static int tls_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    return tls_poll(esp_transport_get_context_data(t), timeout_ms, true);
+}
+
+static int tls_close(esp_transport_handle_t t)
+{
+    mqtt_tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    int ret = 0;
+    if (ctx->tls)
+    {
+        ret = esp_tls_conn_destroy(ctx->tls);
+        ctx->tls = NULL;
+    }
+    return ret;
+}
+
+static int tls_destroy(esp_transport_handle_t t)
+{
+    tls_close(t);
+    free(esp_transport_get_context_data(t));
+    return 0;
+}
+
+esp_transport_handle_t mqtt_tls_transport_create(const mqtt_tls_config_t *config)
+{
+    esp_transport_handle_t t = esp_transport_init();
+    if (t == NULL)
+    {
+        return NULL;
+    }
+
+    mqtt_tls_ctx_t *ctx = calloc(1, sizeof(mqtt_tls_ctx_t));
+    if (ctx == NULL)
+    {
+        esp_transport_destroy(t);
+        return NULL;
+    }
+    ctx->cfg = *config;
+
+    esp_transport_set_context_data(t, ctx);
+    esp_transport_set_func(t, tls_connect, tls_read, tls_write, tls_close,
+                           tls_poll_read, tls_poll_write, tls_destroy);
+    esp_transport_set_default_port(t, 8883);
+
+#if !CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    ESP_LOGW(TAG, "CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS disabled, every connect is a full handshake");
+#endif
+    return t;
+}
+
+void mqtt_tls_forget_session(void)
+{
+    forget_pending = true;
+}
+
+void mqtt_tls_get_stats(mqtt_tls_stats_t *out)
+{
+    *out = stats;
+}
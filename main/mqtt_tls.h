@@ -0,0 +1,67 @@
+/*
+ * MQTT TLS Transport with Session Resumption
+ * esp-tls based transport for esp-mqtt that caches the TLS session so
+ * reconnects can skip the full mTLS handshake
+ */
+
+#ifndef MQTT_TLS_H
+#define MQTT_TLS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_transport.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Certificates for the mutually authenticated connection (PEM, NUL-terminated)
+     */
+    typedef struct
+    {
+        const char *ca_cert;
+        const char *client_cert;
+        const char *client_key;
+        int timeout_ms;
+    } mqtt_tls_config_t;
+
+    /**
+     * @brief Handshake statistics since boot
+     */
+    typedef struct
+    {
+        uint32_t handshakes;       /* Successful handshakes */
+        uint32_t resume_attempts;  /* Handshakes that offered a cached session */
+        uint32_t failures;         /* Failed connection attempts */
+        uint32_t last_ms;          /* Duration of the most recent handshake */
+        uint32_t full_avg_ms;      /* Average without a cached session */
+        uint32_t resumed_avg_ms;   /* Average with a cached session offered */
+    } mqtt_tls_stats_t;
+
+    /**
+     * @brief Create a transport for esp_mqtt_client_config_t.network.transport
+     *
+     * The certificate buffers must stay valid for the lifetime of the
+     * transport. The transport is destroyed together with the MQTT client.
+     *
+     * @return Transport handle, or NULL on allocation failure
+     */
+    esp_transport_handle_t mqtt_tls_transport_create(const mqtt_tls_config_t *config);
+
+    /**
+     * @brief Drop the cached TLS session so the next connect does a full handshake
+     */
+    void mqtt_tls_forget_session(void);
+
+    /**
+     * @brief Copy the handshake statistics
+     */
+    void mqtt_tls_get_stats(mqtt_tls_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MQTT_TLS_H */
@@ -0,0 +1,490 @@
+/*
+ * OTA Update
+ * A/B firmware updates streamed over HTTPS straight into the idle OTA slot,
+ * resumed with Range requests after a dropped connection, and rolled back
+ * unless the new image makes it back onto MQTT
+ */
+
+#include "ota_update.h"
+#include "esp_app_desc.h"
+#include "esp_http_client.h"
+#include "esp_image_format.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/sha256.h"
+#include "sale_parser.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "ota_update";
+
+#define OTA_HTTP_TIMEOUT_MS 15000
+#define OTA_RETRY_BASE_MS 2000   /* Doubles per failed reconnect, up to 32 s */
+#define OTA_REBOOT_DELAY_MS 1500 /* Lets the final status reach the broker */
+#define OTA_PROGRESS_STEPS 10
+
+/* The app description sits right after the image and first segment headers */
+#define OTA_DESC_END (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t))
+
+static ota_update_config_t cfg;
+static portMUX_TYPE status_lock = portMUX_INITIALIZER_UNLOCKED;
+static ota_status_t status;
+static bool busy = false;
+static bool on_trial = false;
+static esp_timer_handle_t confirm_timer = NULL;
+
+/* Owned by the download task while busy */
+static struct
+{
+    char url[OTA_URL_MAX_LEN + 1];
+    uint8_t sha256[32];
+    bool check_sha;
+    const esp_partition_t *slot;
+    esp_ota_handle_t handle;
+    bool begun;
+    mbedtls_sha256_context sha;
+    uint32_t written;
+    uint32_t size;
+    uint32_t next_report;
+} job;
+
+static uint8_t chunk[OTA_CHUNK_SIZE];
+
+static void report(ota_state_t state, esp_err_t error)
+{
+    ota_status_t copy;
+    taskENTER_CRITICAL(&status_lock);
+    status.state = state;
+    status.error = error;
+    status.written = job.written;
+    status.size = job.size;
+    copy = status;
+    taskEXIT_CRITICAL(&status_lock);
+
+    if (cfg.on_status)
+    {
+        cfg.on_status(&copy);
+    }
+}
+
+/* Throw away what was written and start the image over */
+static void restart_image(void)
+{
+    if (job.begun)
+    {
+        esp_ota_abort(job.handle);
+        job.begun = false;
+    }
+    mbedtls_sha256_free(&job.sha);
+    mbedtls_sha256_init(&job.sha);
+    mbedtls_sha256_starts(&job.sha, 0);
+    job.written = 0;
+    job.next_report = 0;
+}
+
+/* Reject anything but an app image for this project before erasing much */
+static esp_err_t check_header(const uint8_t *data, size_t len)
+{
+    if (len < OTA_DESC_END)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const esp_image_header_t *hdr = (const esp_image_header_t *)data;
+    esp_app_desc_t desc;
+    memcpy(&desc, data + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(desc));
+    if (hdr->magic != ESP_IMAGE_HEADER_MAGIC || desc.magic_word != ESP_APP_DESC_MAGIC_WORD)
+    {
+        ESP_LOGE(TAG, "Not an app image");
+        return ESP_ERR_IMAGE_INVALID;
+    }
+    const esp_app_desc_t *running = esp_app_get_description();
+    if (strncmp(desc.project_name, running->project_name, sizeof(desc.project_name)) != 0)
+    {
+        ESP_LOGE(TAG, "Image is for %.32s, not %.32s", desc.project_name, running->project_name);
+        return ESP_ERR_IMAGE_INVALID;
+    }
+
+    taskENTER_CRITICAL(&status_lock);
+    strncpy(status.version, desc.version, sizeof(status.version) - 1);
+    status.version[sizeof(status.version) - 1] = '\0';
+    taskEXIT_CRITICAL(&status_lock);
+    ESP_LOGI(TAG, "Incoming image %.32s (running %.32s)", desc.version, running->version);
+    return ESP_OK;
+}
+
+static esp_err_t write_chunk(const uint8_t *data, size_t len)
+{
+    esp_err_t err;
+    if (!job.begun)
+    {
+        err = check_header(data, len);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        /* Sequential writes erase sector by sector as the image grows, so
+         * there is no long up-front erase stalling the flash cache */
+        err = esp_ota_begin(job.slot, OTA_WITH_SEQUENTIAL_WRITES, &job.handle);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        job.begun = true;
+    }
+
+    err = esp_ota_write(job.handle, data, len);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    mbedtls_sha256_update(&job.sha, data, len);
+    job.written += len;
+
+    if (job.written >= job.next_report)
+    {
+        job.next_report = job.written + (job.size ? job.size / OTA_PROGRESS_STEPS : 256 * 1024);
+        report(OTA_STATE_DOWNLOADING, ESP_OK);
+    }
+    return ESP_OK;
+}
+
+/*
+ * One HTTP connection, resuming at job.written. Returns ESP_OK once the
+ * whole image is in flash; *fatal tells a broken image from a broken link.
+ */
+static esp_err_t fetch(bool *fatal)
+{
+    *fatal = false;
+    esp_http_client_config_t http_cfg = {
+        .url = job.url,
+        .cert_pem = cfg.cert_pem,
+        .timeout_ms = OTA_HTTP_TIMEOUT_MS,
+        .keep_alive_enable = true,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&http_cfg);
+    if (client == NULL)
+    {
+        *fatal = true;
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint32_t offset = job.written;
+    if (offset > 0)
+    {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%lu-", (unsigned long)offset);
+        esp_http_client_set_header(client, "Range", range);
+    }
+
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK)
+    {
+        goto done;
+    }
+    int64_t length = esp_http_client_fetch_headers(client);
+    int code = esp_http_client_get_status_code(client);
+
+    if (offset > 0 && code == 200)
+    {
+        ESP_LOGW(TAG, "Server ignored the range request, starting over");
+        restart_image();
+        offset = 0;
+    }
+    else if (code != 200 && code != 206)
+    {
+        ESP_LOGE(TAG, "HTTP status %d", code);
+        *fatal = code >= 400 && code < 500 && code != 408 && code != 429;
+        err = ESP_FAIL;
+        goto done;
+    }
+    if (length > 0)
+    {
+        job.size = offset + (uint32_t)length;
+    }
+    if (job.size > job.slot->size)
+    {
+        ESP_LOGE(TAG, "Image of %lu bytes does not fit %s", (unsigned long)job.size, job.slot->label);
+        *fatal = true;
+        err = ESP_ERR_INVALID_SIZE;
+        goto done;
+    }
+
+    /* Fill whole chunks so flash sees aligned, sector-sized writes */
+    size_t fill = 0;
+    while (1)
+    {
+        int n = esp_http_client_read(client, (char *)chunk + fill, OTA_CHUNK_SIZE - fill);
+        if (n > 0)
+        {
+            fill += n;
+            if (fill < OTA_CHUNK_SIZE)
+            {
+                continue;
+            }
+        }
+
+        /* Even after an error, what did arrive is good: keep it for the
+         * resume, unless it is too short to check the header yet */
+        if (fill > 0 && (job.begun || fill >= OTA_DESC_END || n == 0))
+        {
+            esp_err_t werr = write_chunk(chunk, fill);
+            fill = 0;
+            if (werr != ESP_OK)
+            {
+                ESP_LOGE(TAG, "Flash write failed: %s", esp_err_to_name(werr));
+                *fatal = true;
+                err = werr;
+                break;
+            }
+            vTaskDelay(1); /* Gaps between erases for the rendering core */
+        }
+
+        if (n < 0)
+        {
+            err = ESP_FAIL;
+            break;
+        }
+        if (n == 0)
+        {
+            bool complete = esp_http_client_is_complete_data_received(client) &&
+                            (job.size == 0 || job.written == job.size);
+            err = complete ? ESP_OK : ESP_FAIL;
+            break;
+        }
+    }
+
+done:
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return err;
+}
+
+static esp_err_t finish(void)
+{
+    report(OTA_STATE_VERIFYING, ESP_OK);
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&job.sha, digest);
+    if (job.check_sha && memcmp(digest, job.sha256, sizeof(digest)) != 0)
+    {
+        ESP_LOGE(TAG, "SHA-256 mismatch");
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    /* Validates the image and, with signed apps enabled, its signature
+     * against the key of the running image */
+    job.begun = false;
+    esp_err_t err = esp_ota_end(job.handle);
+    if (err == ESP_OK)
+    {
+        err = esp_ota_set_boot_partition(job.slot);
+    }
+    return err;
+}
+
+static void ota_task(void *arg)
+{
+    int retries = 0;
+    esp_err_t err;
+
+    ESP_LOGI(TAG, "Downloading %s into %s", job.url, job.slot->label);
+    report(OTA_STATE_DOWNLOADING, ESP_OK);
+
+    while (1)
+    {
+        uint32_t before = job.written;
+        bool fatal;
+        err = fetch(&fatal);
+        if (err == ESP_OK || fatal)
+        {
+            break;
+        }
+
+        retries = job.written > before ? 0 : retries + 1;
+        if (retries > OTA_MAX_RETRIES)
+        {
+            break;
+        }
+        uint32_t delay_ms = OTA_RETRY_BASE_MS << (retries < 5 ? retries : 4);
+        ESP_LOGW(TAG, "Download interrupted at %lu bytes, resuming in %lu ms", (unsigned long)job.written,
+                 (unsigned long)delay_ms);
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+
+        taskENTER_CRITICAL(&status_lock);
+        status.resumes += job.written > 0;
+        taskEXIT_CRITICAL(&status_lock);
+    }
+
+    if (err == ESP_OK)
+    {
+        err = finish();
+    }
+
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Update written (%lu bytes), restarting", (unsigned long)job.written);
+        report(OTA_STATE_REBOOTING, ESP_OK);
+        vTaskDelay(pdMS_TO_TICKS(OTA_REBOOT_DELAY_MS));
+        esp_restart();
+    }
+
+    ESP_LOGE(TAG, "Update failed: %s", esp_err_to_name(err));
+    if (job.begun)
+    {
+        esp_ota_abort(job.handle);
+        job.begun = false;
+    }
+    mbedtls_sha256_free(&job.sha);
+    report(OTA_STATE_FAILED, err);
+    __atomic_store_n(&busy, false, __ATOMIC_RELEASE);
+    vTaskDelete(NULL);
+}
+
+static void confirm_timeout_cb(void *arg)
+{
+    ESP_LOGE(TAG, "New image never reached MQTT, rolling back");
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+esp_err_t ota_update_init(const ota_update_config_t *config)
+{
+    cfg = *config;
+
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY)
+    {
+        /* A crash before then also rolls back: the bootloader will not
+         * start a pending image twice */
+        const esp_timer_create_args_t args = {
+            .callback = confirm_timeout_cb,
+            .name = "ota_confirm",
+        };
+        esp_err_t err = esp_timer_create(&args, &confirm_timer);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        esp_timer_start_once(confirm_timer, (uint64_t)OTA_CONFIRM_TIMEOUT_MS * 1000);
+        on_trial = true;
+    }
+
+    ESP_LOGI(TAG, "Running %s from %s%s", esp_app_get_description()->version, running->label,
+             on_trial ? " (on trial until MQTT connects)" : "");
+    return ESP_OK;
+}
+
+void ota_update_confirm(void)
+{
+    if (!__atomic_exchange_n(&on_trial, false, __ATOMIC_ACQ_REL))
+    {
+        return;
+    }
+    esp_timer_stop(confirm_timer);
+    esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
+    ESP_LOGI(TAG, "New image confirmed: %s", esp_err_to_name(err));
+}
+
+static bool parse_hex(const char *hex, uint8_t *out, size_t len)
+{
+    if (strlen(hex) != len * 2)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < len * 2; i++)
+    {
+        char ch = hex[i];
+        int v = ch >= '0' && ch <= '9' ? ch - '0' : (ch | 0x20) >= 'a' && (ch | 0x20) <= 'f' ? (ch | 0x20) - 'a' + 10 : -1;
+        if (v < 0)
+        {
+            return false;
+        }
+        out[i / 2] = (uint8_t)(i % 2 ? out[i / 2] | v : v << 4);
+    }
+    return true;
+}
+
+esp_err_t ota_update_start_json(const char *json, size_t len)
+{
+    char url[OTA_URL_MAX_LEN + 1];
+    char hex[66];
+    uint8_t sha256[32];
+    bool check_sha = false;
+
+    if (!sale_json_get_string(json, len, "url", url, sizeof(url)) || strncasecmp(url, "https://", 8) != 0)
+    {
+        ESP_LOGW(TAG, "Missing or non-https url");
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (sale_json_get_string(json, len, "sha256", hex, sizeof(hex)))
+    {
+        if (!parse_hex(hex, sha256, sizeof(sha256)))
+        {
+            ESP_LOGW(TAG, "Invalid sha256");
+            return ESP_ERR_INVALID_ARG;
+        }
+        check_sha = true;
+    }
+
+    const esp_partition_t *slot = esp_ota_get_next_update_partition(NULL);
+    if (slot == NULL)
+    {
+        ESP_LOGE(TAG, "No OTA slot in the partition table");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (__atomic_exchange_n(&busy, true, __ATOMIC_ACQ_REL))
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    memset(&job, 0, sizeof(job));
+    strcpy(job.url, url);
+    memcpy(job.sha256, sha256, sizeof(sha256));
+    job.check_sha = check_sha;
+    job.slot = slot;
+    mbedtls_sha256_init(&job.sha);
+    mbedtls_sha256_starts(&job.sha, 0);
+
+    taskENTER_CRITICAL(&status_lock);
+    memset(&status, 0, sizeof(status));
+    taskEXIT_CRITICAL(&status_lock);
+
+    if (xTaskCreatePinnedToCore(ota_task, "ota", cfg.stack, NULL, cfg.priority, NULL, cfg.core) != pdPASS)
+    {
+        mbedtls_sha256_free(&job.sha);
+        __atomic_store_n(&busy, false, __ATOMIC_RELEASE);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void ota_update_get_status(ota_status_t *out)
+{
+    taskENTER_CRITICAL(&status_lock);
+    *out = status;
+    taskEXIT_CRITICAL(&status_lock);
+}
+
+int ota_update_format(const ota_status_t *s, char *buf, size_t size)
+{
+    static const char *const names[] = {
+        [OTA_STATE_IDLE] = "idle",
+        [OTA_STATE_DOWNLOADING] = "downloading",
+        [OTA_STATE_VERIFYING] = "verifying",
+        [OTA_STATE_REBOOTING] = "rebooting",
+        [OTA_STATE_FAILED] = "failed",
+    };
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    int len = snprintf(buf, size,
+                       "{\"type\":\"ota\",\"state\":\"%s\",\"running\":\"%s\",\"slot\":\"%s\",\"version\":\"%s\","
+                       "\"written\":%lu,\"size\":%lu,\"resumes\":%lu,\"error\":\"%s\"}",
+                       names[s->state], esp_app_get_description()->version, running ? running->label : "?",
+                       s->version, (unsigned long)s->written, (unsigned long)s->size, (unsigned long)s->resumes,
+                       esp_err_to_name(s->error));
+    return len >= 0 && (size_t)len < size ? len : -1;
+}
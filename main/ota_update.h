@@ -0,0 +1,104 @@
+/*
+ * OTA Update
+ * A/B firmware updates streamed over HTTPS straight into the idle OTA slot,
+ * resumed with Range requests after a dropped connection, and rolled back
+ * unless the new image makes it back onto MQTT
+ */
+
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Longest image URL a command may carry */
+#define OTA_URL_MAX_LEN 256
+/* Bytes read from HTTP and written to flash at a time */
+#define OTA_CHUNK_SIZE 4096
+/* Reconnects in a row without progress before giving up */
+#define OTA_MAX_RETRIES 8
+/* A new image that has not reached MQTT by then is rolled back */
+#define OTA_CONFIRM_TIMEOUT_MS (5 * 60 * 1000)
+
+    typedef enum
+    {
+        OTA_STATE_IDLE,
+        OTA_STATE_DOWNLOADING,
+        OTA_STATE_VERIFYING, /* Checking length, SHA-256 and signature */
+        OTA_STATE_REBOOTING, /* New slot selected; restarting into it */
+        OTA_STATE_FAILED,    /* Gave up; the running image is untouched */
+    } ota_state_t;
+
+    typedef struct
+    {
+        ota_state_t state;
+        uint32_t written; /* Image bytes in flash */
+        uint32_t size;    /* Image size, 0 until the server tells it */
+        uint32_t resumes; /* Downloads continued from an offset */
+        esp_err_t error;  /* Why it failed */
+        char version[32]; /* Version of the incoming image */
+    } ota_status_t;
+
+    /**
+     * @brief Progress callback, run on the OTA task
+     */
+    typedef void (*ota_status_cb_t)(const ota_status_t *status);
+
+    typedef struct
+    {
+        const char *cert_pem;      /* CA for the image server */
+        ota_status_cb_t on_status; /* State changes and every 10%; may be NULL */
+        int core;                  /* Download task core, or tskNO_AFFINITY */
+        int priority;
+        int stack;
+    } ota_update_config_t;
+
+    /**
+     * @brief Report the running slot and, if it is a new image still on
+     * trial, arm the rollback timer
+     */
+    esp_err_t ota_update_init(const ota_update_config_t *config);
+
+    /**
+     * @brief Keep the running image: call once it has reached MQTT
+     *
+     * Cancels the rollback. A no-op when the image is not on trial.
+     */
+    void ota_update_confirm(void);
+
+    /**
+     * @brief Start a background download from a {"type":"ota"} payload
+     *
+     * Recognized members: "url" (https only, required) and "sha256"
+     * (64 hex digits, optional).
+     *
+     * @return ESP_ERR_NOT_FOUND without an https url (a status query),
+     *         ESP_ERR_INVALID_ARG for a bad sha256, ESP_ERR_INVALID_STATE
+     *         while another update runs
+     */
+    esp_err_t ota_update_start_json(const char *json, size_t len);
+
+    /**
+     * @brief Copy the current update status
+     */
+    void ota_update_get_status(ota_status_t *out);
+
+    /**
+     * @brief Render @p status as a {"type":"ota"} JSON reply
+     *
+     * @return Length written, or -1 if @p size is too small
+     */
+    int ota_update_format(const ota_status_t *status, char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTA_UPDATE_H */
@@ -0,0 +1,253 @@
+/*
+ * Display Performance Monitor
+ * Per-frame render time, flush time and SPI bytes kept in a fixed ring,
+ * summarized on demand as min/avg/p99/max
+ */
+
+#include "perf_monitor.h"
+#include "round_panel.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    uint32_t t_ms;
+    uint32_t render_ms;
+    uint32_t flush_us;
+    uint32_t spi_bytes;
+} frame_sample_t;
+
+/* Written by the LVGL task, copied out under the lock by snapshots */
+static frame_sample_t ring[PERF_MONITOR_FRAMES];
+static uint32_t frame_count = 0;
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Flush counters at the previous frame, for per-frame deltas */
+static uint32_t last_flush_us = 0;
+static uint64_t last_bytes_sent = 0;
+
+/* One-shot notification for the next frame (LVGL task only) */
+static perf_frame_cb_t next_frame_cb = NULL;
+static void *next_frame_arg = NULL;
+
+static struct
+{
+    bool active;
+    int64_t start_us;
+    uint32_t frames;
+    uint32_t total_ms;
+    uint32_t max_ms;
+    uint64_t px;
+} burst;
+
+/* Schedule probe (LVGL task / port lock) */
+static struct
+{
+    lv_timer_t *timer;
+    int64_t last_us;
+    uint32_t *late_us;
+    uint32_t count;
+} probe;
+
+static void perf_monitor_cb(lv_disp_drv_t *drv, uint32_t time_ms, uint32_t px)
+{
+    round_panel_stats_t flush;
+    round_panel_get_stats(&flush);
+
+    /* The frame's last DMA may still be in flight; it lands in the next sample */
+    frame_sample_t s = {
+        .t_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .render_ms = time_ms,
+        .flush_us = flush.flush_us - last_flush_us,
+        .spi_bytes = (uint32_t)(flush.bytes_sent - last_bytes_sent),
+    };
+    last_flush_us = flush.flush_us;
+    last_bytes_sent = flush.bytes_sent;
+
+    portENTER_CRITICAL(&ring_lock);
+    ring[frame_count % PERF_MONITOR_FRAMES] = s;
+    frame_count++;
+    portEXIT_CRITICAL(&ring_lock);
+
+    if (burst.active)
+    {
+        burst.frames++;
+        burst.total_ms += time_ms;
+        burst.px += px;
+        if (time_ms > burst.max_ms)
+        {
+            burst.max_ms = time_ms;
+        }
+    }
+
+    if (next_frame_cb)
+    {
+        perf_frame_cb_t cb = next_frame_cb;
+        next_frame_cb = NULL;
+        cb(next_frame_arg);
+    }
+}
+
+void perf_monitor_attach(lv_disp_t *disp)
+{
+    disp->driver->monitor_cb = perf_monitor_cb;
+}
+
+void perf_monitor_on_next_frame(perf_frame_cb_t cb, void *arg)
+{
+    next_frame_arg = arg;
+    next_frame_cb = cb;
+}
+
+void perf_monitor_burst_begin(void)
+{
+    if (!burst.active)
+    {
+        memset(&burst, 0, sizeof(burst));
+        burst.start_us = esp_timer_get_time();
+        burst.active = true;
+    }
+}
+
+bool perf_monitor_burst_end(perf_burst_t *out)
+{
+    if (!burst.active)
+    {
+        return false;
+    }
+    burst.active = false;
+
+    int64_t elapsed_ms = (esp_timer_get_time() - burst.start_us) / 1000;
+    if (burst.frames == 0 || elapsed_ms <= 0)
+    {
+        return false;
+    }
+    out->frames = burst.frames;
+    out->fps = (uint32_t)(burst.frames * 1000 / elapsed_ms);
+    out->avg_ms = burst.total_ms / burst.frames;
+    out->max_ms = burst.max_ms;
+    out->px_per_frame = (uint32_t)(burst.px / burst.frames);
+    return true;
+}
+
+static void insertion_sort(uint32_t *v, uint32_t n)
+{
+    for (uint32_t i = 1; i < n; i++)
+    {
+        uint32_t x = v[i];
+        uint32_t j = i;
+        while (j > 0 && v[j - 1] > x)
+        {
+            v[j] = v[j - 1];
+            j--;
+        }
+        v[j] = x;
+    }
+}
+
+static void summarize(uint32_t *v, uint32_t n, perf_summary_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (n == 0)
+    {
+        return;
+    }
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        sum += v[i];
+    }
+    insertion_sort(v, n);
+    out->min = v[0];
+    out->avg = (uint32_t)(sum / n);
+    out->p99 = v[(n * 99 + 99) / 100 - 1];
+    out->max = v[n - 1];
+}
+
+void perf_monitor_snapshot(perf_snapshot_t *out)
+{
+    frame_sample_t copy[PERF_MONITOR_FRAMES];
+    uint32_t values[PERF_MONITOR_FRAMES];
+
+    portENTER_CRITICAL(&ring_lock);
+    uint32_t total = frame_count;
+    uint32_t n = total < PERF_MONITOR_FRAMES ? total : PERF_MONITOR_FRAMES;
+    /* Oldest first, so consecutive entries give frame intervals */
+    for (uint32_t i = 0; i < n; i++)
+    {
+        copy[i] = ring[(total - n + i) % PERF_MONITOR_FRAMES];
+    }
+    portEXIT_CRITICAL(&ring_lock);
+
+    memset(out, 0, sizeof(*out));
+    out->frames = total;
+    out->samples = n;
+
+    uint32_t active_ms = 0;
+    uint32_t active_frames = 0;
+    for (uint32_t i = 1; i < n; i++)
+    {
+        uint32_t gap = copy[i].t_ms - copy[i - 1].t_ms;
+        if (gap <= PERF_MONITOR_IDLE_GAP_MS)
+        {
+            active_ms += gap;
+            active_frames++;
+        }
+    }
+    out->fps = active_ms ? active_frames * 1000 / active_ms : 0;
+
+    for (uint32_t i = 0; i < n; i++)
+        values[i] = copy[i].render_ms;
+    summarize(values, n, &out->render_ms);
+    for (uint32_t i = 0; i < n; i++)
+        values[i] = copy[i].flush_us;
+    summarize(values, n, &out->flush_us);
+    for (uint32_t i = 0; i < n; i++)
+        values[i] = copy[i].spi_bytes;
+    summarize(values, n, &out->spi_bytes);
+}
+
+static void probe_timer_cb(lv_timer_t *timer)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t late = now - probe.last_us - PERF_MONITOR_PROBE_PERIOD_MS * 1000;
+    probe.last_us = now;
+    if (probe.count < PERF_MONITOR_PROBE_SAMPLES)
+    {
+        probe.late_us[probe.count++] = late > 0 ? (uint32_t)late : 0;
+    }
+}
+
+void perf_monitor_probe_begin(void)
+{
+    if (probe.timer)
+    {
+        return;
+    }
+    probe.late_us = malloc(PERF_MONITOR_PROBE_SAMPLES * sizeof(uint32_t));
+    if (probe.late_us == NULL)
+    {
+        return;
+    }
+    probe.count = 0;
+    probe.last_us = esp_timer_get_time();
+    probe.timer = lv_timer_create(probe_timer_cb, PERF_MONITOR_PROBE_PERIOD_MS, NULL);
+}
+
+uint32_t perf_monitor_probe_end(perf_summary_t *late_us)
+{
+    if (probe.timer == NULL)
+    {
+        return 0;
+    }
+    lv_timer_del(probe.timer);
+    probe.timer = NULL;
+
+    uint32_t n = probe.count;
+    summarize(probe.late_us, n, late_us);
+    free(probe.late_us);
+    probe.late_us = NULL;
+    return n;
+}
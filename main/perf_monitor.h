@@ -0,0 +1,117 @@
+/*
+ * Display Performance Monitor
+ * Per-frame render time, flush time and SPI bytes kept in a fixed ring,
+ * summarized on demand as min/avg/p99/max
+ */
+
+#ifndef PERF_MONITOR_H
+#define PERF_MONITOR_H
+
+#include <stdint.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Frames kept for the rolling summaries (power of two) */
+#define PERF_MONITOR_FRAMES 64
+
+/* Refresh gaps longer than this count as idle, not as slow frames */
+#define PERF_MONITOR_IDLE_GAP_MS 200
+
+/* Schedule probe: timer period and the most samples one probe keeps */
+#define PERF_MONITOR_PROBE_PERIOD_MS 10
+#define PERF_MONITOR_PROBE_SAMPLES 512
+
+    typedef struct
+    {
+        uint32_t min;
+        uint32_t avg;
+        uint32_t p99;
+        uint32_t max;
+    } perf_summary_t;
+
+    typedef struct
+    {
+        uint32_t frames;       /* Frames since boot */
+        uint32_t samples;      /* Frames in the rolling window */
+        uint32_t fps;          /* Frame rate while animating */
+        perf_summary_t render_ms;
+        perf_summary_t flush_us;
+        perf_summary_t spi_bytes;
+    } perf_snapshot_t;
+
+    /**
+     * @brief Totals for one measured burst (e.g. a money rain)
+     */
+    typedef struct
+    {
+        uint32_t frames;
+        uint32_t fps;
+        uint32_t avg_ms;
+        uint32_t max_ms;
+        uint32_t px_per_frame;
+    } perf_burst_t;
+
+    /**
+     * @brief Hook the display's refresh monitor
+     *
+     * Call with the LVGL port lock held, after the flush path is installed.
+     * Flush time and SPI bytes come from the round-panel flush statistics.
+     */
+    void perf_monitor_attach(lv_disp_t *disp);
+
+    typedef void (*perf_frame_cb_t)(void *arg);
+
+    /**
+     * @brief Call @p cb once, from the LVGL task, after the next refresh has
+     * been rendered and handed to the flush
+     *
+     * Call from the LVGL task or with the port lock held. Replaces any
+     * callback still waiting.
+     */
+    void perf_monitor_on_next_frame(perf_frame_cb_t cb, void *arg);
+
+    /**
+     * @brief Start accumulating a burst (LVGL task only); no-op if one is running
+     */
+    void perf_monitor_burst_begin(void);
+
+    /**
+     * @brief Finish the burst started by perf_monitor_burst_begin()
+     *
+     * @return false if no burst was running or it saw no frames
+     */
+    bool perf_monitor_burst_end(perf_burst_t *out);
+
+    /**
+     * @brief Summarize the rolling window; safe from any task
+     */
+    void perf_monitor_snapshot(perf_snapshot_t *out);
+
+    /**
+     * @brief Start timing how late a fixed-period LVGL timer fires
+     *
+     * A frame can only start when the LVGL task gets the CPU, so the
+     * lateness is the frame jitter other work (e.g. a TLS handshake) causes,
+     * and it is measurable even while the screen is idle. Call with the
+     * port lock held; no-op if a probe is running.
+     */
+    void perf_monitor_probe_begin(void);
+
+    /**
+     * @brief Stop the probe and summarize the lateness in microseconds
+     *
+     * Call with the port lock held.
+     *
+     * @return Samples summarized; 0 if no probe was running
+     */
+    uint32_t perf_monitor_probe_end(perf_summary_t *late_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERF_MONITOR_H */
@@ -0,0 +1,90 @@
+/*
+ * QR Bitmap
+ * Packed QR module bitmap that can be cached and blitted straight into an
+ * RGB565 canvas buffer as whole module runs
+ */
+
+#include "qr_bitmap.h"
+#include <string.h>
+
+#define PX_BLACK 0x00
+#define PX_WHITE 0xFF
+
+static bool module_set(const qr_bitmap_t *bmp, int x, int y)
+{
+    int bit = y * bmp->size + x;
+    return (bmp->bits[bit >> 3] >> (bit & 7)) & 1;
+}
+
+bool qr_bitmap_from_qrcode(qr_bitmap_t *bmp, esp_qrcode_handle_t qrcode)
+{
+    int size = esp_qrcode_get_size(qrcode);
+    memset(bmp, 0, sizeof(*bmp));
+    if (size <= 0 || size > QR_BITMAP_MAX_SIZE)
+    {
+        return false;
+    }
+
+    bmp->size = (uint8_t)size;
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            if (esp_qrcode_get_module(qrcode, x, y))
+            {
+                int bit = y * size + x;
+                bmp->bits[bit >> 3] |= 1u << (bit & 7);
+            }
+        }
+    }
+    return true;
+}
+
+void qr_bitmap_blit(const qr_bitmap_t *bmp, lv_color_t *buf, int side)
+{
+    const size_t row_bytes = (size_t)side * sizeof(lv_color_t);
+    memset(buf, PX_WHITE, row_bytes * side);
+    if (bmp->size == 0)
+    {
+        return;
+    }
+
+    /* Same scaling as before: 3 px modules, 2 px if the margin gets too thin */
+    int module_px = 3;
+    if ((side - bmp->size * module_px) / 2 < 2)
+    {
+        module_px = 2;
+    }
+    if (bmp->size * module_px > side)
+    {
+        module_px = 1;
+    }
+    const int margin = (side - bmp->size * module_px) / 2;
+
+    for (int my = 0; my < bmp->size; my++)
+    {
+        lv_color_t *row = buf + (size_t)(margin + my * module_px) * side;
+
+        /* One pass per run of equal modules; white runs are already white */
+        int x = 0;
+        while (x < bmp->size)
+        {
+            bool dark = module_set(bmp, x, my);
+            int run = 1;
+            while (x + run < bmp->size && module_set(bmp, x + run, my) == dark)
+            {
+                run++;
+            }
+            if (dark)
+            {
+                memset(row + margin + x * module_px, PX_BLACK, (size_t)run * module_px * sizeof(lv_color_t));
+            }
+            x += run;
+        }
+
+        for (int dy = 1; dy < module_px; dy++)
+        {
+            memcpy(row + (size_t)dy * side, row, row_bytes);
+        }
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * QR Bitmap
+ * Packed QR module bitmap that can be cached and blitted straight into an
+ * RGB565 canvas buffer as whole module runs
+ */
+
+#ifndef QR_BITMAP_H
+#define QR_BITMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "qrcode.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Modules per side of a version 10 code, the largest we generate */
+#define QR_BITMAP_MAX_SIZE 57
+
+    typedef struct
+    {
+        uint8_t size; /* Modules per side, 0 if empty */
+        uint8_t bits[(QR_BITMAP_MAX_SIZE * QR_BITMAP_MAX_SIZE + 7) / 8];
+    } qr_bitmap_t;
+
+    /**
+     * @brief Pack the modules of a generated code (call from display_func)
+     *
+     * @return false if the code is larger than QR_BITMAP_MAX_SIZE
+     */
+    bool qr_bitmap_from_qrcode(qr_bitmap_t *bmp, esp_qrcode_handle_t qrcode);
+
+    /**
+     * @brief Render the code centred in a square true-color canvas buffer
+     *
+     * Rows are built from memset runs (black and white are byte-uniform in
+     * RGB565) and repeated with memcpy for the module height; the quiet
+     * zone is filled white.
+     *
+     * @param buf Canvas pixels, side * side
+     * @param side Canvas width and height in pixels
+     */
+    void qr_bitmap_blit(const qr_bitmap_t *bmp, lv_color_t *buf, int side);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QR_BITMAP_H */
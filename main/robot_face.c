@@ -0,0 +1,195 @@
+/*
+ * Robot Face
+ * The main screen's head, eyes, antenna, mouth and daily-total label, with
+ * the coin rain layer on top and setters for the celebration phases
+ */
+
+#include "robot_face.h"
+#include "coin_rain.h"
+#include "coin_sprite.h"
+#include <stddef.h>
+
+static lv_obj_t *pupils[2], *antenna_ball;
+static lv_obj_t *mouth = NULL, *mouth_text, *grille_lines[3];
+static lv_obj_t *total_label;
+
+void robot_face_create(lv_obj_t *scr, const robot_face_fonts_t *fonts)
+{
+    lv_obj_t *head = lv_obj_create(scr);
+    lv_obj_remove_style_all(head);
+    lv_obj_set_size(head, 200, 180);
+    lv_obj_align(head, LV_ALIGN_CENTER, 0, 15);
+    lv_obj_set_style_radius(head, 30, 0);
+    lv_obj_set_style_bg_color(head, lv_color_hex(COL_ROBOT), 0);
+    lv_obj_set_style_bg_opa(head, LV_OPA_COVER, 0);
+    lv_obj_set_style_border_width(head, 4, 0);
+    lv_obj_set_style_border_color(head, lv_color_hex(COL_ACCENT), 0);
+    lv_obj_clear_flag(head, LV_OBJ_FLAG_SCROLLABLE);
+
+    lv_obj_t *ant = lv_obj_create(scr);
+    lv_obj_remove_style_all(ant);
+    lv_obj_set_size(ant, 8, 30);
+    lv_obj_align(ant, LV_ALIGN_TOP_MID, 0, 15);
+    lv_obj_set_style_radius(ant, 4, 0);
+    lv_obj_set_style_bg_color(ant, lv_color_hex(COL_ACCENT), 0);
+    lv_obj_set_style_bg_opa(ant, LV_OPA_COVER, 0);
+
+    antenna_ball = lv_obj_create(scr);
+    lv_obj_remove_style_all(antenna_ball);
+    lv_obj_set_size(antenna_ball, 16, 16);
+    lv_obj_align(antenna_ball, LV_ALIGN_TOP_MID, 0, 5);
+    lv_obj_set_style_radius(antenna_ball, LV_RADIUS_CIRCLE, 0);
+    lv_obj_set_style_bg_color(antenna_ball, lv_color_hex(COL_CYAN), 0);
+    lv_obj_set_style_bg_opa(antenna_ball, LV_OPA_COVER, 0);
+
+    for (int i = 0; i < 2; i++)
+    {
+        lv_obj_t *eye = lv_obj_create(head);
+        lv_obj_remove_style_all(eye);
+        lv_obj_set_size(eye, 55, 40);
+        lv_obj_align(eye, i == 0 ? LV_ALIGN_TOP_LEFT : LV_ALIGN_TOP_RIGHT, i == 0 ? 20 : -20, 25);
+        lv_obj_set_style_radius(eye, 8, 0);
+        lv_obj_set_style_bg_color(eye, lv_color_hex(0x001515), 0);
+        lv_obj_set_style_bg_opa(eye, LV_OPA_COVER, 0);
+        lv_obj_set_style_border_width(eye, 3, 0);
+        lv_obj_set_style_border_color(eye, lv_color_hex(0x333333), 0);
+        lv_obj_clear_flag(eye, LV_OBJ_FLAG_SCROLLABLE);
+
+        pupils[i] = lv_obj_create(eye);
+        lv_obj_remove_style_all(pupils[i]);
+        lv_obj_set_size(pupils[i], 40, 26);
+        lv_obj_center(pupils[i]);
+        lv_obj_set_style_radius(pupils[i], 5, 0);
+        lv_obj_set_style_bg_color(pupils[i], lv_color_hex(COL_CYAN), 0);
+        lv_obj_set_style_bg_opa(pupils[i], LV_OPA_COVER, 0);
+        lv_obj_set_style_shadow_width(pupils[i], 15, 0);
+        lv_obj_set_style_shadow_color(pupils[i], lv_color_hex(COL_CYAN), 0);
+    }
+
+    mouth = lv_obj_create(head);
+    lv_obj_remove_style_all(mouth);
+    lv_obj_set_size(mouth, 80, 35);
+    lv_obj_align(mouth, LV_ALIGN_BOTTOM_MID, 0, -25);
+    lv_obj_set_style_radius(mouth, 8, 0);
+    lv_obj_set_style_bg_color(mouth, lv_color_hex(0x222222), 0);
+    lv_obj_set_style_bg_opa(mouth, LV_OPA_COVER, 0);
+    lv_obj_set_style_border_width(mouth, 2, 0);
+    lv_obj_set_style_border_color(mouth, lv_color_hex(0x444444), 0);
+    lv_obj_clear_flag(mouth, LV_OBJ_FLAG_SCROLLABLE);
+
+    for (int i = 0; i < 3; i++)
+    {
+        grille_lines[i] = lv_obj_create(mouth);
+        lv_obj_remove_style_all(grille_lines[i]);
+        lv_obj_set_size(grille_lines[i], 60, 3);
+        lv_obj_align(grille_lines[i], LV_ALIGN_TOP_MID, 0, 8 + i * 10);
+        lv_obj_set_style_bg_color(grille_lines[i], lv_color_hex(0x111111), 0);
+        lv_obj_set_style_bg_opa(grille_lines[i], LV_OPA_COVER, 0);
+    }
+
+    mouth_text = lv_label_create(mouth);
+    lv_label_set_text(mouth_text, "CHA-CHING!");
+    lv_obj_set_style_text_font(mouth_text, fonts->mouth, 0);
+    lv_obj_set_style_text_color(mouth_text, lv_color_hex(COL_GOLD), 0);
+    lv_obj_center(mouth_text);
+    lv_obj_add_flag(mouth_text, LV_OBJ_FLAG_HIDDEN);
+
+    /* Today's sales, between the eyes and the mouth */
+    total_label = lv_label_create(head);
+    lv_label_set_text(total_label, "");
+    lv_obj_set_style_text_font(total_label, fonts->total, 0);
+    lv_obj_set_style_text_color(total_label, lv_color_hex(0xAAAAAA), 0);
+    lv_obj_align(total_label, LV_ALIGN_TOP_MID, 0, 78);
+
+    /* Coin is rasterized once (shadow and "$" included); the rain layer only blits it */
+    const coin_sprite_style_t coin_style = {
+        .diameter = ROBOT_FACE_COIN_SIZE,
+        .border_width = 3,
+        .glow_width = 8,
+        .face = lv_color_hex(COL_GOLD),
+        .border = lv_color_hex(0xDAA520),
+        .glow = lv_color_hex(COL_GOLD),
+        .glyph_color = lv_color_hex(COL_MONEY_GREEN),
+        .font = fonts->coin,
+        .glyph = '$',
+    };
+    coin_sprite_init(&coin_style);
+    coin_rain_create(scr);
+}
+
+void robot_face_set_eye_color(uint32_t color)
+{
+    if (mouth == NULL)
+    {
+        return;
+    }
+    lv_color_t c = lv_color_hex(color);
+    for (int i = 0; i < 2; i++)
+    {
+        lv_obj_set_style_bg_color(pupils[i], c, 0);
+        lv_obj_set_style_shadow_color(pupils[i], c, 0);
+    }
+    lv_obj_set_style_bg_color(antenna_ball, c, 0);
+}
+
+void robot_face_set_antenna_color(uint32_t color)
+{
+    if (antenna_ball != NULL)
+    {
+        lv_obj_set_style_bg_color(antenna_ball, lv_color_hex(color), 0);
+    }
+}
+
+void robot_face_set_sales(uint32_t sales)
+{
+    if (mouth == NULL)
+    {
+        return;
+    }
+    if (sales > 1)
+    {
+        lv_label_set_text_fmt(mouth_text, "%lu SALES!", (unsigned long)sales);
+    }
+    else
+    {
+        lv_label_set_text(mouth_text, "CHA-CHING!");
+    }
+}
+
+void robot_face_open_mouth(void)
+{
+    if (mouth == NULL)
+    {
+        return;
+    }
+    lv_obj_set_size(mouth, 130, 45);
+    lv_obj_set_style_bg_color(mouth, lv_color_hex(0x1A1A1A), 0);
+    lv_obj_set_style_border_width(mouth, 3, 0);
+    lv_obj_set_style_border_color(mouth, lv_color_hex(COL_GOLD), 0);
+    for (int i = 0; i < 3; i++)
+        lv_obj_add_flag(grille_lines[i], LV_OBJ_FLAG_HIDDEN);
+    lv_obj_clear_flag(mouth_text, LV_OBJ_FLAG_HIDDEN);
+}
+
+void robot_face_close_mouth(void)
+{
+    if (mouth == NULL)
+    {
+        return;
+    }
+    lv_obj_set_size(mouth, 80, 35);
+    lv_obj_set_style_bg_color(mouth, lv_color_hex(0x222222), 0);
+    lv_obj_set_style_border_width(mouth, 2, 0);
+    lv_obj_set_style_border_color(mouth, lv_color_hex(0x444444), 0);
+    for (int i = 0; i < 3; i++)
+        lv_obj_clear_flag(grille_lines[i], LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_flag(mouth_text, LV_OBJ_FLAG_HIDDEN);
+}
+
+void robot_face_set_total(const char *text)
+{
+    if (total_label != NULL)
+    {
+        lv_label_set_text_static(total_label, text);
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ * Robot Face
+ * The main screen's head, eyes, antenna, mouth and daily-total label, with
+ * the coin rain layer on top and setters for the celebration phases
+ */
+
+#ifndef ROBOT_FACE_H
+#define ROBOT_FACE_H
+
+#include <stdint.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Palette, shared with the other screens */
+#define COL_BG 0x1A1A2E
+#define COL_ROBOT 0x4A4A4A
+#define COL_ACCENT 0x6A6A6A
+#define COL_CYAN 0x00FFFF
+#define COL_GREEN 0x00FF00
+#define COL_GOLD 0xFFD700
+#define COL_MONEY_GREEN 0x228B22
+#define COL_RED 0xFF0000
+
+/* Coin diameter, without its glow */
+#define ROBOT_FACE_COIN_SIZE 28
+
+    typedef struct
+    {
+        const lv_font_t *mouth; /* "CHA-CHING!" and "<n> SALES!" */
+        const lv_font_t *total; /* Daily total */
+        const lv_font_t *coin;  /* "$" on the coins */
+    } robot_face_fonts_t;
+
+    /*
+     * All functions below must be called from the LVGL task or with the
+     * LVGL port lock held. Setters are no-ops before robot_face_create().
+     */
+
+    /**
+     * @brief Build the face on @p scr, then rasterize the coin and add the
+     * rain layer above it
+     */
+    void robot_face_create(lv_obj_t *scr, const robot_face_fonts_t *fonts);
+
+    /**
+     * @brief Color the pupils, their glow and the antenna ball
+     */
+    void robot_face_set_eye_color(uint32_t color);
+
+    /**
+     * @brief Color only the antenna ball (the connection indicator)
+     */
+    void robot_face_set_antenna_color(uint32_t color);
+
+    /**
+     * @brief Mouth caption: "CHA-CHING!" for one sale, "<n> SALES!" for more
+     */
+    void robot_face_set_sales(uint32_t sales);
+
+    /**
+     * @brief Open the mouth wide and show the caption
+     */
+    void robot_face_open_mouth(void);
+
+    /**
+     * @brief Back to the closed grille
+     */
+    void robot_face_close_mouth(void);
+
+    /**
+     * @brief Show @p text as the daily total; it must stay valid while shown
+     */
+    void robot_face_set_total(const char *text);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ROBOT_FACE_H */
@@ -0,0 +1,316 @@
+/*
+ * Round Panel Flush
+ * Trims LVGL renders and SPI flushes to the visible disc of a round panel
+ * (GC9A01), skipping corner pixels that can never be seen, and streams
+ * PSRAM frame buffers through small internal DMA bounce buffers
+ */
+
+#include "round_panel.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "round_panel";
+
+#define FLUSH_WORKER_STACK 3072
+
+typedef struct
+{
+    lv_disp_drv_t *drv;
+    lv_area_t area;
+    lv_color_t *color_map;
+} flush_job_t;
+
+static esp_lcd_panel_handle_t panel_handle = NULL;
+static lv_disp_drv_t *disp_drv = NULL;
+static int panel_size = 0;
+static int band_rows = 0;
+
+/* Visible pixel span of each row, inclusive */
+static int16_t *row_x1 = NULL;
+static int16_t *row_x2 = NULL;
+
+/* Outstanding color transfers for the current flush, plus one guard count
+ * held by flush_area() while it is still queuing */
+static volatile uint32_t pending_transfers = 0;
+static int64_t flush_start_us = 0;
+
+/* Bounce mode: two band-sized DMA buffers, handed back by the color-done ISR
+ * in the order they were queued */
+static lv_color_t *bounce_buf[2] = {NULL, NULL};
+static SemaphoreHandle_t bounce_free = NULL;
+static QueueHandle_t flush_queue = NULL;
+static size_t internal_bytes = 0;
+
+static round_panel_stats_t stats;
+
+static bool IRAM_ATTR color_trans_done_cb(esp_lcd_panel_io_handle_t io,
+                                          esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+{
+    BaseType_t woken = pdFALSE;
+    if (bounce_free)
+    {
+        xSemaphoreGiveFromISR(bounce_free, &woken);
+    }
+    if (__atomic_sub_fetch(&pending_transfers, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        stats.flush_us += (uint32_t)(esp_timer_get_time() - flush_start_us);
+        lv_disp_flush_ready((lv_disp_drv_t *)user_ctx);
+    }
+    return woken == pdTRUE;
+}
+
+/* Union of the visible spans of rows y1..y2, clipped to x1..x2; false if empty */
+static bool band_span(int y1, int y2, int x1, int x2, int *out_x1, int *out_x2)
+{
+    int lo = panel_size;
+    int hi = -1;
+    for (int y = y1; y <= y2; y++)
+    {
+        if (row_x1[y] < lo)
+            lo = row_x1[y];
+        if (row_x2[y] > hi)
+            hi = row_x2[y];
+    }
+    lo = lo > x1 ? lo : x1;
+    hi = hi < x2 ? hi : x2;
+    *out_x1 = lo;
+    *out_x2 = hi;
+    return lo <= hi;
+}
+
+/* Shrink invalidated areas to the disc so LVGL does not render the corners */
+static void round_rounder_cb(lv_disp_drv_t *drv, lv_area_t *area)
+{
+    int x1, x2;
+    if (band_span(area->y1, area->y2, area->x1, area->x2, &x1, &x2))
+    {
+        area->x1 = x1;
+        area->x2 = x2;
+    }
+    else
+    {
+        /* Entirely invisible: keep a 1 px sliver, the flush drops it */
+        area->x2 = area->x1;
+    }
+}
+
+static void flush_area(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    const int area_w = area->x2 - area->x1 + 1;
+    uint32_t sent = 0;
+    int next_bounce = 0;
+
+    stats.flushes++;
+    flush_start_us = esp_timer_get_time();
+    __atomic_store_n(&pending_transfers, 1, __ATOMIC_RELEASE);
+
+    for (int ya = area->y1; ya <= area->y2; ya += band_rows)
+    {
+        int yb = ya + band_rows - 1;
+        if (yb > area->y2)
+            yb = area->y2;
+
+        int bx1, bx2;
+        if (!band_span(ya, yb, area->x1, area->x2, &bx1, &bx2))
+        {
+            continue;
+        }
+
+        const int bw = bx2 - bx1 + 1;
+        const int rows = yb - ya + 1;
+        lv_color_t *band = color_map + (size_t)(ya - area->y1) * area_w;
+
+        if (bounce_free)
+        {
+            /* Copy the trimmed rows out of PSRAM into the next free bounce
+             * buffer; the previous band keeps streaming from the other one */
+            if (xSemaphoreTake(bounce_free, 0) != pdTRUE)
+            {
+                stats.bounce_waits++;
+                xSemaphoreTake(bounce_free, portMAX_DELAY);
+            }
+            lv_color_t *dst = bounce_buf[next_bounce];
+            next_bounce ^= 1;
+            for (int r = 0; r < rows; r++)
+            {
+                memcpy(dst + (size_t)r * bw, band + (size_t)r * area_w + (bx1 - area->x1),
+                       (size_t)bw * sizeof(lv_color_t));
+            }
+            band = dst;
+        }
+        else if (bw != area_w)
+        {
+            /* Pack the trimmed rows to the front of the band's own slice of the
+             * buffer. Earlier bands (possibly still in DMA) are never touched. */
+            for (int r = 0; r < rows; r++)
+            {
+                memmove(band + (size_t)r * bw, band + (size_t)r * area_w + (bx1 - area->x1),
+                        (size_t)bw * sizeof(lv_color_t));
+            }
+        }
+
+        __atomic_add_fetch(&pending_transfers, 1, __ATOMIC_ACQ_REL);
+        esp_lcd_panel_draw_bitmap(panel_handle, bx1, ya, bx2 + 1, yb + 1, band);
+        stats.transfers++;
+        sent += (uint32_t)bw * rows;
+    }
+
+    uint32_t total = (uint32_t)area_w * (area->y2 - area->y1 + 1);
+    stats.bytes_sent += (uint64_t)sent * sizeof(lv_color_t);
+    stats.bytes_skipped += (uint64_t)(total - sent) * sizeof(lv_color_t);
+    if (sent == 0)
+    {
+        stats.dropped++;
+    }
+
+    /* Drop the guard; if every transfer already finished, finish here */
+    if (__atomic_sub_fetch(&pending_transfers, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        stats.flush_us += (uint32_t)(esp_timer_get_time() - flush_start_us);
+        lv_disp_flush_ready(drv);
+    }
+}
+
+static void round_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    flush_area(drv, area, color_map);
+}
+
+/* Hand the flush to the worker so LVGL renders into the other frame buffer
+ * while this one is copied out and streamed */
+static void bounce_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    flush_job_t job = {
+        .drv = drv,
+        .area = *area,
+        .color_map = color_map,
+    };
+    xQueueSend(flush_queue, &job, portMAX_DELAY);
+}
+
+static void flush_worker_task(void *arg)
+{
+    flush_job_t job;
+    while (1)
+    {
+        if (xQueueReceive(flush_queue, &job, portMAX_DELAY) == pdTRUE)
+        {
+            flush_area(job.drv, &job.area, job.color_map);
+        }
+    }
+}
+
+static esp_err_t bounce_init(int diameter, int priority, int core)
+{
+    size_t buf_bytes = (size_t)ROUND_PANEL_BAND_ROWS * diameter * sizeof(lv_color_t);
+    for (int i = 0; i < 2; i++)
+    {
+        bounce_buf[i] = heap_caps_malloc(buf_bytes, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if (bounce_buf[i] == NULL)
+        {
+            ESP_LOGE(TAG, "No DMA memory for bounce buffer (%u bytes)", (unsigned)buf_bytes);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    internal_bytes += 2 * buf_bytes;
+
+    flush_queue = xQueueCreate(1, sizeof(flush_job_t));
+    SemaphoreHandle_t sem = xSemaphoreCreateCounting(2, 2);
+    if (flush_queue == NULL || sem == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreatePinnedToCore(flush_worker_task, "lcd_flush", FLUSH_WORKER_STACK, NULL, priority, NULL, core) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    bounce_free = sem;
+    return ESP_OK;
+}
+
+esp_err_t round_panel_attach(lv_disp_t *disp, esp_lcd_panel_io_handle_t io,
+                             esp_lcd_panel_handle_t panel, const round_panel_config_t *config)
+{
+    const int diameter = config->diameter;
+
+    row_x1 = malloc(diameter * sizeof(int16_t));
+    row_x2 = malloc(diameter * sizeof(int16_t));
+    if (row_x1 == NULL || row_x2 == NULL)
+    {
+        free(row_x1);
+        free(row_x2);
+        row_x1 = row_x2 = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    internal_bytes = 2 * diameter * sizeof(int16_t);
+
+    /* Keep every pixel the disc touches, even partially; without trimming
+     * every row spans the full width */
+    const float r = diameter / 2.0f;
+    uint32_t visible = 0;
+    for (int y = 0; y < diameter; y++)
+    {
+        float dy = fabsf(y + 0.5f - r) - 0.5f;
+        float half = dy < r ? sqrtf(r * r - dy * dy) : 0.0f;
+        int x1 = config->trim_to_disc ? (int)floorf(r - half) : 0;
+        int x2 = config->trim_to_disc ? (int)ceilf(r + half) - 1 : diameter - 1;
+        row_x1[y] = x1 < 0 ? 0 : x1;
+        row_x2[y] = x2 > diameter - 1 ? diameter - 1 : x2;
+        visible += row_x2[y] - row_x1[y] + 1;
+    }
+
+    panel_handle = panel;
+    disp_drv = disp->driver;
+    panel_size = diameter;
+
+    /* Bands only pay off when they trim or have to fit a bounce buffer */
+    band_rows = (config->trim_to_disc || config->bounce) ? ROUND_PANEL_BAND_ROWS : diameter;
+
+    if (config->bounce)
+    {
+        esp_err_t err = bounce_init(diameter, config->worker_priority, config->worker_core);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+
+    const esp_lcd_panel_io_callbacks_t cbs = {
+        .on_color_trans_done = color_trans_done_cb,
+    };
+    esp_err_t err = esp_lcd_panel_io_register_event_callbacks(io, &cbs, disp_drv);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to register color-done callback: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    disp_drv->flush_cb = config->bounce ? bounce_flush_cb : round_flush_cb;
+    disp_drv->rounder_cb = config->trim_to_disc ? round_rounder_cb : NULL;
+
+    ESP_LOGI(TAG, "Flush path: %s%s, %lu of %lu pixels sent (%lu%%), %u bytes internal RAM",
+             config->trim_to_disc ? "disc-trimmed" : "full-width",
+             config->bounce ? " via PSRAM bounce" : "",
+             (unsigned long)visible, (unsigned long)(diameter * diameter),
+             (unsigned long)(visible * 100 / (diameter * diameter)), (unsigned)internal_bytes);
+    return ESP_OK;
+}
+
+size_t round_panel_internal_bytes(void)
+{
+    return internal_bytes;
+}
+
+void round_panel_get_stats(round_panel_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,75 @@
+/*
+ * Round Panel Flush
+ * Trims LVGL renders and SPI flushes to the visible disc of a round panel
+ * (GC9A01), skipping corner pixels that can never be seen, and streams
+ * PSRAM frame buffers through small internal DMA bounce buffers
+ */
+
+#ifndef ROUND_PANEL_H
+#define ROUND_PANEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_panel_ops.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Rows sent per SPI window; the window is the widest visible span in the band */
+#define ROUND_PANEL_BAND_ROWS 8
+
+    typedef struct
+    {
+        int diameter;        /* Panel resolution (square, disc touches all edges) */
+        bool trim_to_disc;   /* Skip pixels outside the visible disc */
+        bool bounce;         /* LVGL buffers live in PSRAM: copy bands through internal
+                              * DMA bounce buffers from a flush worker task */
+        int worker_priority; /* Flush worker priority when bounce is set */
+        int worker_core;     /* Flush worker core, or tskNO_AFFINITY */
+    } round_panel_config_t;
+
+    typedef struct
+    {
+        uint64_t bytes_sent;    /* Pixel bytes pushed over SPI */
+        uint64_t bytes_skipped; /* Pixel bytes trimmed away outside the disc */
+        uint32_t flushes;       /* flush_cb calls */
+        uint32_t dropped;       /* Flushes entirely outside the disc */
+        uint32_t transfers;     /* draw_bitmap windows issued */
+        uint32_t bounce_waits;  /* Bands that waited for a free bounce buffer */
+        uint32_t flush_us;      /* Summed flush_cb-to-last-DMA time; wraps, use deltas */
+    } round_panel_stats_t;
+
+    /**
+     * @brief Take over the flush (and rounder) callbacks of an esp_lvgl_port display
+     *
+     * Must be called right after lvgl_port_add_disp(), with the LVGL port
+     * lock held. Replaces the panel IO color-done callback as well.
+     *
+     * @param disp Display returned by lvgl_port_add_disp()
+     * @param io Panel IO used by the display
+     * @param panel Panel used by the display
+     * @param config Panel geometry and flush mode
+     */
+    esp_err_t round_panel_attach(lv_disp_t *disp, esp_lcd_panel_io_handle_t io,
+                                 esp_lcd_panel_handle_t panel, const round_panel_config_t *config);
+
+    /**
+     * @brief Internal RAM used by the flush path (bounce buffers and span tables)
+     */
+    size_t round_panel_internal_bytes(void);
+
+    /**
+     * @brief Copy the flush statistics
+     */
+    void round_panel_get_stats(round_panel_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ROUND_PANEL_H */
@@ -0,0 +1,135 @@
+/*
+ * Sale Batching
+ * Coalesces sales that arrive while an animation is playing into a single
+ * pending batch, so bursts are celebrated once instead of being dropped
+ */
+
+#include "sale_batch.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <string.h>
+#include <strings.h>
+
+static portMUX_TYPE batch_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t batch_ready = NULL;
+static sale_batch_t pending;
+static sale_batch_stats_t stats;
+static int64_t hold_until_us = 0;
+
+void sale_batch_init(void)
+{
+    if (batch_ready == NULL)
+    {
+        batch_ready = xSemaphoreCreateBinary();
+    }
+}
+
+/* Caller holds batch_lock */
+static void merge_locked(const sale_event_t *event)
+{
+    pending.count++;
+    strncpy(pending.last_event_id, event->event_id, sizeof(pending.last_event_id) - 1);
+    pending.last_event_id[sizeof(pending.last_event_id) - 1] = '\0';
+
+    for (int i = 0; i < pending.num_currencies; i++)
+    {
+        if (strcasecmp(pending.totals[i].currency, event->currency) == 0)
+        {
+            pending.totals[i].amount += event->amount;
+            pending.totals[i].count++;
+            return;
+        }
+    }
+
+    if (pending.num_currencies < SALE_BATCH_MAX_CURRENCIES)
+    {
+        sale_batch_total_t *t = &pending.totals[pending.num_currencies++];
+        strncpy(t->currency, event->currency, sizeof(t->currency) - 1);
+        t->currency[sizeof(t->currency) - 1] = '\0';
+        t->amount = event->amount;
+        t->count = 1;
+        return;
+    }
+
+    stats.currency_overflow++;
+}
+
+void sale_batch_add(const sale_event_t *event, const sale_trace_t *trace)
+{
+    int64_t now = sale_trace_now();
+
+    taskENTER_CRITICAL(&batch_lock);
+    stats.received++;
+    if (pending.count > 0)
+    {
+        stats.merged++;
+    }
+    else
+    {
+        pending.trace = *trace;
+        pending.trace.enqueued_us = now;
+    }
+    merge_locked(event);
+    taskEXIT_CRITICAL(&batch_lock);
+
+    xSemaphoreGive(batch_ready);
+}
+
+void sale_batch_hold(uint32_t ms)
+{
+    int64_t until = sale_trace_now() + (int64_t)ms * 1000;
+    taskENTER_CRITICAL(&batch_lock);
+    if (until > hold_until_us)
+    {
+        hold_until_us = until;
+    }
+    taskEXIT_CRITICAL(&batch_lock);
+}
+
+bool sale_batch_take(sale_batch_t *out, TickType_t wait)
+{
+    if (xSemaphoreTake(batch_ready, wait) != pdTRUE)
+    {
+        return false;
+    }
+
+    /* Let the rest of a replayed backlog merge before celebrating */
+    bool held = false;
+    while (1)
+    {
+        taskENTER_CRITICAL(&batch_lock);
+        int64_t remaining_us = hold_until_us - sale_trace_now();
+        taskEXIT_CRITICAL(&batch_lock);
+        if (remaining_us <= 0)
+        {
+            break;
+        }
+        held = true;
+        vTaskDelay(pdMS_TO_TICKS(remaining_us / 1000) + 1);
+    }
+
+    bool have_batch = false;
+    taskENTER_CRITICAL(&batch_lock);
+    if (pending.count > 0)
+    {
+        *out = pending;
+        memset(&pending, 0, sizeof(pending));
+        stats.batches++;
+        stats.held += held;
+        have_batch = true;
+    }
+    taskEXIT_CRITICAL(&batch_lock);
+
+    if (have_batch)
+    {
+        out->trace.dequeued_us = sale_trace_now();
+    }
+    return have_batch;
+}
+
+void sale_batch_get_stats(sale_batch_stats_t *out)
+{
+    taskENTER_CRITICAL(&batch_lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&batch_lock);
+}
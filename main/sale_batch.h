@@ -0,0 +1,93 @@
+/*
+ * Sale Batching
+ * Coalesces sales that arrive while an animation is playing into a single
+ * pending batch, so bursts are celebrated once instead of being dropped
+ */
+
+#ifndef SALE_BATCH_H
+#define SALE_BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "sale_parser.h"
+#include "sale_trace.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Distinct currencies tracked per batch; extra currencies still count as sales */
+#define SALE_BATCH_MAX_CURRENCIES 4
+
+    typedef struct
+    {
+        char currency[8];
+        int64_t amount; /* Sum in minor units */
+        uint32_t count;
+    } sale_batch_total_t;
+
+    /**
+     * @brief Everything that arrived since the last animation started
+     */
+    typedef struct
+    {
+        uint32_t count; /* Sales in this batch */
+        uint8_t num_currencies;
+        sale_batch_total_t totals[SALE_BATCH_MAX_CURRENCIES];
+        char last_event_id[64];
+        sale_trace_t trace; /* Oldest sale in the batch: the worst-case latency */
+    } sale_batch_t;
+
+    typedef struct
+    {
+        uint32_t received;          /* Sales handed to sale_batch_add() */
+        uint32_t merged;            /* ...that joined an already pending batch */
+        uint32_t batches;           /* Batches taken by the animation task */
+        uint32_t held;              /* Takes that waited out a hold */
+        uint32_t currency_overflow; /* Sales counted without their amount (too many currencies) */
+    } sale_batch_stats_t;
+
+    /**
+     * @brief Create the batch state; call once before use
+     */
+    void sale_batch_init(void);
+
+    /**
+     * @brief Merge a sale into the pending batch
+     *
+     * Never blocks and never drops the sale; safe to call from the MQTT task.
+     *
+     * @param trace Latency trace of the sale; stamped as enqueued here
+     */
+    void sale_batch_add(const sale_event_t *event, const sale_trace_t *trace);
+
+    /**
+     * @brief Keep the pending batch back for @p ms so a known burst lands in it
+     *
+     * Used while the broker replays sales queued during a disconnect. A
+     * later call extends the hold; it never shortens it.
+     */
+    void sale_batch_hold(uint32_t ms);
+
+    /**
+     * @brief Take the pending batch, waiting up to @p wait ticks for one
+     *
+     * The batch trace is stamped as dequeued. While a hold is active the
+     * call also sleeps until it ends.
+     *
+     * @return true if @p out was filled
+     */
+    bool sale_batch_take(sale_batch_t *out, TickType_t wait);
+
+    /**
+     * @brief Copy the batching counters
+     */
+    void sale_batch_get_stats(sale_batch_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALE_BATCH_H */
@@ -0,0 +1,107 @@
+/*
+ * Sale Deduplication
+ * Remembers the most recent sale eventIds in a fixed ring of hashes with an
+ * open-addressing index, so redelivered and retried sales are rejected in
+ * constant time without allocating
+ */
+
+#include "sale_dedup.h"
+
+#define INDEX_MASK (SALE_DEDUP_INDEX - 1)
+
+_Static_assert((SALE_DEDUP_INDEX & INDEX_MASK) == 0, "SALE_DEDUP_INDEX must be a power of two");
+_Static_assert(SALE_DEDUP_SIZE < 255, "Ring slots must fit the uint8_t index");
+
+uint64_t sale_dedup_hash(const char *event_id)
+{
+    if (event_id == NULL || event_id[0] == '\0')
+    {
+        return 0;
+    }
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const char *s = event_id; *s; s++)
+    {
+        h ^= (uint8_t)*s;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint32_t home_of(uint64_t h)
+{
+    return (uint32_t)(h ^ (h >> 32)) & INDEX_MASK;
+}
+
+/* Index position holding @p h, or -1 */
+static int find(const sale_dedup_t *d, uint64_t h)
+{
+    for (uint32_t i = home_of(h), n = 0; n < SALE_DEDUP_INDEX && d->index[i]; i = (i + 1) & INDEX_MASK, n++)
+    {
+        if (d->ring[d->index[i] - 1] == h)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/* Backward-shift delete: keeps every probe chain intact without tombstones */
+static void unindex(sale_dedup_t *d, uint32_t hole)
+{
+    for (uint32_t k = (hole + 1) & INDEX_MASK; d->index[k]; k = (k + 1) & INDEX_MASK)
+    {
+        uint32_t home = home_of(d->ring[d->index[k] - 1]);
+        /* The entry at k may fill the hole unless its home lies in (hole, k] */
+        bool stays = hole <= k ? (home > hole && home <= k) : (home > hole || home <= k);
+        if (!stays)
+        {
+            d->index[hole] = d->index[k];
+            hole = k;
+        }
+    }
+    d->index[hole] = 0;
+}
+
+bool sale_dedup_seen_hash(sale_dedup_t *d, uint64_t h)
+{
+    if (h == 0)
+    {
+        return false;
+    }
+
+    if (find(d, h) >= 0)
+    {
+        d->duplicates++;
+        return true;
+    }
+
+    uint16_t slot = d->head;
+    if (d->count == SALE_DEDUP_SIZE)
+    {
+        /* Forget the oldest to make room */
+        int old = find(d, d->ring[slot]);
+        if (old >= 0)
+        {
+            unindex(d, (uint32_t)old);
+        }
+    }
+    else
+    {
+        d->count++;
+    }
+
+    d->ring[slot] = h;
+    uint32_t i = home_of(h);
+    while (d->index[i])
+    {
+        i = (i + 1) & INDEX_MASK;
+    }
+    d->index[i] = (uint8_t)(slot + 1);
+    d->head = (uint16_t)((slot + 1) % SALE_DEDUP_SIZE);
+    return false;
+}
+
+bool sale_dedup_seen(sale_dedup_t *d, const char *event_id)
+{
+    return sale_dedup_seen_hash(d, sale_dedup_hash(event_id));
+}
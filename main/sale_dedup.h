@@ -0,0 +1,61 @@
+/*
+ * Sale Deduplication
+ * Remembers the most recent sale eventIds in a fixed ring of hashes with an
+ * open-addressing index, so redelivered and retried sales are rejected in
+ * constant time without allocating
+ */
+
+#ifndef SALE_DEDUP_H
+#define SALE_DEDUP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* eventIds remembered; the oldest is forgotten first */
+#define SALE_DEDUP_SIZE 64
+/* Index slots (power of two, twice the ring to keep probe chains short) */
+#define SALE_DEDUP_INDEX (2 * SALE_DEDUP_SIZE)
+
+    typedef struct
+    {
+        uint64_t ring[SALE_DEDUP_SIZE];  /* 64-bit FNV-1a of each eventId */
+        uint8_t index[SALE_DEDUP_INDEX]; /* Ring slot + 1, 0 when empty */
+        uint16_t head;                   /* Next ring slot to write */
+        uint16_t count;
+        uint32_t duplicates; /* Sales rejected as already seen */
+    } sale_dedup_t;
+
+    /**
+     * @brief FNV-1a 64 of an eventId; 0 for an empty id
+     *
+     * The binary sale record carries this value, so ids seen on either
+     * topic collide as they should.
+     */
+    uint64_t sale_dedup_hash(const char *event_id);
+
+    /**
+     * @brief Check a hashed eventId against recent sales and remember it
+     *
+     * Not thread-safe; each state is owned by one task. A zero hash (no id)
+     * is never a duplicate and is not remembered.
+     *
+     * @return true if the id was seen among the last SALE_DEDUP_SIZE sales
+     */
+    bool sale_dedup_seen_hash(sale_dedup_t *d, uint64_t hash);
+
+    /**
+     * @brief sale_dedup_seen_hash() on sale_dedup_hash(@p event_id)
+     */
+    bool sale_dedup_seen(sale_dedup_t *d, const char *event_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALE_DEDUP_H */
@@ -0,0 +1,716 @@
+/*
+ * Sale Message Parser
+ * Allocation-free extractor for sale command payloads and reassembly of
+ * fragmented MQTT messages into a bounded buffer
+ */
+
+#include "sale_parser.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define KEY_MAX_LEN 16
+#define NUMBER_MAX_LEN 64 /* cJSON's parse buffer */
+/* Deepest nesting skip_value() tracks; a message cannot close more */
+#define NEST_MAX (SALE_MSG_MAX_LEN / 2)
+
+/* FNV-1a 64, as sale_dedup_hash() and binary publishers apply it */
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+typedef struct
+{
+    const char *p;
+    const char *end;
+} cursor_t;
+
+static void skip_ws(cursor_t *c)
+{
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\n' || *c->p == '\r'))
+    {
+        c->p++;
+    }
+}
+
+static bool consume(cursor_t *c, char ch)
+{
+    skip_ws(c);
+    if (c->p < c->end && *c->p == ch)
+    {
+        c->p++;
+        return true;
+    }
+    return false;
+}
+
+static int hex_value(char ch)
+{
+    if (ch >= '0' && ch <= '9')
+        return ch - '0';
+    if (ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F')
+        return ch - 'A' + 10;
+    return -1;
+}
+
+/* Where a decoded string goes: a bounded field, and optionally the hash of
+ * every byte, so a truncated field still identifies the whole string */
+typedef struct
+{
+    char *out; /* NULL to only skip */
+    size_t size;
+    size_t pos;
+    size_t len; /* Bytes decoded, stored or not */
+    bool truncated;
+    uint64_t *hash; /* May be NULL */
+} sink_t;
+
+/* Append a byte if there is room, always leaving space for the terminator */
+static void put_char(sink_t *s, char ch)
+{
+    s->len++;
+    if (s->hash != NULL)
+    {
+        *s->hash = (*s->hash ^ (uint8_t)ch) * FNV_PRIME;
+    }
+    if (s->out == NULL)
+    {
+        return;
+    }
+    if (s->pos + 1 < s->size)
+    {
+        s->out[s->pos++] = ch;
+    }
+    else
+    {
+        s->truncated = true;
+    }
+}
+
+/*
+ * Parse a string starting at the opening quote into a sink. Escapes are
+ * decoded; \uXXXX is emitted as UTF-8 and surrogate pairs are replaced by
+ * '?'. The hash, when asked for, is FNV-1a over the decoded bytes, 0 for an
+ * empty string.
+ */
+static bool parse_string_to(cursor_t *c, sink_t *s)
+{
+    if (s->hash != NULL)
+    {
+        *s->hash = FNV_OFFSET;
+    }
+    if (c->p >= c->end || *c->p != '"')
+    {
+        return false;
+    }
+    c->p++;
+
+    while (c->p < c->end)
+    {
+        char ch = *c->p++;
+        if (ch == '"')
+        {
+            if (s->out != NULL)
+            {
+                s->out[s->pos] = '\0';
+            }
+            if (s->hash != NULL && s->len == 0)
+            {
+                *s->hash = 0; /* No bytes, no id */
+            }
+            return true;
+        }
+        if ((unsigned char)ch < 0x20)
+        {
+            return false; /* Control characters must be escaped */
+        }
+        if (ch != '\\')
+        {
+            put_char(s, ch);
+            continue;
+        }
+
+        if (c->p >= c->end)
+        {
+            return false;
+        }
+        char esc = *c->p++;
+        switch (esc)
+        {
+        case '"':
+        case '\\':
+        case '/':
+            put_char(s, esc);
+            break;
+        case 'b':
+            put_char(s, '\b');
+            break;
+        case 'f':
+            put_char(s, '\f');
+            break;
+        case 'n':
+            put_char(s, '\n');
+            break;
+        case 'r':
+            put_char(s, '\r');
+            break;
+        case 't':
+            put_char(s, '\t');
+            break;
+        case 'u':
+        {
+            if (c->end - c->p < 4)
+            {
+                return false;
+            }
+            uint32_t cp = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                int v = hex_value(c->p[i]);
+                if (v < 0)
+                {
+                    return false;
+                }
+                cp = (cp << 4) | (uint32_t)v;
+            }
+            c->p += 4;
+
+            if (cp >= 0xD800 && cp <= 0xDFFF)
+            {
+                put_char(s, '?');
+            }
+            else if (cp < 0x80)
+            {
+                put_char(s, (char)cp);
+            }
+            else if (cp < 0x800)
+            {
+                put_char(s, (char)(0xC0 | (cp >> 6)));
+                put_char(s, (char)(0x80 | (cp & 0x3F)));
+            }
+            else
+            {
+                put_char(s, (char)(0xE0 | (cp >> 12)));
+                put_char(s, (char)(0x80 | ((cp >> 6) & 0x3F)));
+                put_char(s, (char)(0x80 | (cp & 0x3F)));
+            }
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return false; /* Unterminated */
+}
+
+/* With out == NULL the string is only skipped */
+static bool parse_string(cursor_t *c, char *out, size_t out_size, bool *truncated)
+{
+    sink_t s = {.out = out, .size = out_size};
+    if (!parse_string_to(c, &s))
+    {
+        return false;
+    }
+    if (truncated != NULL)
+    {
+        *truncated = s.truncated;
+    }
+    return true;
+}
+
+static bool is_number_char(char ch)
+{
+    return (ch >= '0' && ch <= '9') || ch == '-' || ch == '+' || ch == '.' || ch == 'e' || ch == 'E';
+}
+
+/* Parse a number, truncated towards zero and clamped to int64 */
+static bool parse_number64(cursor_t *c, int64_t *out)
+{
+    const char *start = c->p;
+    bool simple = true;
+    while (c->p < c->end && is_number_char(*c->p))
+    {
+        if (!((*c->p >= '0' && *c->p <= '9') || (*c->p == '-' && c->p == start)))
+        {
+            simple = false;
+        }
+        c->p++;
+    }
+
+    size_t len = (size_t)(c->p - start);
+    if (len == 0 || (len == 1 && *start == '-'))
+    {
+        return false;
+    }
+
+    if (simple)
+    {
+        /* Integer fast path: the common case for amounts and timestamps */
+        bool negative = (*start == '-');
+        int64_t value = 0;
+        for (const char *d = start + (negative ? 1 : 0); d < c->p; d++)
+        {
+            if (value > (INT64_MAX - 9) / 10)
+            {
+                value = INT64_MAX;
+                break;
+            }
+            value = value * 10 + (*d - '0');
+        }
+        *out = negative ? -value : value;
+        return true;
+    }
+
+    if (len >= NUMBER_MAX_LEN)
+    {
+        return false;
+    }
+    char tmp[NUMBER_MAX_LEN];
+    memcpy(tmp, start, len);
+    tmp[len] = '\0';
+    char *endp;
+    double d = strtod(tmp, &endp);
+    if (endp != tmp + len)
+    {
+        return false;
+    }
+    *out = d >= 9.2e18 ? INT64_MAX : (d <= -9.2e18 ? -INT64_MAX : (int64_t)d);
+    return true;
+}
+
+/* Same, clamped to int32 like (int32_t)valuedouble */
+static bool parse_number(cursor_t *c, int32_t *out)
+{
+    int64_t value;
+    if (!parse_number64(c, &value))
+    {
+        return false;
+    }
+    *out = value > INT32_MAX ? INT32_MAX : (value < INT32_MIN ? INT32_MIN : (int32_t)value);
+    return true;
+}
+
+static bool match_literal(cursor_t *c, const char *lit)
+{
+    size_t n = strlen(lit);
+    if ((size_t)(c->end - c->p) < n || memcmp(c->p, lit, n) != 0)
+    {
+        return false;
+    }
+    c->p += n;
+    return true;
+}
+
+/* Skip any JSON value. Containers are walked iteratively by depth. */
+static bool skip_value(cursor_t *c)
+{
+    skip_ws(c);
+    if (c->p >= c->end)
+    {
+        return false;
+    }
+
+    char ch = *c->p;
+    if (ch == '"')
+    {
+        return parse_string(c, NULL, 0, NULL);
+    }
+    if (ch == 't')
+    {
+        return match_literal(c, "true");
+    }
+    if (ch == 'f')
+    {
+        return match_literal(c, "false");
+    }
+    if (ch == 'n')
+    {
+        return match_literal(c, "null");
+    }
+    if (ch == '-' || (ch >= '0' && ch <= '9'))
+    {
+        int32_t ignored;
+        return parse_number(c, &ignored);
+    }
+    if (ch != '{' && ch != '[')
+    {
+        return false;
+    }
+
+    /* One bit per open container, set for an object, so "[}" is rejected */
+    uint8_t objects[NEST_MAX / 8];
+    int depth = 0;
+    while (c->p < c->end)
+    {
+        ch = *c->p;
+        if (ch == '"')
+        {
+            if (!parse_string(c, NULL, 0, NULL))
+            {
+                return false;
+            }
+            continue;
+        }
+        c->p++;
+        if (ch == '{' || ch == '[')
+        {
+            if (depth == NEST_MAX)
+            {
+                return false;
+            }
+            if (ch == '{')
+            {
+                objects[depth / 8] |= (uint8_t)(1u << (depth % 8));
+            }
+            else
+            {
+                objects[depth / 8] &= (uint8_t)~(1u << (depth % 8));
+            }
+            depth++;
+        }
+        else if (ch == '}' || ch == ']')
+        {
+            depth--;
+            bool object = objects[depth / 8] & (1u << (depth % 8));
+            if (object != (ch == '}'))
+            {
+                return false;
+            }
+            if (depth == 0)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* String member into a fixed field, truncated to fit; non-strings are
+ * skipped and reported. @p hash (may be NULL) gets the whole string's. */
+static bool parse_string_member(cursor_t *c, char *out, size_t out_size, bool *is_string, uint64_t *hash)
+{
+    skip_ws(c);
+    *is_string = (c->p < c->end && *c->p == '"');
+    if (!*is_string)
+    {
+        return skip_value(c);
+    }
+    sink_t s = {.out = out, .size = out_size, .hash = hash};
+    return parse_string_to(c, &s);
+}
+
+enum
+{
+    SEEN_TYPE = 1 << 0,
+    SEEN_STATUS = 1 << 1,
+    SEEN_AMOUNT = 1 << 2,
+    SEEN_CURRENCY = 1 << 3,
+    SEEN_EVENT_ID = 1 << 4,
+    SEEN_TS = 1 << 5,
+};
+
+sale_parse_result_t sale_parse_json(const char *json, size_t len, sale_event_t *event)
+{
+    cursor_t c = {.p = json, .end = json + len};
+    char status[KEY_MAX_LEN] = {0};
+    bool type_is_string = false;
+    bool status_is_string = false;
+    unsigned seen = 0;
+
+    memset(event, 0, sizeof(*event));
+
+    if (!consume(&c, '{'))
+    {
+        return SALE_PARSE_MALFORMED;
+    }
+
+    if (!consume(&c, '}'))
+    {
+        do
+        {
+            char key[KEY_MAX_LEN];
+            bool key_truncated = false;
+            skip_ws(&c);
+            if (!parse_string(&c, key, sizeof(key), &key_truncated) || !consume(&c, ':'))
+            {
+                goto malformed;
+            }
+            if (key_truncated)
+            {
+                key[0] = '\0'; /* Longer than any key we care about */
+            }
+
+            /* First occurrence wins, matching cJSON_GetObjectItem */
+            bool ok;
+            bool is_string;
+            if (!(seen & SEEN_TYPE) && strcasecmp(key, "type") == 0)
+            {
+                ok = parse_string_member(&c, event->type, sizeof(event->type), &type_is_string, NULL);
+                seen |= SEEN_TYPE;
+            }
+            else if (!(seen & SEEN_STATUS) && strcasecmp(key, "status") == 0)
+            {
+                ok = parse_string_member(&c, status, sizeof(status), &status_is_string, NULL);
+                seen |= SEEN_STATUS;
+            }
+            else if (!(seen & SEEN_AMOUNT) && strcasecmp(key, "amount") == 0)
+            {
+                skip_ws(&c);
+                if (c.p < c.end && (*c.p == '-' || (*c.p >= '0' && *c.p <= '9')))
+                {
+                    ok = parse_number(&c, &event->amount);
+                }
+                else
+                {
+                    ok = skip_value(&c);
+                }
+                seen |= SEEN_AMOUNT;
+            }
+            else if (!(seen & SEEN_CURRENCY) && strcasecmp(key, "currency") == 0)
+            {
+                ok = parse_string_member(&c, event->currency, sizeof(event->currency), &is_string, NULL);
+                seen |= SEEN_CURRENCY;
+            }
+            else if (!(seen & SEEN_EVENT_ID) && strcasecmp(key, "eventId") == 0)
+            {
+                /* Dedup goes by the hash: ids longer than event_id still
+                 * tell apart, and match the binary record's */
+                ok = parse_string_member(&c, event->event_id, sizeof(event->event_id), &is_string,
+                                         &event->event_hash);
+                seen |= SEEN_EVENT_ID;
+            }
+            else if (!(seen & SEEN_TS) && strcasecmp(key, "ts") == 0)
+            {
+                skip_ws(&c);
+                if (c.p < c.end && *c.p >= '0' && *c.p <= '9')
+                {
+                    ok = parse_number64(&c, &event->origin_ms);
+                }
+                else
+                {
+                    ok = skip_value(&c);
+                }
+                seen |= SEEN_TS;
+            }
+            else
+            {
+                ok = skip_value(&c);
+            }
+
+            if (!ok)
+            {
+                goto malformed;
+            }
+        } while (consume(&c, ','));
+
+        if (!consume(&c, '}'))
+        {
+            goto malformed;
+        }
+    }
+
+    /* Sale with succeeded status (a missing or non-string status counts as succeeded) */
+    if (type_is_string && strcmp(event->type, "sale") == 0 &&
+        (!status_is_string || strcmp(status, "succeeded") == 0))
+    {
+        return SALE_PARSE_OK;
+    }
+    return SALE_PARSE_IGNORED;
+
+malformed:
+    memset(event, 0, sizeof(*event));
+    return SALE_PARSE_MALFORMED;
+}
+
+/* Leave @p c at the value of the first top-level member named @p key */
+static bool seek_member(cursor_t *c, const char *key)
+{
+    if (!consume(c, '{') || consume(c, '}'))
+    {
+        return false;
+    }
+    do
+    {
+        char name[KEY_MAX_LEN];
+        bool truncated = false;
+        skip_ws(c);
+        if (!parse_string(c, name, sizeof(name), &truncated) || !consume(c, ':'))
+        {
+            return false;
+        }
+        if (!truncated && strcasecmp(name, key) == 0)
+        {
+            skip_ws(c);
+            return true;
+        }
+        if (!skip_value(c))
+        {
+            return false;
+        }
+    } while (consume(c, ','));
+    return false;
+}
+
+bool sale_json_get_string(const char *json, size_t len, const char *key, char *out, size_t out_size)
+{
+    cursor_t c = {.p = json, .end = json + len};
+    bool truncated = false;
+    return seek_member(&c, key) && c.p < c.end && *c.p == '"' &&
+           parse_string(&c, out, out_size, &truncated) && !truncated;
+}
+
+bool sale_json_get_int(const char *json, size_t len, const char *key, int64_t *out)
+{
+    cursor_t c = {.p = json, .end = json + len};
+    return seek_member(&c, key) && c.p < c.end && (*c.p == '-' || (*c.p >= '0' && *c.p <= '9')) &&
+           parse_number64(&c, out);
+}
+
+bool sale_json_get_bool(const char *json, size_t len, const char *key, bool *out)
+{
+    cursor_t c = {.p = json, .end = json + len};
+    if (!seek_member(&c, key))
+    {
+        return false;
+    }
+    if (match_literal(&c, "true"))
+    {
+        *out = true;
+        return true;
+    }
+    if (match_literal(&c, "false"))
+    {
+        *out = false;
+        return true;
+    }
+    return false;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_le64(const uint8_t *p)
+{
+    return (uint64_t)get_le32(p) | (uint64_t)get_le32(p + 4) << 32;
+}
+
+sale_parse_result_t sale_parse_binary(const uint8_t *data, size_t len, sale_event_t *event)
+{
+    memset(event, 0, sizeof(*event));
+    if (len < SALE_BIN_LEN || data[0] != SALE_BIN_VERSION)
+    {
+        return SALE_PARSE_MALFORMED;
+    }
+
+    /* Letters, or all NUL for no currency */
+    const uint8_t *cur = data + 8;
+    if (cur[0] != 0)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            uint8_t ch = cur[i] | 0x20; /* Lowercase, as JSON senders use */
+            if (ch < 'a' || ch > 'z')
+            {
+                return SALE_PARSE_MALFORMED;
+            }
+            event->currency[i] = (char)ch;
+        }
+    }
+    else if (cur[1] != 0 || cur[2] != 0)
+    {
+        return SALE_PARSE_MALFORMED;
+    }
+
+    event->amount = (int32_t)get_le32(data + 4);
+    event->event_hash = get_le64(data + 12);
+    event->origin_ms = (int64_t)get_le64(data + 20);
+    if (event->origin_ms < 0)
+    {
+        event->origin_ms = 0;
+    }
+    if (event->event_hash)
+    {
+        /* Readable id for logs and last_event_id */
+        static const char hex[] = "0123456789abcdef";
+        for (int i = 0; i < 16; i++)
+        {
+            event->event_id[i] = hex[(event->event_hash >> (60 - 4 * i)) & 0xF];
+        }
+    }
+
+    switch (data[1])
+    {
+    case SALE_BIN_TYPE_SALE:
+        strcpy(event->type, "sale");
+        return data[2] == SALE_BIN_STATUS_SUCCEEDED ? SALE_PARSE_OK : SALE_PARSE_IGNORED;
+    case SALE_BIN_TYPE_DIAG:
+        strcpy(event->type, "diag");
+        return SALE_PARSE_IGNORED;
+    default:
+        return SALE_PARSE_IGNORED;
+    }
+}
+
+sale_frag_result_t sale_reassembly_feed(sale_reassembly_t *r, const char *data, size_t len,
+                                        size_t offset, size_t total_len,
+                                        const char **msg, size_t *msg_len)
+{
+    if (offset == 0)
+    {
+        /* Start of a new message */
+        r->total = total_len;
+        r->received = 0;
+        r->discarding = false;
+
+        if (total_len > SALE_MSG_MAX_LEN)
+        {
+            r->discarding = true;
+            r->oversize++;
+            return SALE_FRAG_OVERSIZE;
+        }
+
+        if (len == total_len)
+        {
+            /* Unfragmented: hand back the MQTT buffer, no copy */
+            r->messages++;
+            *msg = data;
+            *msg_len = len;
+            return SALE_FRAG_COMPLETE;
+        }
+    }
+    else if (r->discarding)
+    {
+        return SALE_FRAG_DROPPED;
+    }
+    else if (offset != r->received || total_len != r->total)
+    {
+        /* Lost or reordered fragment; the rest of this message is useless */
+        r->discarding = true;
+        r->dropped++;
+        return SALE_FRAG_DROPPED;
+    }
+
+    if (len > r->total - r->received)
+    {
+        r->discarding = true;
+        r->dropped++;
+        return SALE_FRAG_DROPPED;
+    }
+
+    memcpy(r->buf + r->received, data, len);
+    r->received += len;
+    if (r->received < r->total)
+    {
+        return SALE_FRAG_PENDING;
+    }
+
+    r->discarding = true; /* Further chunks need a new offset 0 */
+    r->messages++;
+    r->fragmented++;
+    *msg = r->buf;
+    *msg_len = r->total;
+    return SALE_FRAG_COMPLETE;
+}
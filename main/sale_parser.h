@@ -0,0 +1,168 @@
+/*
+ * Sale Message Parser
+ * Allocation-free extractor for sale command payloads (JSON and the fixed
+ * binary record) and reassembly of fragmented MQTT messages into a bounded
+ * buffer
+ */
+
+#ifndef SALE_PARSER_H
+#define SALE_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Largest payload accepted; anything bigger is dropped before copying */
+#define SALE_MSG_MAX_LEN 1024
+
+/* Longest "type" kept; longer types are truncated and never match */
+#define SALE_TYPE_MAX_LEN 16
+
+/*
+ * Binary sale record, little-endian, SALE_BIN_LEN bytes:
+ *
+ *   0  u8     version (SALE_BIN_VERSION)
+ *   1  u8     type (sale_bin_type_t)
+ *   2  u8     status (sale_bin_status_t)
+ *   3  u8     reserved, 0
+ *   4  i32    amount in minor units
+ *   8  char3  ISO 4217 currency code, NUL-padded if absent
+ *   11 u8     reserved, 0
+ *   12 u64    FNV-1a 64 of the eventId string, 0 if none
+ *   20 i64    publish time in epoch ms, 0 if absent
+ *
+ * Longer payloads with the same version are accepted; the tail is ignored.
+ */
+#define SALE_BIN_VERSION 1
+#define SALE_BIN_LEN 28
+
+    typedef enum
+    {
+        SALE_BIN_TYPE_SALE = 1,
+        SALE_BIN_TYPE_DIAG = 2,
+    } sale_bin_type_t;
+
+    typedef enum
+    {
+        SALE_BIN_STATUS_SUCCEEDED = 0,
+        SALE_BIN_STATUS_PENDING = 1,
+        SALE_BIN_STATUS_FAILED = 2,
+    } sale_bin_status_t;
+
+    /**
+     * @brief A sale to celebrate
+     */
+    typedef struct
+    {
+        int32_t amount;
+        char currency[8];
+        char event_id[64];            /* For display only: truncated, or the hash in hex for binary records */
+        char type[SALE_TYPE_MAX_LEN]; /* Message type, for dispatching other commands */
+        int64_t origin_ms;            /* Optional "ts": publisher epoch ms, 0 if absent */
+        uint64_t event_hash;          /* FNV-1a 64 of the whole eventId, as sale_dedup_hash(); 0 if none */
+    } sale_event_t;
+
+    typedef enum
+    {
+        SALE_PARSE_OK,        /* type "sale" with status "succeeded" (or no status) */
+        SALE_PARSE_IGNORED,   /* Well-formed, but not a successful sale */
+        SALE_PARSE_MALFORMED, /* Not a JSON object */
+    } sale_parse_result_t;
+
+    /**
+     * @brief Extract type/status/amount/currency/eventId/ts from a JSON object
+     *
+     * Single pass over the input, no heap allocation and no NUL terminator
+     * required. Keys are matched case-insensitively, like cJSON_GetObjectItem.
+     * Unknown members, including nested objects and arrays, are skipped.
+     *
+     * @param json Payload bytes
+     * @param len Payload length
+     * @param event Filled on SALE_PARSE_OK/IGNORED, zeroed on SALE_PARSE_MALFORMED
+     */
+    sale_parse_result_t sale_parse_json(const char *json, size_t len, sale_event_t *event);
+
+    /**
+     * @brief Top-level string member of a JSON object (first occurrence, key
+     * matched case-insensitively)
+     *
+     * For the occasional command payload outside the sale fast path; each
+     * call is one pass over @p json.
+     *
+     * @return false if absent, not a string, longer than @p out_size - 1, or
+     *         the object is malformed before it
+     */
+    bool sale_json_get_string(const char *json, size_t len, const char *key, char *out, size_t out_size);
+
+    /**
+     * @brief Top-level number member, truncated and clamped to int64
+     */
+    bool sale_json_get_int(const char *json, size_t len, const char *key, int64_t *out);
+
+    /**
+     * @brief Top-level true/false member
+     */
+    bool sale_json_get_bool(const char *json, size_t len, const char *key, bool *out);
+
+    /**
+     * @brief Decode a binary sale record
+     *
+     * Every field is range-checked; nothing is read past @p len. Type codes
+     * map onto the JSON type names ("sale", "diag") so both paths dispatch
+     * alike.
+     *
+     * @param data Payload bytes
+     * @param len Payload length
+     * @param event Filled on SALE_PARSE_OK/IGNORED, zeroed on SALE_PARSE_MALFORMED
+     *              (short payload, unknown version, bad currency code)
+     */
+    sale_parse_result_t sale_parse_binary(const uint8_t *data, size_t len, sale_event_t *event);
+
+    typedef enum
+    {
+        SALE_FRAG_PENDING,  /* More fragments expected */
+        SALE_FRAG_COMPLETE, /* *msg / *msg_len hold the full payload */
+        SALE_FRAG_OVERSIZE, /* First fragment of a message larger than SALE_MSG_MAX_LEN */
+        SALE_FRAG_DROPPED,  /* Fragment of a discarded or out-of-sequence message */
+    } sale_frag_result_t;
+
+    /**
+     * @brief Reassembly state for one MQTT message stream
+     */
+    typedef struct
+    {
+        char buf[SALE_MSG_MAX_LEN];
+        size_t total;
+        size_t received;
+        bool discarding;
+        uint32_t messages;   /* Complete messages delivered */
+        uint32_t fragmented; /* ...of which needed reassembly */
+        uint32_t oversize;   /* Messages rejected for size */
+        uint32_t dropped;    /* Messages lost to out-of-sequence fragments */
+    } sale_reassembly_t;
+
+    /**
+     * @brief Feed one MQTT_EVENT_DATA chunk
+     *
+     * Unfragmented messages are returned in place without copying. The
+     * returned pointer is valid until the next call.
+     *
+     * @param data Chunk bytes
+     * @param len Chunk length (data_len)
+     * @param offset Offset of this chunk in the message (current_data_offset)
+     * @param total_len Full message length (total_data_len)
+     */
+    sale_frag_result_t sale_reassembly_feed(sale_reassembly_t *r, const char *data, size_t len,
+                                            size_t offset, size_t total_len,
+                                            const char **msg, size_t *msg_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALE_PARSER_H */
@@ -0,0 +1,83 @@
+/*
+ * Sale Router
+ * One MQTT message from payload to batch: parse, scope filter, dedup and
+ * the hand-off, shared by the firmware and the host simulator
+ */
+
+#include "sale_router.h"
+#include "esp_log.h"
+#include "sale_batch.h"
+#include "sale_trace.h"
+
+static const char *TAG = SALE_ROUTER_TAG;
+
+sale_route_t sale_router_handle(const sale_router_t *router, const char *data, size_t len, topic_scope_t scope,
+                                bool binary, sale_event_t *event)
+{
+    sale_trace_t trace;
+    sale_trace_begin(&trace); /* Before the log line, which costs milliseconds on UART */
+
+    /* Parse in place: no copy, no DOM, no heap */
+    sale_parse_result_t result;
+    if (binary)
+    {
+        result = sale_parse_binary((const uint8_t *)data, len, event);
+        trace.parsed_us = sale_trace_now();
+        ESP_LOGI(TAG, "Received binary record (%d bytes): %s %ld %s", (int)len, event->type[0] ? event->type : "?",
+                 (long)event->amount, event->currency);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Received message: %.*s", (int)len, data);
+        result = sale_parse_json(data, len, event);
+        trace.parsed_us = sale_trace_now();
+    }
+    sale_trace_set_origin(&trace, event->origin_ms);
+
+    sale_route_t route;
+    switch (result)
+    {
+    case SALE_PARSE_OK:
+        /* Filter before dedup, so a sale filtered out on a shared topic
+         * still counts when it also arrives on our own */
+        if (!topic_filter_pass(&router->topics->filters[scope], event))
+        {
+            ESP_LOGI(TAG, "Sale filtered out (%s topic)", topic_scope_name(scope));
+            return SALE_ROUTE_FILTERED;
+        }
+        if (sale_dedup_seen_hash(router->dedup, event->event_hash))
+        {
+            ESP_LOGI(TAG, "Duplicate sale %s ignored", event->event_id);
+            return SALE_ROUTE_DUPLICATE;
+        }
+        route = SALE_ROUTE_QUEUED;
+        break;
+    case SALE_PARSE_IGNORED:
+        /* Commands are per device; shared topics only carry sales */
+        return scope == TOPIC_SCOPE_DEVICE ? SALE_ROUTE_COMMAND : SALE_ROUTE_IGNORED;
+    case SALE_PARSE_MALFORMED:
+    default:
+        if (binary)
+        {
+            ESP_LOGW(TAG, "Bad binary record (%d bytes, version %d), dropped", (int)len,
+                     len > 0 ? (uint8_t)data[0] : -1);
+            return SALE_ROUTE_DROPPED;
+        }
+        if (scope != TOPIC_SCOPE_DEVICE)
+        {
+            ESP_LOGW(TAG, "Malformed JSON on %s topic, dropped", topic_scope_name(scope));
+            return SALE_ROUTE_DROPPED;
+        }
+        ESP_LOGW(TAG, "JSON parse failed, triggering animation anyway (MVP tolerance)");
+        route = SALE_ROUTE_TOLERATED; /* MVP: trigger even on parse failure */
+        break;
+    }
+
+    if (!router->dry_run)
+    {
+        /* Merged into the pending batch; bursts become one celebration */
+        sale_trace_record_arrival(&trace);
+        sale_batch_add(event, &trace);
+    }
+    return route;
+}
@@ -0,0 +1,56 @@
+/*
+ * Sale Router
+ * One MQTT message from payload to batch: parse, scope filter, dedup and
+ * the hand-off, shared by the firmware and the host simulator
+ */
+
+#ifndef SALE_ROUTER_H
+#define SALE_ROUTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "sale_dedup.h"
+#include "sale_parser.h"
+#include "topic_config.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Log tag of the message lines, for quieting them */
+#define SALE_ROUTER_TAG "sale_router"
+
+    typedef enum
+    {
+        SALE_ROUTE_QUEUED,    /* New sale, added to the batch */
+        SALE_ROUTE_FILTERED,  /* Sale the topic's scope filter rejected */
+        SALE_ROUTE_DUPLICATE, /* Sale already seen */
+        SALE_ROUTE_COMMAND,   /* Not a sale, on our own topic; event->type names it */
+        SALE_ROUTE_IGNORED,   /* Not a sale, on a shared topic */
+        SALE_ROUTE_DROPPED,   /* Bad binary record, or malformed JSON on a shared topic */
+        SALE_ROUTE_TOLERATED, /* Malformed JSON on our own topic, queued anyway (MVP tolerance) */
+    } sale_route_t;
+
+    typedef struct
+    {
+        const topic_config_t *topics; /* Filters per scope */
+        sale_dedup_t *dedup;
+        bool dry_run; /* Decide only: nothing reaches the batch */
+    } sale_router_t;
+
+    /**
+     * @brief Parse one message and route it, queueing a new sale
+     *
+     * Traces the sale from here, so call it as soon as the message is
+     * complete. Commands are left to the caller; event is filled whatever
+     * the route.
+     */
+    sale_route_t sale_router_handle(const sale_router_t *router, const char *data, size_t len, topic_scope_t scope,
+                                    bool binary, sale_event_t *event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALE_ROUTER_H */
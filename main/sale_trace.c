@@ -0,0 +1,167 @@
+/*
+ * Sale Latency Tracing
+ * Monotonic timestamps for each stage between a sale's publication and its
+ * first rendered frame, aggregated into fixed-bucket latency histograms
+ */
+
+#include "sale_trace.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+/* Wall clock must be past this (2016-01-01) before network latency is trusted */
+#define TRACE_VALID_EPOCH_MS 1451606400000LL
+
+typedef struct
+{
+    uint32_t count;
+    uint64_t sum_us;
+    uint32_t max_us;
+    uint32_t buckets[SALE_TRACE_BUCKETS];
+} histogram_t;
+
+static const uint32_t bucket_edges[SALE_TRACE_BUCKETS - 1] = {
+    1000, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2000000, 5000000,
+};
+static const char *const stage_names[SALE_TRACE_STAGES] = {
+    "network", "parse", "queue", "render", "device", "total",
+};
+
+static histogram_t histograms[SALE_TRACE_STAGES];
+static uint32_t completed = 0;
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;
+
+int64_t sale_trace_now(void)
+{
+    return esp_timer_get_time();
+}
+
+void sale_trace_begin(sale_trace_t *trace)
+{
+    memset(trace, 0, sizeof(*trace));
+    trace->received_us = esp_timer_get_time();
+    trace->network_us = -1;
+}
+
+void sale_trace_set_origin(sale_trace_t *trace, int64_t origin_ms)
+{
+    if (origin_ms <= 0)
+    {
+        return;
+    }
+
+    /* Wall clock at receipt, not now */
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t received_ms = (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000 -
+                          (esp_timer_get_time() - trace->received_us) / 1000;
+    if (received_ms > TRACE_VALID_EPOCH_MS && received_ms >= origin_ms)
+    {
+        trace->network_us = (received_ms - origin_ms) * 1000;
+    }
+}
+
+static void record(sale_trace_stage_t stage, int64_t us)
+{
+    if (us < 0)
+    {
+        return;
+    }
+    uint32_t v = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+    int b = 0;
+    while (b < SALE_TRACE_BUCKETS - 1 && v > bucket_edges[b])
+    {
+        b++;
+    }
+
+    histogram_t *h = &histograms[stage];
+    taskENTER_CRITICAL(&trace_lock);
+    h->count++;
+    h->sum_us += v;
+    if (v > h->max_us)
+    {
+        h->max_us = v;
+    }
+    h->buckets[b]++;
+    taskEXIT_CRITICAL(&trace_lock);
+}
+
+/* Elapsed time between two stamps, or -1 if either stage was not reached */
+static int64_t span(int64_t from, int64_t to)
+{
+    return (from > 0 && to > 0) ? to - from : -1;
+}
+
+void sale_trace_record_arrival(const sale_trace_t *trace)
+{
+    record(SALE_TRACE_NETWORK, trace->network_us);
+    record(SALE_TRACE_PARSE, span(trace->received_us, trace->parsed_us));
+}
+
+void sale_trace_record_complete(const sale_trace_t *trace)
+{
+    int64_t device = span(trace->received_us, trace->frame_us);
+    record(SALE_TRACE_QUEUE, span(trace->enqueued_us, trace->dequeued_us));
+    record(SALE_TRACE_RENDER, span(trace->dequeued_us, trace->frame_us));
+    record(SALE_TRACE_DEVICE, device);
+    if (trace->network_us >= 0 && device >= 0)
+    {
+        record(SALE_TRACE_TOTAL, trace->network_us + device);
+    }
+
+    taskENTER_CRITICAL(&trace_lock);
+    completed++;
+    taskEXIT_CRITICAL(&trace_lock);
+}
+
+uint32_t sale_trace_completed(void)
+{
+    return completed;
+}
+
+size_t sale_trace_format_json(char *buf, size_t size)
+{
+    histogram_t copy[SALE_TRACE_STAGES];
+    taskENTER_CRITICAL(&trace_lock);
+    memcpy(copy, histograms, sizeof(copy));
+    uint32_t done = completed;
+    taskEXIT_CRITICAL(&trace_lock);
+
+    size_t pos = 0;
+#define APPEND(...)                                                  \
+    do                                                               \
+    {                                                                \
+        int n = snprintf(buf + pos, size - pos, __VA_ARGS__);        \
+        if (n < 0 || (size_t)n >= size - pos)                        \
+        {                                                            \
+            return 0;                                                \
+        }                                                            \
+        pos += (size_t)n;                                            \
+    } while (0)
+
+    APPEND("{\"type\":\"latency\",\"traces\":%lu,\"edges_us\":[", (unsigned long)done);
+    for (int b = 0; b < SALE_TRACE_BUCKETS - 1; b++)
+    {
+        APPEND(b ? ",%lu" : "%lu", (unsigned long)bucket_edges[b]);
+    }
+    APPEND("]");
+
+    for (int s = 0; s < SALE_TRACE_STAGES; s++)
+    {
+        const histogram_t *h = &copy[s];
+        APPEND(",\"%s\":{\"n\":%lu,\"avg_us\":%lu,\"max_us\":%lu,\"hist\":[", stage_names[s],
+               (unsigned long)h->count, (unsigned long)(h->count ? h->sum_us / h->count : 0),
+               (unsigned long)h->max_us);
+        for (int b = 0; b < SALE_TRACE_BUCKETS; b++)
+        {
+            APPEND(b ? ",%lu" : "%lu", (unsigned long)h->buckets[b]);
+        }
+        APPEND("]}");
+    }
+    APPEND("}");
+#undef APPEND
+
+    return pos;
+}
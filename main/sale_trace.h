@@ -0,0 +1,91 @@
+/*
+ * Sale Latency Tracing
+ * Monotonic timestamps for each stage between a sale's publication and its
+ * first rendered frame, aggregated into fixed-bucket latency histograms
+ */
+
+#ifndef SALE_TRACE_H
+#define SALE_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Latency buckets: 11 upper bounds from 1 ms to 5 s, plus one overflow bucket */
+#define SALE_TRACE_BUCKETS 12
+
+    /**
+     * @brief Timestamps for one sale, from esp_timer_get_time() (0 = not reached)
+     */
+    typedef struct
+    {
+        int64_t network_us;  /* Publisher to receipt, from wall clocks; -1 if unknown */
+        int64_t received_us; /* Complete MQTT message in hand */
+        int64_t parsed_us;   /* Payload parsed */
+        int64_t enqueued_us; /* Handed to the batch stage */
+        int64_t dequeued_us; /* Taken by the animation task */
+        int64_t frame_us;    /* First celebration frame flushed */
+    } sale_trace_t;
+
+    typedef enum
+    {
+        SALE_TRACE_NETWORK, /* Publisher to MQTT receipt */
+        SALE_TRACE_PARSE,   /* Receipt to parsed */
+        SALE_TRACE_QUEUE,   /* Enqueued to dequeued */
+        SALE_TRACE_RENDER,  /* Dequeued to first frame */
+        SALE_TRACE_DEVICE,  /* Receipt to first frame */
+        SALE_TRACE_TOTAL,   /* Publisher to first frame */
+        SALE_TRACE_STAGES,
+    } sale_trace_stage_t;
+
+    /**
+     * @brief Start a trace at message receipt
+     */
+    void sale_trace_begin(sale_trace_t *trace);
+
+    /**
+     * @brief Derive the network stage from the publisher's timestamp
+     *
+     * Skipped while our wall clock is unset or behind the publisher's.
+     *
+     * @param origin_ms Publisher wall-clock time in epoch ms, 0 if the payload had none
+     */
+    void sale_trace_set_origin(sale_trace_t *trace, int64_t origin_ms);
+
+    /**
+     * @brief Current monotonic time for stamping a stage
+     */
+    int64_t sale_trace_now(void);
+
+    /**
+     * @brief Record the receipt-side stages (network, parse) of a parsed sale
+     */
+    void sale_trace_record_arrival(const sale_trace_t *trace);
+
+    /**
+     * @brief Record the on-device stages once the first frame is out
+     */
+    void sale_trace_record_complete(const sale_trace_t *trace);
+
+    /**
+     * @brief Traces completed since boot
+     */
+    uint32_t sale_trace_completed(void);
+
+    /**
+     * @brief Write the histograms as one JSON object
+     *
+     * @return Length written, or 0 if the buffer was too small
+     */
+    size_t sale_trace_format_json(char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALE_TRACE_H */
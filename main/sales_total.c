@@ -0,0 +1,362 @@
+/*
+ * Sales Total
+ * Today's sale count and per-currency totals, mirrored to RTC memory on
+ * every sale and committed to NVS in batches to spare the flash
+ */
+
+#include "sales_total.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+static const char *TAG = "sales_total";
+
+#define NVS_KEY_SALES_DAY "sales_day"
+#define TOTALS_VERSION 1
+#define TOTALS_RTC_MAGIC 0x53414C45 /* "SALE" */
+#define TOTALS_MIN_YEAR 2016        /* Earlier is an unset clock, as in main.c */
+#define SHUTDOWN_COMMIT_WAIT_MS 200
+
+/* NVS stores a blob as an index entry, a header entry and its data
+ * entries, 32 bytes each; this is what one commit costs the flash */
+#define NVS_ENTRY_SIZE 32
+
+typedef struct
+{
+    uint8_t version;
+    sales_total_day_t day;
+} totals_blob_t;
+
+#define COMMIT_FLASH_BYTES (NVS_ENTRY_SIZE * (2 + (sizeof(totals_blob_t) + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE))
+
+/* Survives software, panic and watchdog resets; the CRC rejects power-on
+ * garbage and a reset that landed mid-update */
+static RTC_NOINIT_ATTR uint32_t rtc_magic;
+static RTC_NOINIT_ATTR uint32_t rtc_crc;
+static RTC_NOINIT_ATTR sales_total_day_t rtc_day;
+
+static portMUX_TYPE totals_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t commit_mutex = NULL; /* One NVS writer at a time */
+static esp_timer_handle_t check_timer = NULL;
+static TaskHandle_t commit_task_handle = NULL;
+static const char *nvs_ns = NULL;
+
+static sales_total_day_t today;
+static uint32_t committed_seq = 0;
+static uint32_t dirty_sales = 0;   /* Sales since the last successful commit */
+static int64_t dirty_since_us = 0; /* When the oldest of them arrived */
+static sales_total_stats_t stats;
+
+static uint32_t rtc_checksum(void)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&rtc_day, sizeof(rtc_day));
+}
+
+/* Year and day of year in local time, 0 while the clock is unset */
+static uint32_t local_day(void)
+{
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    if (tm.tm_year + 1900 < TOTALS_MIN_YEAR)
+    {
+        return 0;
+    }
+    return (uint32_t)(tm.tm_year + 1900) * 1000 + (uint32_t)tm.tm_yday + 1;
+}
+
+/* Caller holds totals_lock */
+static void mirror_locked(void)
+{
+    rtc_magic = 0;
+    rtc_day = today;
+    rtc_crc = rtc_checksum();
+    rtc_magic = TOTALS_RTC_MAGIC;
+}
+
+/* Caller holds totals_lock; after every change to today */
+static void touch_locked(void)
+{
+    today.seq++;
+    mirror_locked();
+}
+
+/* Caller holds totals_lock. Only moves forward, so a restored clock that
+ * lags real time never wipes the day it is behind. */
+static void roll_locked(uint32_t day)
+{
+    if (day == 0 || day <= today.day)
+    {
+        return;
+    }
+    if (today.day != 0)
+    {
+        uint32_t seq = today.seq;
+        memset(&today, 0, sizeof(today));
+        today.seq = seq;
+    }
+    /* A day of 0 collected sales before the clock was set: they are today's */
+    today.day = day;
+    touch_locked();
+}
+
+static esp_err_t write_blob(const totals_blob_t *blob)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(nvs_ns, NVS_READWRITE, &nvs);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    err = nvs_set_blob(nvs, NVS_KEY_SALES_DAY, blob, sizeof(*blob));
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+static esp_err_t commit(TickType_t wait)
+{
+    if (commit_mutex == NULL || xSemaphoreTake(commit_mutex, wait) != pdTRUE)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    totals_blob_t blob = {.version = TOTALS_VERSION};
+    taskENTER_CRITICAL(&totals_lock);
+    blob.day = today;
+    uint32_t sales = dirty_sales;
+    taskEXIT_CRITICAL(&totals_lock);
+
+    esp_err_t err = ESP_OK;
+    if (blob.day.seq != committed_seq)
+    {
+        int64_t start = esp_timer_get_time();
+        err = write_blob(&blob);
+        uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start);
+
+        taskENTER_CRITICAL(&totals_lock);
+        stats.last_commit_us = elapsed_us;
+        if (elapsed_us > stats.max_commit_us)
+        {
+            stats.max_commit_us = elapsed_us;
+        }
+        if (err == ESP_OK)
+        {
+            stats.commits++;
+            stats.bytes_written += COMMIT_FLASH_BYTES;
+            dirty_sales -= sales;
+            dirty_since_us = esp_timer_get_time(); /* For anything that arrived meanwhile */
+        }
+        else
+        {
+            stats.commit_errors++;
+        }
+        taskEXIT_CRITICAL(&totals_lock);
+
+        if (err == ESP_OK)
+        {
+            committed_seq = blob.day.seq;
+            ESP_LOGD(TAG, "Committed %lu sales in %lu us", (unsigned long)sales, (unsigned long)elapsed_us);
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Failed to commit totals: %s", esp_err_to_name(err));
+        }
+    }
+
+    xSemaphoreGive(commit_mutex);
+    return err;
+}
+
+static void check_cb(void *arg)
+{
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&totals_lock);
+    bool due = dirty_sales >= SALES_TOTAL_COMMIT_SALES ||
+               (dirty_sales > 0 && now - dirty_since_us >= (int64_t)SALES_TOTAL_COMMIT_MS * 1000);
+    taskEXIT_CRITICAL(&totals_lock);
+
+    if (due)
+    {
+        xTaskNotifyGive(commit_task_handle);
+    }
+}
+
+static void commit_task(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        commit(portMAX_DELAY);
+    }
+}
+
+/* esp_restart() runs this first, so OTA and config restarts lose nothing */
+static void shutdown_commit(void)
+{
+    commit(pdMS_TO_TICKS(SHUTDOWN_COMMIT_WAIT_MS));
+}
+
+esp_err_t sales_total_init(const sales_total_config_t *config)
+{
+    nvs_ns = config->nvs_namespace;
+    commit_mutex = xSemaphoreCreateMutex();
+    if (commit_mutex == NULL ||
+        xTaskCreatePinnedToCore(commit_task, "sales_total", config->stack, NULL, config->priority,
+                                &commit_task_handle, config->core) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    sales_total_day_t stored = {0};
+    nvs_handle_t nvs;
+    if (nvs_open(nvs_ns, NVS_READONLY, &nvs) == ESP_OK)
+    {
+        totals_blob_t blob;
+        size_t len = sizeof(blob);
+        if (nvs_get_blob(nvs, NVS_KEY_SALES_DAY, &blob, &len) == ESP_OK && len == sizeof(blob) &&
+            blob.version == TOTALS_VERSION)
+        {
+            stored = blob.day;
+        }
+        nvs_close(nvs);
+    }
+    committed_seq = stored.seq;
+    today = stored;
+
+    /* RTC is ahead of NVS when the last reset beat a commit */
+    if (rtc_magic == TOTALS_RTC_MAGIC && rtc_crc == rtc_checksum() && (int32_t)(rtc_day.seq - stored.seq) > 0)
+    {
+        today = rtc_day;
+        dirty_sales = rtc_day.day == stored.day && rtc_day.count >= stored.count ? rtc_day.count - stored.count
+                                                                                 : rtc_day.count;
+        stats.rtc_restored = dirty_sales > 0;
+    }
+
+    taskENTER_CRITICAL(&totals_lock);
+    roll_locked(local_day());
+    mirror_locked();
+    if (dirty_sales > 0)
+    {
+        dirty_since_us = esp_timer_get_time() - (int64_t)SALES_TOTAL_COMMIT_MS * 1000; /* Due at once */
+    }
+    taskEXIT_CRITICAL(&totals_lock);
+
+    const esp_timer_create_args_t args = {
+        .callback = check_cb,
+        .name = "sales_total",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &check_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(check_timer, (uint64_t)SALES_TOTAL_CHECK_MS * 1000));
+    esp_err_t err = esp_register_shutdown_handler(shutdown_commit);
+
+    ESP_LOGI(TAG, "Day %lu: %lu sales%s", (unsigned long)today.day, (unsigned long)today.count,
+             stats.rtc_restored ? " (recovered from RTC)" : "");
+    return err;
+}
+
+void sales_total_add(const sale_batch_t *batch)
+{
+    uint32_t day = local_day();
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&totals_lock);
+    roll_locked(day);
+    today.count += batch->count;
+    for (int i = 0; i < batch->num_currencies; i++)
+    {
+        const sale_batch_total_t *in = &batch->totals[i];
+        int j = 0;
+        while (j < today.num_currencies && strcasecmp(today.totals[j].currency, in->currency) != 0)
+        {
+            j++;
+        }
+        if (j == today.num_currencies)
+        {
+            if (j == SALE_BATCH_MAX_CURRENCIES)
+            {
+                continue; /* Counted, without its amount */
+            }
+            today.num_currencies++;
+            today.totals[j] = (sale_batch_total_t){0};
+            strcpy(today.totals[j].currency, in->currency);
+        }
+        today.totals[j].amount += in->amount;
+        today.totals[j].count += in->count;
+    }
+
+    if (dirty_sales == 0)
+    {
+        dirty_since_us = now;
+    }
+    dirty_sales += batch->count;
+    stats.sales += batch->count;
+    touch_locked();
+    taskEXIT_CRITICAL(&totals_lock);
+}
+
+void sales_total_get(sales_total_day_t *out)
+{
+    uint32_t day = local_day();
+    taskENTER_CRITICAL(&totals_lock);
+    roll_locked(day);
+    *out = today;
+    taskEXIT_CRITICAL(&totals_lock);
+}
+
+esp_err_t sales_total_flush(void)
+{
+    return commit(portMAX_DELAY);
+}
+
+int sales_total_format(const sales_total_day_t *day, char *buf, size_t size)
+{
+    const sale_batch_total_t *top = NULL;
+    for (int i = 0; i < day->num_currencies; i++)
+    {
+        if (top == NULL || day->totals[i].count > top->count)
+        {
+            top = &day->totals[i];
+        }
+    }
+
+    int len;
+    if (top == NULL)
+    {
+        len = snprintf(buf, size, "%lu today", (unsigned long)day->count);
+    }
+    else
+    {
+        /* Minor units shown with two decimals, like the sale payloads */
+        int64_t amount = top->amount;
+        uint64_t mag = amount < 0 ? (uint64_t)0 - (uint64_t)amount : (uint64_t)amount;
+        len = snprintf(buf, size, "%lu today  %s%llu.%02u %s", (unsigned long)day->count, amount < 0 ? "-" : "",
+                       (unsigned long long)(mag / 100), (unsigned)(mag % 100),
+                       top->currency[0] ? top->currency : "?");
+    }
+    if (len < 0)
+    {
+        return 0;
+    }
+    return (size_t)len < size ? len : (int)size - 1;
+}
+
+void sales_total_get_stats(sales_total_stats_t *out)
+{
+    taskENTER_CRITICAL(&totals_lock);
+    *out = stats;
+    out->pending = dirty_sales;
+    taskEXIT_CRITICAL(&totals_lock);
+}
@@ -0,0 +1,103 @@
+/*
+ * Sales Total
+ * Today's sale count and per-currency totals, mirrored to RTC memory on
+ * every sale and committed to NVS in batches to spare the flash
+ */
+
+#ifndef SALES_TOTAL_H
+#define SALES_TOTAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sale_batch.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Uncommitted sales that force an NVS commit */
+#define SALES_TOTAL_COMMIT_SALES 16
+/* Oldest uncommitted sale is written out after this long */
+#define SALES_TOTAL_COMMIT_MS (5 * 60 * 1000)
+/* How often the commit conditions are checked */
+#define SALES_TOTAL_CHECK_MS 10000
+
+    /**
+     * @brief One day's sales
+     */
+    typedef struct
+    {
+        uint32_t day;   /* Local calendar day stamp; 0 until the clock is valid */
+        uint32_t count; /* Sales today */
+        uint32_t seq;   /* Bumped on every change; the newer copy wins on boot */
+        uint8_t num_currencies;
+        sale_batch_total_t totals[SALE_BATCH_MAX_CURRENCIES];
+    } sales_total_day_t;
+
+    typedef struct
+    {
+        const char *nvs_namespace;
+        int core; /* Commit task core, or tskNO_AFFINITY */
+        int priority;
+        int stack;
+    } sales_total_config_t;
+
+    typedef struct
+    {
+        uint32_t sales;         /* Sales added since boot */
+        uint32_t commits;       /* NVS commits since boot */
+        uint32_t commit_errors; /* ...that failed */
+        uint32_t bytes_written; /* NVS entry bytes written by those commits */
+        uint32_t last_commit_us;
+        uint32_t max_commit_us;
+        uint32_t pending;  /* Sales not yet in NVS */
+        bool rtc_restored; /* Boot recovered uncommitted sales from RTC memory */
+    } sales_total_stats_t;
+
+    /**
+     * @brief Restore today's totals and start the commit timer and task
+     *
+     * Takes the newer of the RTC mirror and the NVS copy, and registers a
+     * shutdown handler so esp_restart() commits what is pending. The timer
+     * only checks; NVS is written on the commit task, so a slow flash write
+     * never holds up other esp_timer callbacks.
+     */
+    esp_err_t sales_total_init(const sales_total_config_t *config);
+
+    /**
+     * @brief Add a celebrated batch to today's totals
+     *
+     * Only touches RAM and RTC memory; safe from any task.
+     */
+    void sales_total_add(const sale_batch_t *batch);
+
+    /**
+     * @brief Copy today's totals, starting a new day first if it changed
+     */
+    void sales_total_get(sales_total_day_t *out);
+
+    /**
+     * @brief Commit pending sales to NVS now
+     */
+    esp_err_t sales_total_flush(void);
+
+    /**
+     * @brief Short face label, e.g. "12 today  345.60 USD", for the busiest currency
+     *
+     * @return Length written
+     */
+    int sales_total_format(const sales_total_day_t *day, char *buf, size_t size);
+
+    /**
+     * @brief Copy the commit counters
+     */
+    void sales_total_get_stats(sales_total_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SALES_TOTAL_H */
@@ -0,0 +1,62 @@
+/*
+ * Task Topology
+ * Core affinity, priority and stack size of every task the firmware
+ * creates, set from menuconfig ("Money Bot Tasks")
+ */
+
+#ifndef TASK_TOPOLOGY_H
+#define TASK_TOPOLOGY_H
+
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#if CONFIG_MONEYBOT_TASK_PINNING
+#define TASK_CORE_NET CONFIG_MONEYBOT_TASK_NET_CORE
+#define TASK_CORE_UI CONFIG_MONEYBOT_TASK_UI_CORE
+#define TASK_LAYOUT_NAME "pinned"
+#else
+#define TASK_CORE_NET tskNO_AFFINITY
+#define TASK_CORE_UI tskNO_AFFINITY
+/* Only our tasks float: the IDF Wi-Fi, lwIP, esp_timer and MQTT tasks keep
+ * the core sdkconfig gives them */
+#define TASK_LAYOUT_NAME "app-unpinned"
+#endif
+
+/* Rendering core */
+#define TASK_LVGL_PRIORITY CONFIG_MONEYBOT_TASK_LVGL_PRIORITY
+#define TASK_LVGL_STACK CONFIG_MONEYBOT_TASK_LVGL_STACK
+#define TASK_ANIM_PRIORITY CONFIG_MONEYBOT_TASK_ANIM_PRIORITY
+#define TASK_ANIM_STACK CONFIG_MONEYBOT_TASK_ANIM_STACK
+#define TASK_LED_PRIORITY CONFIG_MONEYBOT_TASK_LED_PRIORITY
+#define TASK_LED_STACK CONFIG_MONEYBOT_TASK_LED_STACK
+#if CONFIG_MONEYBOT_DISPLAY_BUF_PSRAM_FULL
+#define TASK_FLUSH_PRIORITY CONFIG_MONEYBOT_DISPLAY_FLUSH_PRIORITY
+#endif
+
+/* Network core */
+#define TASK_MQTT_PRIORITY CONFIG_MONEYBOT_TASK_MQTT_PRIORITY
+#define TASK_MQTT_STACK CONFIG_MONEYBOT_TASK_MQTT_STACK
+#define TASK_WIFI_PRIORITY CONFIG_MONEYBOT_TASK_WIFI_PRIORITY
+#define TASK_WIFI_STACK CONFIG_MONEYBOT_TASK_WIFI_STACK
+#define TASK_OTA_PRIORITY CONFIG_MONEYBOT_TASK_OTA_PRIORITY
+#define TASK_OTA_STACK CONFIG_MONEYBOT_TASK_OTA_STACK
+#define TASK_TOTALS_PRIORITY CONFIG_MONEYBOT_TASK_TOTALS_PRIORITY
+#define TASK_TOTALS_STACK CONFIG_MONEYBOT_TASK_TOTALS_STACK
+#define TASK_SERVICE_PRIORITY CONFIG_MONEYBOT_TASK_SERVICE_PRIORITY
+#define TASK_SERVICE_STACK CONFIG_MONEYBOT_TASK_SERVICE_STACK
+#define TASK_PORTAL_PRIORITY CONFIG_MONEYBOT_TASK_PORTAL_PRIORITY
+#define TASK_HTTPD_STACK CONFIG_MONEYBOT_TASK_HTTPD_STACK
+#define TASK_DNS_STACK CONFIG_MONEYBOT_TASK_DNS_STACK
+
+/* Benchmarks: always on one core, its cycle counter is per core */
+#if CONFIG_MONEYBOT_BENCH
+#define TASK_BENCH_CORE (TASK_CORE_UI == tskNO_AFFINITY ? 0 : TASK_CORE_UI)
+#define TASK_BENCH_PRIORITY CONFIG_MONEYBOT_BENCH_PRIORITY
+#define TASK_BENCH_STACK CONFIG_MONEYBOT_BENCH_STACK
+#endif
+
+/* Short-lived boot tasks run next to the work they start */
+#define TASK_BOOT_PRIORITY 5
+#define TASK_BOOT_STACK CONFIG_MONEYBOT_TASK_BOOT_STACK
+
+#endif /* TASK_TOPOLOGY_H */
@@ -0,0 +1,212 @@
+/*
+ * Subscription Topics
+ * Which topics the device listens on besides its own (a merchant group and
+ * the fleet broadcast), with a local sale filter per scope, kept in NVS and
+ * changed with a {"type":"topics"} command
+ */
+
+#include "topic_config.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "topic_config";
+
+#define NVS_KEY_TOPICS "topics"
+#define CONFIG_VERSION 1
+
+/* Persisted as one blob */
+typedef struct
+{
+    uint8_t version;
+    topic_config_t config;
+} config_blob_t;
+
+static const char *const scope_names[TOPIC_SCOPE_COUNT] = {
+    [TOPIC_SCOPE_DEVICE] = "device",
+    [TOPIC_SCOPE_GROUP] = "group",
+    [TOPIC_SCOPE_FLEET] = "fleet",
+};
+
+/* Safe as one MQTT topic level: no '/', '+', '#' or spaces */
+static bool valid_name(const char *s, size_t max_len, bool letters_only)
+{
+    size_t n = strlen(s);
+    if (n > max_len)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        char ch = s[i];
+        bool letter = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+        if (!letter && (letters_only || !((ch >= '0' && ch <= '9') || ch == '-' || ch == '_')))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+esp_err_t topic_config_load(const char *nvs_namespace, topic_config_t *out)
+{
+    memset(out, 0, sizeof(*out));
+
+    nvs_handle_t nvs;
+    if (nvs_open(nvs_namespace, NVS_READONLY, &nvs) != ESP_OK)
+    {
+        return ESP_OK; /* Nothing stored yet */
+    }
+    config_blob_t blob;
+    size_t len = sizeof(blob);
+    esp_err_t err = nvs_get_blob(nvs, NVS_KEY_TOPICS, &blob, &len);
+    nvs_close(nvs);
+
+    if (err == ESP_OK && len == sizeof(blob) && blob.version == CONFIG_VERSION)
+    {
+        blob.config.group[TOPIC_GROUP_MAX_LEN] = '\0';
+        if (valid_name(blob.config.group, TOPIC_GROUP_MAX_LEN, false))
+        {
+            *out = blob.config;
+        }
+    }
+    ESP_LOGI(TAG, "Group '%s', fleet %s", out->group, out->fleet ? "on" : "off");
+    return ESP_OK;
+}
+
+esp_err_t topic_config_save(const char *nvs_namespace, const topic_config_t *config)
+{
+    config_blob_t blob = {.version = CONFIG_VERSION, .config = *config};
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(nvs_namespace, NVS_READWRITE, &nvs);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    err = nvs_set_blob(nvs, NVS_KEY_TOPICS, &blob, sizeof(blob));
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to save topics: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+bool topic_config_apply_json(topic_config_t *config, const char *json, size_t len)
+{
+    topic_config_t next = *config;
+    char str[TOPIC_GROUP_MAX_LEN + 2];
+    bool flag;
+    int64_t num;
+
+    if (sale_json_get_string(json, len, "group", str, sizeof(str)))
+    {
+        if (!valid_name(str, TOPIC_GROUP_MAX_LEN, false))
+        {
+            ESP_LOGW(TAG, "Invalid group name");
+            return false;
+        }
+        strcpy(next.group, str);
+    }
+    if (sale_json_get_bool(json, len, "fleet", &flag))
+    {
+        next.fleet = flag;
+    }
+
+    for (int s = 0; s < TOPIC_SCOPE_COUNT; s++)
+    {
+        char key[24];
+        topic_filter_t *f = &next.filters[s];
+
+        snprintf(key, sizeof(key), "%s_min", scope_names[s]);
+        if (sale_json_get_int(json, len, key, &num))
+        {
+            if (num < 0 || num > INT32_MAX)
+            {
+                ESP_LOGW(TAG, "Invalid %s", key);
+                return false;
+            }
+            f->min_amount = (int32_t)num;
+        }
+
+        snprintf(key, sizeof(key), "%s_currency", scope_names[s]);
+        if (sale_json_get_string(json, len, key, str, sizeof(str)))
+        {
+            if (!valid_name(str, sizeof(f->currency) - 1, true))
+            {
+                ESP_LOGW(TAG, "Invalid %s", key);
+                return false;
+            }
+            strcpy(f->currency, str);
+        }
+    }
+
+    *config = next;
+    return true;
+}
+
+int topic_config_format(const topic_config_t *config, char *buf, size_t size)
+{
+    int len = snprintf(buf, size, "{\"type\":\"topics\",\"group\":\"%s\",\"fleet\":%s,\"filters\":{",
+                       config->group, config->fleet ? "true" : "false");
+    for (int s = 0; s < TOPIC_SCOPE_COUNT && len >= 0 && (size_t)len < size; s++)
+    {
+        len += snprintf(buf + len, size - len, "%s\"%s\":{\"min\":%ld,\"currency\":\"%s\"}", s ? "," : "",
+                        scope_names[s], (long)config->filters[s].min_amount, config->filters[s].currency);
+    }
+    if (len >= 0 && (size_t)len < size)
+    {
+        len += snprintf(buf + len, size - len, "}}");
+    }
+    return len >= 0 && (size_t)len < size ? len : -1;
+}
+
+bool topic_config_topic(const topic_config_t *config, topic_scope_t scope, const char *device_id,
+                        bool binary, char *out, size_t size)
+{
+    const char *leaf = binary ? "bin" : "cmd";
+    int len;
+    switch (scope)
+    {
+    case TOPIC_SCOPE_DEVICE:
+        len = snprintf(out, size, "moneybot/%s/%s", device_id, leaf);
+        break;
+    case TOPIC_SCOPE_GROUP:
+        if (config->group[0] == '\0')
+        {
+            return false;
+        }
+        len = snprintf(out, size, "moneybot/group/%s/%s", config->group, leaf);
+        break;
+    case TOPIC_SCOPE_FLEET:
+        if (!config->fleet)
+        {
+            return false;
+        }
+        len = snprintf(out, size, "moneybot/fleet/%s", leaf);
+        break;
+    default:
+        return false;
+    }
+    return len > 0 && (size_t)len < size;
+}
+
+const char *topic_scope_name(topic_scope_t scope)
+{
+    return scope < TOPIC_SCOPE_COUNT ? scope_names[scope] : "?";
+}
+
+bool topic_filter_pass(const topic_filter_t *filter, const sale_event_t *event)
+{
+    if (event->amount < filter->min_amount)
+    {
+        return false;
+    }
+    return filter->currency[0] == '\0' || strcasecmp(filter->currency, event->currency) == 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Subscription Topics
+ * Which topics the device listens on besides its own (a merchant group and
+ * the fleet broadcast), with a local sale filter per scope, kept in NVS and
+ * changed with a {"type":"topics"} command
+ */
+
+#ifndef TOPIC_CONFIG_H
+#define TOPIC_CONFIG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sale_parser.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Longest group name; letters, digits, '-' and '_' only */
+#define TOPIC_GROUP_MAX_LEN 32
+/* Longest topic any scope builds */
+#define TOPIC_MAX_LEN 96
+
+    typedef enum
+    {
+        TOPIC_SCOPE_DEVICE, /* moneybot/<deviceId>/{cmd,bin} */
+        TOPIC_SCOPE_GROUP,  /* moneybot/group/<group>/{cmd,bin} */
+        TOPIC_SCOPE_FLEET,  /* moneybot/fleet/{cmd,bin} */
+        TOPIC_SCOPE_COUNT,
+    } topic_scope_t;
+
+    /**
+     * @brief Sales from a scope are celebrated only if they pass its filter
+     */
+    typedef struct
+    {
+        int32_t min_amount; /* Minor units; 0 accepts everything */
+        char currency[8];   /* Only this currency; "" for any */
+    } topic_filter_t;
+
+    typedef struct
+    {
+        char group[TOPIC_GROUP_MAX_LEN + 1]; /* "" when not in a group */
+        bool fleet;                          /* Listen to the fleet broadcast */
+        topic_filter_t filters[TOPIC_SCOPE_COUNT];
+    } topic_config_t;
+
+    /**
+     * @brief Load the configuration; defaults (own topic only, no filters)
+     * when nothing valid is stored
+     */
+    esp_err_t topic_config_load(const char *nvs_namespace, topic_config_t *out);
+
+    /**
+     * @brief Persist the configuration
+     */
+    esp_err_t topic_config_save(const char *nvs_namespace, const topic_config_t *config);
+
+    /**
+     * @brief Update @p config from a {"type":"topics"} payload
+     *
+     * Recognized members: "group" (string, "" to leave the group), "fleet"
+     * (bool), and "<scope>_min" / "<scope>_currency" for scope device, group
+     * or fleet. Missing members keep their value.
+     *
+     * @return false (and @p config untouched) if any member is invalid
+     */
+    bool topic_config_apply_json(topic_config_t *config, const char *json, size_t len);
+
+    /**
+     * @brief Render the configuration as a {"type":"topics"} JSON reply
+     *
+     * @return Length written, or -1 if @p size is too small
+     */
+    int topic_config_format(const topic_config_t *config, char *buf, size_t size);
+
+    /**
+     * @brief Build a scope's command (or binary) topic
+     *
+     * @return false if the scope is not enabled in @p config
+     */
+    bool topic_config_topic(const topic_config_t *config, topic_scope_t scope, const char *device_id,
+                            bool binary, char *out, size_t size);
+
+    /**
+     * @brief Scope name as used in commands and replies ("device", "group", "fleet")
+     */
+    const char *topic_scope_name(topic_scope_t scope);
+
+    /**
+     * @brief Whether @p event passes @p filter
+     */
+    bool topic_filter_pass(const topic_filter_t *filter, const sale_event_t *event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TOPIC_CONFIG_H */
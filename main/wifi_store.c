@@ -0,0 +1,282 @@
+/*
+ * Wi-Fi Credential Store
+ * Several known networks kept in NVS, ranked by the signal each one showed
+ * in the latest scan so reconnects try the strongest first
+ */
+
+#include "wifi_store.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+#include <string.h>
+
+static const char *TAG = "wifi_store";
+
+#define NVS_KEY_NETWORKS "wifi_nets"
+#define NVS_KEY_LEGACY_SSID "wifi_ssid"
+#define NVS_KEY_LEGACY_PASS "wifi_pass"
+
+#define STORE_VERSION 1
+#define LAST_NONE 0xFF
+
+/* Persisted as one blob */
+typedef struct
+{
+    uint8_t version;
+    uint8_t count;
+    uint8_t last; /* Index of the last associated network, LAST_NONE if unknown */
+    wifi_store_entry_t entries[WIFI_STORE_MAX];
+} store_blob_t;
+
+static store_blob_t store;
+static const char *store_namespace = NULL;
+static SemaphoreHandle_t store_lock = NULL;
+
+static esp_err_t store_save(void)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(store_namespace, NVS_READWRITE, &nvs);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    err = nvs_set_blob(nvs, NVS_KEY_NETWORKS, &store, sizeof(store));
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to save networks: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static int find(const char *ssid)
+{
+    for (int i = 0; i < store.count; i++)
+    {
+        if (strcmp(store.entries[i].ssid, ssid) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Move entry @p from to @p to, shifting the ones between; keeps 'last' pointing at its entry */
+static void move_entry(int from, int to)
+{
+    if (from == to)
+    {
+        return;
+    }
+    wifi_store_entry_t e = store.entries[from];
+    int step = from > to ? -1 : 1;
+    for (int i = from; i != to; i += step)
+    {
+        store.entries[i] = store.entries[i + step];
+    }
+    store.entries[to] = e;
+
+    if (store.last == from)
+    {
+        store.last = to;
+    }
+    else if (store.last != LAST_NONE)
+    {
+        int last = store.last;
+        if (from > to && last >= to && last < from)
+        {
+            store.last = last + 1;
+        }
+        else if (from < to && last > from && last <= to)
+        {
+            store.last = last - 1;
+        }
+    }
+}
+
+/* Entry the older firmware kept in two string keys */
+static void import_legacy(nvs_handle_t nvs)
+{
+    wifi_store_entry_t e = {.rssi = WIFI_STORE_RSSI_UNSEEN};
+    size_t len = sizeof(e.ssid);
+    if (nvs_get_str(nvs, NVS_KEY_LEGACY_SSID, e.ssid, &len) != ESP_OK || e.ssid[0] == '\0')
+    {
+        return;
+    }
+    len = sizeof(e.pass);
+    nvs_get_str(nvs, NVS_KEY_LEGACY_PASS, e.pass, &len);
+
+    store.entries[0] = e;
+    store.count = 1;
+    store.last = 0; /* The cached AP, if any, belongs to it */
+    if (store_save() == ESP_OK)
+    {
+        nvs_erase_key(nvs, NVS_KEY_LEGACY_SSID);
+        nvs_erase_key(nvs, NVS_KEY_LEGACY_PASS);
+        nvs_commit(nvs);
+    }
+    ESP_LOGI(TAG, "Imported stored network '%s'", e.ssid);
+}
+
+esp_err_t wifi_store_init(const char *nvs_namespace)
+{
+    if (store_lock == NULL)
+    {
+        store_lock = xSemaphoreCreateMutex();
+        if (store_lock == NULL)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    store_namespace = nvs_namespace;
+
+    memset(&store, 0, sizeof(store));
+    store.version = STORE_VERSION;
+    store.last = LAST_NONE;
+
+    nvs_handle_t nvs;
+    if (nvs_open(store_namespace, NVS_READWRITE, &nvs) != ESP_OK)
+    {
+        return ESP_OK; /* Nothing stored yet */
+    }
+
+    size_t len = sizeof(store);
+    esp_err_t err = nvs_get_blob(nvs, NVS_KEY_NETWORKS, &store, &len);
+    if (err != ESP_OK || len != sizeof(store) || store.version != STORE_VERSION || store.count > WIFI_STORE_MAX)
+    {
+        memset(&store, 0, sizeof(store));
+        store.version = STORE_VERSION;
+        store.last = LAST_NONE;
+        import_legacy(nvs);
+    }
+    nvs_close(nvs);
+
+    ESP_LOGI(TAG, "%d known network(s)", store.count);
+    return ESP_OK;
+}
+
+esp_err_t wifi_store_add(const char *ssid, const char *pass)
+{
+    if (ssid == NULL || ssid[0] == '\0' || strlen(ssid) >= sizeof(store.entries[0].ssid) ||
+        strlen(pass) >= sizeof(store.entries[0].pass))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    int i = find(ssid);
+    if (i < 0)
+    {
+        if (store.count == WIFI_STORE_MAX)
+        {
+            /* Full: the last entry is the weakest (or longest unseen) */
+            ESP_LOGW(TAG, "Store full, forgetting '%s'", store.entries[WIFI_STORE_MAX - 1].ssid);
+            if (store.last == WIFI_STORE_MAX - 1)
+            {
+                store.last = LAST_NONE;
+            }
+            store.count--;
+        }
+        i = store.count++;
+        strlcpy(store.entries[i].ssid, ssid, sizeof(store.entries[i].ssid));
+    }
+    strlcpy(store.entries[i].pass, pass, sizeof(store.entries[i].pass));
+    store.entries[i].rssi = 0; /* Just entered by the user: try it first */
+    move_entry(i, 0);
+    esp_err_t err = store_save();
+    xSemaphoreGive(store_lock);
+    return err;
+}
+
+int wifi_store_count(void)
+{
+    return store.count;
+}
+
+bool wifi_store_get(int index, wifi_store_entry_t *out)
+{
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    bool ok = index >= 0 && index < store.count;
+    if (ok)
+    {
+        *out = store.entries[index];
+    }
+    xSemaphoreGive(store_lock);
+    return ok;
+}
+
+bool wifi_store_last(wifi_store_entry_t *out)
+{
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    bool ok = store.last < store.count;
+    if (ok)
+    {
+        *out = store.entries[store.last];
+    }
+    xSemaphoreGive(store_lock);
+    return ok;
+}
+
+void wifi_store_mark_connected(const char *ssid)
+{
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    int i = find(ssid);
+    if (i >= 0 && store.last != i)
+    {
+        store.last = i;
+        store_save();
+    }
+    xSemaphoreGive(store_lock);
+}
+
+int wifi_store_rank(const wifi_ap_record_t *records, uint16_t count)
+{
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+
+    char before[WIFI_STORE_MAX][sizeof(store.entries[0].ssid)];
+    int seen = 0;
+    for (int i = 0; i < store.count; i++)
+    {
+        strlcpy(before[i], store.entries[i].ssid, sizeof(before[i]));
+
+        int8_t best = WIFI_STORE_RSSI_UNSEEN;
+        for (int j = 0; j < count; j++)
+        {
+            if (strcmp((const char *)records[j].ssid, store.entries[i].ssid) == 0 && records[j].rssi > best)
+            {
+                best = records[j].rssi;
+            }
+        }
+        store.entries[i].rssi = best;
+        seen += best != WIFI_STORE_RSSI_UNSEEN;
+    }
+
+    /* Stable insertion sort, strongest first */
+    for (int i = 1; i < store.count; i++)
+    {
+        int j = i;
+        while (j > 0 && store.entries[j - 1].rssi < store.entries[i].rssi)
+        {
+            j--;
+        }
+        move_entry(i, j);
+    }
+
+    bool reordered = false;
+    for (int i = 0; i < store.count; i++)
+    {
+        reordered |= strcmp(before[i], store.entries[i].ssid) != 0;
+    }
+    if (reordered)
+    {
+        store_save();
+    }
+
+    xSemaphoreGive(store_lock);
+    return seen;
+}
@@ -0,0 +1,86 @@
+/*
+ * Wi-Fi Credential Store
+ * Several known networks kept in NVS, ranked by the signal each one showed
+ * in the latest scan so reconnects try the strongest first
+ */
+
+#ifndef WIFI_STORE_H
+#define WIFI_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Known networks; adding one more evicts the weakest */
+#define WIFI_STORE_MAX 4
+/* RSSI of a network missing from the latest scan */
+#define WIFI_STORE_RSSI_UNSEEN (-128)
+
+    typedef struct
+    {
+        char ssid[33];
+        char pass[65];
+        int8_t rssi; /* Last seen in a scan, WIFI_STORE_RSSI_UNSEEN if not */
+    } wifi_store_entry_t;
+
+    /**
+     * @brief Load the store from NVS
+     *
+     * Single-network credentials saved by older firmware (wifi_ssid /
+     * wifi_pass) are imported once and then erased.
+     *
+     * @param nvs_namespace NVS namespace holding the store
+     */
+    esp_err_t wifi_store_init(const char *nvs_namespace);
+
+    /**
+     * @brief Add or update a network and persist it
+     *
+     * The network goes first in the ranking until the next scan.
+     */
+    esp_err_t wifi_store_add(const char *ssid, const char *pass);
+
+    /**
+     * @brief Number of known networks
+     */
+    int wifi_store_count(void);
+
+    /**
+     * @brief Copy the network at @p index in ranking order
+     *
+     * @return false if @p index is out of range
+     */
+    bool wifi_store_get(int index, wifi_store_entry_t *out);
+
+    /**
+     * @brief Copy the network the device last associated with
+     *
+     * @return false if unknown (e.g. first boot, or it was evicted)
+     */
+    bool wifi_store_last(wifi_store_entry_t *out);
+
+    /**
+     * @brief Record a successful association with @p ssid
+     */
+    void wifi_store_mark_connected(const char *ssid);
+
+    /**
+     * @brief Re-rank the known networks from scan results
+     *
+     * NVS is only written when the order changes.
+     *
+     * @return Number of known networks present in the scan
+     */
+    int wifi_store_rank(const wifi_ap_record_t *records, uint16_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WIFI_STORE_H */